@@ -17,6 +17,9 @@
 #include "Platform.h"
 #include "HTTP.h"
 #include "Image/Decoder.h"
+#include "Nodes/ImgNode.h"
+#include "Image/ImgCache.h"
+#include "Draw/GlyphCache.h"
 
 App* App::app;
 AppConfig App::config;
@@ -26,6 +29,10 @@ App::App()
 {
 	app = this;
 	requestedNewPage = false;
+	lastImageProbeScanNode = NULL;
+	imageSpools = NULL;
+	numImageSpools = 0;
+	resumedImageSpoolLoad = false;
 
 	memset(pageHistoryBuffer, 0, MAX_PAGE_HISTORY_BUFFER_SIZE);
 	pageHistoryPtr = pageHistoryBuffer;
@@ -39,6 +46,19 @@ App::~App()
 
 void App::ResetPage()
 {
+	for (int n = 0; n < MAX_IMAGE_PROBE_TASKS; n++)
+	{
+		if (imageProbeTasks[n].spool)
+		{
+			FinishImageSpool(imageProbeTasks[n], false);
+		}
+		imageProbeTasks[n].loadTask.Stop();
+		imageProbeTasks[n].node = NULL;
+	}
+	lastImageProbeScanNode = NULL;
+	RemoveImageSpools();
+	resumedImageSpoolLoad = false;
+
 	StylePool::Get().Reset();
 	page.Reset();
 	parser.Reset();
@@ -56,6 +76,7 @@ void App::Run(int argc, char* argv[])
 	config.dumpPage = false;
 	config.useSwap = false;
 	config.useEMS = true;
+	config.glyphCache = GLYPH_CACHE_DEFAULT_ENABLED;
 
 	if (argc > 1)
 	{
@@ -86,6 +107,14 @@ void App::Run(int argc, char* argv[])
 			{
 				config.useEMS = false;
 			}
+			else if (!stricmp(argv[n], "-noglyphcache"))
+			{
+				config.glyphCache = false;
+			}
+			else if (!stricmp(argv[n], "-glyphcache"))
+			{
+				config.glyphCache = true;
+			}
 			else if (!stricmp(argv[n], "-log"))
 			{
 				Platform::config.enableLog = true;
@@ -93,6 +122,36 @@ void App::Run(int argc, char* argv[])
 		}
 	}
 
+	Init();
+
+	if (targetURL)
+	{
+		OpenURL(targetURL);
+	}
+	else
+	{
+		ui.FocusNode(ui.addressBarNode);
+	}
+
+	while (running)
+	{
+		Platform::Update();
+
+		UpdatePageLoadTask();
+		UpdateContentLoadTask();
+		UpdateImageProbeTasks();
+
+		page.layout.Update();
+		pageRenderer.Update();
+		ui.Update();
+	}
+
+	StopLoad();
+	RemoveImageSpools();
+}
+
+void App::Init()
+{
 	MemoryManager::pageBlockAllocator.Init();
 
 	if (config.loadImages)
@@ -104,133 +163,487 @@ void App::Run(int argc, char* argv[])
 	ui.Init();
 	page.Reset();
 	pageRenderer.Init();
+}
 
-	if (targetURL)
+void App::StartNewPage()
+{
+	ResetPage();
+	requestedNewPage = false;
+	page.pageURL = pageLoadTask.GetURL();
+	if(pageLoadTask.type == LoadTask::ResourceFile)
 	{
-		OpenURL(targetURL);
+		parser.EnableInternal();
+	}
+	ui.UpdateAddressBar(page.pageURL);
+	loadTaskTargetNode = page.GetRootNode();
+	ui.SetStatusMessage("Parsing page content...", StatusBarNode::GeneralStatus);
+}
+
+void App::UpdatePageLoadTask()
+{
+	if (pageLoadTask.HasContent())
+	{
+		if (requestedNewPage)
+		{
+			StartNewPage();
+		}
+
+		size_t bytesRead = pageLoadTask.GetContent(loadBuffer, APP_LOAD_BUFFER_SIZE);
+		if (bytesRead)
+		{
+			if (pageLoadTask.debugDumpFile)
+			{
+				fwrite(loadBuffer, 1, bytesRead, pageLoadTask.debugDumpFile);
+			}
+
+			parser.Parse(loadBuffer, bytesRead);
+		}
 	}
 	else
 	{
-		ui.FocusNode(ui.addressBarNode);
+		if (requestedNewPage)
+		{
+			if (pageLoadTask.type == LoadTask::RemoteFile)
+			{
+				if (!pageLoadTask.request)
+				{
+					if (Platform::network->IsConnected())
+					{
+						ShowErrorPage("Failed to make network request");
+					}
+					else
+					{
+						ShowErrorPage("No network interface available");
+					}
+					requestedNewPage = false;
+				}
+				else if (pageLoadTask.request->GetStatus() == HTTPRequest::Error)
+				{
+					ShowErrorPage(pageLoadTask.request->GetStatusString());
+					requestedNewPage = false;
+				}
+				else if (pageLoadTask.request->GetStatus() == HTTPRequest::UnsupportedHTTPS)
+				{
+					ShowNoHTTPSPage();
+					requestedNewPage = false;
+				}
+				else if (pageLoadTask.request->GetStatus() == HTTPRequest::Connecting)
+				{
+					ui.SetStatusMessage(pageLoadTask.request->GetStatusString(), StatusBarNode::GeneralStatus);
+				}
+			}
+			else if (pageLoadTask.type == LoadTask::LocalFile)
+			{
+				ui.UpdateAddressBar(pageLoadTask.GetURL());
+				ShowErrorPage("File not found");
+				requestedNewPage = false;
+			}
+		}
+		else if (!parser.IsFinished())
+		{
+			parser.Finish();
+		}
 	}
+}
 
-	while (running)
+void App::UpdateContentLoadTask()
+{
+	if (pageContentLoadTask.HasContent())
 	{
-		Platform::Update();
-
-		if (pageLoadTask.HasContent())
+		size_t bytesRead = pageContentLoadTask.GetContent(loadBuffer, APP_LOAD_BUFFER_SIZE);
+		if (bytesRead)
 		{
-			if (requestedNewPage)
+			bool stillProcessing = loadTaskTargetNode->Handler().ParseContent(loadTaskTargetNode, loadBuffer, bytesRead);
+			if (!stillProcessing)
 			{
-				ResetPage();
-				requestedNewPage = false;
-				page.pageURL = pageLoadTask.GetURL();
-				if(pageLoadTask.type == LoadTask::ResourceFile)
+				pageContentLoadTask.Stop();
+			}
+		}
+	}
+	else if(!pageContentLoadTask.IsBusy())
+	{
+		if (loadTaskTargetNode)
+		{
+			if (loadTaskTargetNode->type == Node::Image && !resumedImageSpoolLoad)
+			{
+				// LoadContent() skips an image that is still downloading into its spool
+				ImageNode::Data* data = static_cast<ImageNode::Data*>(loadTaskTargetNode->data);
+				ImageSpool* spool = FindImageSpool(data->source);
+				if (spool && data->state == ImageNode::FinishedDownloadingDimensions)
 				{
-					parser.EnableInternal();
+					if (!spool->IsWriting())
+					{
+						// Spool has finished, or been given up on, so try again
+						LoadImageNodeContent(loadTaskTargetNode);
+						resumedImageSpoolLoad = true;
+					}
+					return;
 				}
-				ui.UpdateAddressBar(page.pageURL);
-				loadTaskTargetNode = page.GetRootNode();
-				ui.SetStatusMessage("Parsing page content...", StatusBarNode::GeneralStatus);
 			}
 
-			size_t bytesRead = pageLoadTask.GetContent(loadBuffer, APP_LOAD_BUFFER_SIZE);
-			if (bytesRead)
+			loadTaskTargetNode->Handler().FinishContent(loadTaskTargetNode, pageContentLoadTask);
+			loadTaskTargetNode = page.ProcessNextLoadTask(loadTaskTargetNode, pageContentLoadTask);
+			resumedImageSpoolLoad = false;
+
+			if (!loadTaskTargetNode && page.layout.IsFinished())
 			{
-				if (pageLoadTask.debugDumpFile)
+				if (MemoryManager::pageAllocator.GetError())
+				{
+					Platform::Log("Out of memory when loading page");
+					page.GetApp().ui.SetStatusMessage("Out of memory when loading page", StatusBarNode::GeneralStatus);
+				}
+				else
 				{
-					fwrite(loadBuffer, 1, bytesRead, pageLoadTask.debugDumpFile);
+					page.GetApp().ui.ClearStatusMessage(StatusBarNode::GeneralStatus);
 				}
+			}
+		}
+		else if (page.ShouldRetryDeferredImageLoads())
+		{
+			loadTaskTargetNode = page.ProcessNextLoadTask(nullptr, pageContentLoadTask);
+			resumedImageSpoolLoad = false;
+		}
+	}
+}
 
-				parser.Parse(loadBuffer, bytesRead);
+void App::UpdateImageProbeTasks()
+{
+	if (!config.loadImages)
+	{
+		return;
+	}
+
+	for (int n = 0; n < MAX_IMAGE_PROBE_TASKS; n++)
+	{
+		ImageProbeTask& task = imageProbeTasks[n];
+		if (!task.node && !task.spool)
+		{
+			continue;
+		}
+
+		if (task.loadTask.HasContent())
+		{
+			size_t bytesRead = task.loadTask.GetContent(loadBuffer, APP_LOAD_BUFFER_SIZE);
+			if (bytesRead)
+			{
+				if (task.spool && !task.spool->Write(loadBuffer, bytesRead))
+				{
+					FinishImageSpool(task, false);
+				}
+				if (task.node && task.probe.Process((uint8_t*) loadBuffer, bytesRead) != ImageProbe::Probing)
+				{
+					FinishImageProbe(task);
+				}
 			}
 		}
-		else
+		else if (!task.loadTask.IsBusy())
+		{
+			if (task.node)
+			{
+				// Stream ended before the dimensions were found
+				FinishImageProbe(task);
+			}
+			if (task.spool)
+			{
+				// A truncated download is left for the decoder to report, as it would be without the spool
+				FinishImageSpool(task, true);
+			}
+		}
+	}
+
+	// Probe images that layout has reached, so that any explicit width / height has been applied.
+	// Layout doesn't wait for these, it carries on with a placeholder size
+	int freeTask = 0;
+	Node* node = lastImageProbeScanNode ? lastImageProbeScanNode->GetNextInTree() : page.GetRootNode();
+
+	for (; node && node != page.layout.currentNodeToProcess; node = node->GetNextInTree())
+	{
+		if (node->type == Node::Image)
 		{
-			if (requestedNewPage)
+			ImageNode::Data* data = static_cast<ImageNode::Data*>(node->data);
+
+			if (data->NeedsDimensionProbe())
 			{
-				if (pageLoadTask.type == LoadTask::RemoteFile)
+				if (!data->source)
 				{
-					if (!pageLoadTask.request)
+					Platform::Log("IMG without source!");
+					ImageNode::ImageLoadError(node);
+					page.layout.MarkImageSizeChanged(node);
+				}
+				else
+				{
+					bool isAlreadyProbing = false;
+					for (int n = 0; n < MAX_IMAGE_PROBE_TASKS; n++)
 					{
-						if (Platform::network->IsConnected())
+						Node* probeNode = imageProbeTasks[n].node;
+						if (probeNode && !strcmp(static_cast<ImageNode::Data*>(probeNode->data)->source, data->source))
 						{
-							ShowErrorPage("Failed to make network request");
+							// Result will be shared when that probe finishes
+							isAlreadyProbing = true;
 						}
-						else
-						{
-							ShowErrorPage("No network interface available");
-						}
-						requestedNewPage = false;
 					}
-					else if (pageLoadTask.request->GetStatus() == HTTPRequest::Error)
+
+					ImageSpool* spool = FindImageSpool(data->source);
+					if (!isAlreadyProbing && ImageNode::LoadCachedDimensions(node))
 					{
-						ShowErrorPage(pageLoadTask.request->GetStatusString());
-						requestedNewPage = false;
+						page.layout.MarkImageSizeChanged(node);
 					}
-					else if (pageLoadTask.request->GetStatus() == HTTPRequest::UnsupportedHTTPS)
+					else if (!isAlreadyProbing && spool)
 					{
-						ShowNoHTTPSPage();
-						requestedNewPage = false;
+						// Probed by an earlier use of the same image. A failed probe is shared too, so that
+						// a missing image isn't requested again
+						ImageNode::ShareProbedDimensions(node, spool->node);
+						page.layout.MarkImageSizeChanged(node);
 					}
-					else if (pageLoadTask.request->GetStatus() == HTTPRequest::Connecting)
+					else if (!isAlreadyProbing)
 					{
-						ui.SetStatusMessage(pageLoadTask.request->GetStatusString(), StatusBarNode::GeneralStatus);
+						while (freeTask < MAX_IMAGE_PROBE_TASKS && (imageProbeTasks[freeTask].node || imageProbeTasks[freeTask].spool))
+						{
+							freeTask++;
+						}
+						if (freeTask == MAX_IMAGE_PROBE_TASKS || !StartImageProbe(imageProbeTasks[freeTask], node))
+						{
+							// Carry on from this image on a later update
+							return;
+						}
 					}
 				}
-				else if (pageLoadTask.type == LoadTask::LocalFile)
-				{
-					ui.UpdateAddressBar(pageLoadTask.GetURL());
-					ShowErrorPage("File not found");
-					requestedNewPage = false;
-				}
 			}
-			else if (!parser.IsFinished())
+		}
+
+		lastImageProbeScanNode = node;
+	}
+}
+
+bool App::StartImageProbe(ImageProbeTask& task, Node* node)
+{
+	ImageNode::Data* data = static_cast<ImageNode::Data*>(node->data);
+
+	task.loadTask.Load(URL::GenerateFromRelative(page.pageURL.url, data->source).url);
+
+	if (task.loadTask.type == LoadTask::RemoteFile && !task.loadTask.request && Platform::network->IsConnected())
+	{
+		// Every HTTP request is in use
+		return false;
+	}
+
+	// Node state is left alone so the content load task doesn't mistake this for its own download
+	task.node = node;
+	task.probe.Begin();
+
+	// Everything received is kept so the image is only transferred once. Cached and local files are cheap to open again.
+	// The spool is listed even if it can't be opened, so that later uses of the image find the probe result
+	if (task.loadTask.type == LoadTask::RemoteFile)
+	{
+		ImageSpool* spool = MemoryManager::pageAllocator.Alloc<ImageSpool>();
+		if (spool)
+		{
+			spool->source = data->source;
+			spool->node = node;
+			spool->id = numImageSpools++;
+			spool->next = imageSpools;
+			imageSpools = spool;
+			if (spool->Open())
 			{
-				parser.Finish();
+				task.spool = spool;
 			}
 		}
+	}
+
+	return true;
+}
 
-		if (pageContentLoadTask.HasContent())
+void App::FinishImageProbe(ImageProbeTask& task)
+{
+	if (task.spool)
+	{
+		if (task.probe.GetState() == ImageProbe::Success)
 		{
-			size_t bytesRead = pageContentLoadTask.GetContent(loadBuffer, APP_LOAD_BUFFER_SIZE);
-			if (bytesRead)
+			const char* contentType = task.loadTask.GetContentType();
+			if (contentType && *contentType)
 			{
-				bool stillProcessing = loadTaskTargetNode->Handler().ParseContent(loadTaskTargetNode, loadBuffer, bytesRead);
-				if (!stillProcessing)
-				{
-					pageContentLoadTask.Stop();
-				}
+				task.spool->contentType = MemoryManager::pageAllocator.AllocString(contentType);
 			}
 		}
-		else if(!pageContentLoadTask.IsBusy())
+		else
 		{
-			if (loadTaskTargetNode)
-			{
-				loadTaskTargetNode->Handler().FinishContent(loadTaskTargetNode, pageContentLoadTask);
-				loadTaskTargetNode = page.ProcessNextLoadTask(loadTaskTargetNode, pageContentLoadTask);
+			// Image will be shown as broken, so there is nothing to keep
+			FinishImageSpool(task, false);
+		}
+	}
+	if (!task.spool)
+	{
+		task.loadTask.Stop();
+	}
 
-				if (!loadTaskTargetNode && page.layout.IsFinished())
-				{
-					if (MemoryManager::pageAllocator.GetError())
-					{
-						Platform::Log("Out of memory when loading page");
-						page.GetApp().ui.SetStatusMessage("Out of memory when loading page", StatusBarNode::GeneralStatus);
-					}
-					else
-					{
-						page.GetApp().ui.ClearStatusMessage(StatusBarNode::GeneralStatus);
-					}
-				}
+	ImageNode::FinishDimensionProbe(task.node, task.probe);
+	task.node = NULL;
+}
+
+void App::StopImageProbes()
+{
+	for (int n = 0; n < MAX_IMAGE_PROBE_TASKS; n++)
+	{
+		ImageProbeTask& task = imageProbeTasks[n];
+		if (task.spool)
+		{
+			FinishImageSpool(task, false);
+		}
+		if (task.node)
+		{
+			task.loadTask.Stop();
+			ImageNode::ImageLoadError(task.node);
+			page.layout.MarkImageSizeChanged(task.node);
+			task.node = NULL;
+		}
+	}
+}
+
+void App::FinishImageSpool(ImageProbeTask& task, bool complete)
+{
+	task.spool->Close(complete);
+	task.spool = NULL;
+
+	if (!task.node)
+	{
+		task.loadTask.Stop();
+	}
+}
+
+void App::RemoveImageSpools()
+{
+	for (ImageSpool* spool = imageSpools; spool; spool = spool->next)
+	{
+		spool->Remove();
+	}
+	imageSpools = NULL;
+	numImageSpools = 0;
+}
+
+bool App::IsSpoolingImages()
+{
+	for (int n = 0; n < MAX_IMAGE_PROBE_TASKS; n++)
+	{
+		if (imageProbeTasks[n].spool)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+ImageSpool* App::FindImageSpool(const char* source)
+{
+	if (source)
+	{
+		for (ImageSpool* spool = imageSpools; spool; spool = spool->next)
+		{
+			if (!strcmp(spool->source, source))
+			{
+				return spool;
 			}
 		}
-		//if (loadTask.type == LoadTask::RemoteFile && loadTask.request && loadTask.request->GetStatus() == HTTPRequest::Connecting)
-		//	ui.SetStatusMessage(loadTask.request->GetStatusString());
+	}
+	return NULL;
+}
 
-		page.layout.Update();
-		pageRenderer.Update();
-		ui.Update();
+// Returns false if the path doesn't fit
+static bool GetImageSpoolPath(char* path, int id)
+{
+	// Kept alongside the cache files, the name fits in 8.3
+	return snprintf(path, _MAX_PATH, "%s" PATH_SEPARATOR "%s" PATH_SEPARATOR "Spool%03d.tmp", Platform::InstallPath(), Platform::config.cachePath, id) < _MAX_PATH;
+}
+
+bool ImageSpool::Open()
+{
+	char path[_MAX_PATH];
+	if (!GetImageSpoolPath(path, id))
+	{
+		Platform::Log("Image spool path too long: %s", Platform::config.cachePath);
+		return false;
+	}
+
+	file = fopen(path, "wb");
+	if (!file)
+	{
+		// The cache directory isn't shipped, so it is made when the first spool needs it
+		char directory[_MAX_PATH];
+		if (snprintf(directory, _MAX_PATH, "%s" PATH_SEPARATOR "%s", Platform::InstallPath(), Platform::config.cachePath) < _MAX_PATH
+			&& Platform::MakeDirectory(directory))
+		{
+			file = fopen(path, "wb");
+		}
+	}
+
+	if (!file)
+	{
+		Platform::Log("Could not open image spool: %s", path);
 	}
+	return file != NULL;
+}
+
+bool ImageSpool::Write(const char* buffer, size_t count)
+{
+	return fwrite(buffer, 1, count, file) == count;
+}
+
+void ImageSpool::Close(bool complete)
+{
+	if (file)
+	{
+		fclose(file);
+		file = NULL;
+		isComplete = complete;
+
+		if (!complete)
+		{
+			Remove();
+		}
+	}
+}
+
+void ImageSpool::Load(LoadTask& loadTask)
+{
+	char path[_MAX_PATH + 7];
+	strcpy(path, "file://");
+	// Open has already checked that the path fits
+	if (GetImageSpoolPath(path + 7, id))
+	{
+		loadTask.Load(path);
+		loadTask.contentType = contentType;
+	}
+}
+
+void ImageSpool::Remove()
+{
+	Close(true);
+
+	char path[_MAX_PATH];
+	if (GetImageSpoolPath(path, id))
+	{
+		remove(path);
+	}
+	isComplete = false;
+}
+
+bool App::IsProbingImages()
+{
+	if (!config.loadImages)
+	{
+		return false;
+	}
+
+	for (int n = 0; n < MAX_IMAGE_PROBE_TASKS; n++)
+	{
+		if (imageProbeTasks[n].node)
+		{
+			return true;
+		}
+	}
+
+	// Laid out nodes that haven't been reached by the scan
+	Node* nextNode = lastImageProbeScanNode ? lastImageProbeScanNode->GetNextInTree() : page.GetRootNode();
+	return nextNode != NULL && nextNode != page.layout.currentNodeToProcess;
 }
 
 void LoadTask::Load(const char* targetURL)
@@ -516,6 +929,7 @@ void App::StopLoad()
 {
 	pageLoadTask.Stop();
 	pageContentLoadTask.Stop();
+	StopImageProbes();
 }
 
 void App::ShowErrorPage(const char* message)
@@ -593,6 +1007,8 @@ void App::ReloadPage()
 {
 	if (*pageHistoryPtr)
 	{
+		// Images may have changed too, and cached ones aren't known to belong to this page
+		ImageCache::Get().Clear();
 		RequestNewPage(pageHistoryPtr);
 	}
 }
@@ -600,6 +1016,7 @@ void App::ReloadPage()
 void App::LoadImageNodeContent(Node* node)
 {
 	loadTaskTargetNode = node;
+	resumedImageSpoolLoad = false;
 	node->Handler().LoadContent(node, pageContentLoadTask);
 }
 
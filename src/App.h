@@ -22,9 +22,12 @@
 #include "Interface.h"
 #include "Render.h"
 #include "DataPack.h"
+#include "Platform.h"
+#include "Image/Probe.h"
 
 #define MAX_PAGE_HISTORY_BUFFER_SIZE MAX_URL_LENGTH
 #define APP_LOAD_BUFFER_SIZE 256
+#define MAX_IMAGE_PROBE_TASKS MAX_CONCURRENT_HTTP_REQUESTS		// Probes take request slots from the page and image downloads
 
 class HTTPRequest;
 
@@ -64,6 +67,39 @@ struct LoadTask
 	char* contentType;
 };
 
+// Copy of an image fetched by its dimension probe, so that loading the content doesn't download it again
+struct ImageSpool
+{
+	ImageSpool() : next(NULL), source(NULL), node(NULL), contentType(NULL), file(NULL), id(0), isComplete(false) {}
+
+	bool Open();
+	bool Write(const char* buffer, size_t count);
+	void Close(bool complete);
+	void Load(LoadTask& loadTask);
+	void Remove();
+	bool IsWriting() { return file != NULL; }
+
+	ImageSpool* next;
+	const char* source;
+	Node* node;			// Image that was probed
+	char* contentType;
+	FILE* file;
+	int id;
+	bool isComplete;
+};
+
+// Finds the dimensions of an image while the page is still being laid out.
+// Remote images then carry on downloading into a spool
+struct ImageProbeTask
+{
+	ImageProbeTask() : node(NULL), spool(NULL) {}
+
+	LoadTask loadTask;
+	Node* node;
+	ImageProbe probe;
+	ImageSpool* spool;
+};
+
 struct Widget;
 
 struct AppConfig
@@ -73,6 +109,7 @@ struct AppConfig
 	bool invertScreen : 1;
 	bool useSwap : 1;
 	bool useEMS : 1;
+	bool glyphCache : 1;
 };
 
 class App
@@ -105,10 +142,25 @@ public:
 	LoadTask pageContentLoadTask;
 
 	void LoadImageNodeContent(Node* node);
+	bool IsProbingImages();
+	bool IsSpoolingImages();
+	ImageSpool* FindImageSpool(const char* source);
 
 private:
+	friend class PageLoadBenchmark;
+
+	void Init();
 	void ResetPage();
 	void RequestNewPage(const char* url);
+	void StartNewPage();
+	void UpdatePageLoadTask();
+	void UpdateContentLoadTask();
+	void UpdateImageProbeTasks();
+	bool StartImageProbe(ImageProbeTask& task, Node* node);
+	void FinishImageProbe(ImageProbeTask& task);
+	void StopImageProbes();
+	void FinishImageSpool(ImageProbeTask& task, bool complete);
+	void RemoveImageSpools();
 
 	void ShowNoHTTPSPage();
 
@@ -122,6 +174,12 @@ private:
 	static App* app;
 
 	char loadBuffer[APP_LOAD_BUFFER_SIZE];
+
+	ImageProbeTask imageProbeTasks[MAX_IMAGE_PROBE_TASKS];
+	Node* lastImageProbeScanNode;
+	ImageSpool* imageSpools;
+	int numImageSpools;
+	bool resumedImageSpoolLoad;
 };
 
 
@@ -68,7 +68,7 @@ int Cache::GetFreeId()
 void Cache::ReadCache()
 {
 	loadEntry = NULL;
-	snprintf(cacheInfoPath, _MAX_PATH, "%s\\%s\\%s", Platform::InstallPath(), Platform::config.cachePath, CacheInfoFile);
+	snprintf(cacheInfoPath, _MAX_PATH, "%s" PATH_SEPARATOR "%s" PATH_SEPARATOR "%s", Platform::InstallPath(), Platform::config.cachePath, CacheInfoFile);
 	ini_parse(cacheInfoPath, &CacheLoadHandler, this);
 	if(loadEntry)
 	{
@@ -79,7 +79,7 @@ void Cache::ReadCache()
 
 void Cache::WriteCache()
 {
-	snprintf(cacheInfoPath, _MAX_PATH, "%s\\%s\\%s", Platform::InstallPath(), Platform::config.cachePath, CacheInfoFile);
+	snprintf(cacheInfoPath, _MAX_PATH, "%s" PATH_SEPARATOR "%s" PATH_SEPARATOR "%s", Platform::InstallPath(), Platform::config.cachePath, CacheInfoFile);
 	FILE *f = fopen(cacheInfoPath, "w");
 	for(size_t i = 0; i < cacheEntryCount; ++i)
 	{
@@ -149,7 +149,7 @@ void Cache::RemoveEntry(int id)
 	}
 	--cacheEntryCount;
 	char cacheDataPath[_MAX_PATH];
-	snprintf(cacheDataPath, _MAX_PATH, "%s\\%s\\%i.dat", Platform::InstallPath(), Platform::config.cachePath, id);
+	snprintf(cacheDataPath, _MAX_PATH, "%s" PATH_SEPARATOR "%s" PATH_SEPARATOR "%i.dat", Platform::InstallPath(), Platform::config.cachePath, id);
 	remove(cacheDataPath);
 }
 
@@ -161,7 +161,7 @@ off_t Cache::CalculateCacheSize()
 	{
 		CacheEntry* entry = entries[i];
 		char cacheDataPath[_MAX_PATH];
-		snprintf(cacheDataPath, _MAX_PATH, "%s\\%s\\%i.dat", Platform::InstallPath(), Platform::config.cachePath, entry->id);
+		snprintf(cacheDataPath, _MAX_PATH, "%s" PATH_SEPARATOR "%s" PATH_SEPARATOR "%i.dat", Platform::InstallPath(), Platform::config.cachePath, entry->id);
 		struct stat info;
 		stat(cacheDataPath, &info);
 		size += info.st_size;
@@ -267,7 +267,7 @@ FILE* Cache::Get(const char* url, time_t* expiry, char** contentType)
 	if(!entry) return NULL;
 
 	char cacheDataPath[_MAX_PATH];
-	snprintf(cacheDataPath, _MAX_PATH, "%s\\%s\\%i.dat", Platform::InstallPath(), Platform::config.cachePath, entry->id);
+	snprintf(cacheDataPath, _MAX_PATH, "%s" PATH_SEPARATOR "%s" PATH_SEPARATOR "%i.dat", Platform::InstallPath(), Platform::config.cachePath, entry->id);
 	if(expiry) *expiry = entry->expiry;
 	if(contentType) *contentType = entry->contentType;
 	return fopen(cacheDataPath, "rb");
@@ -417,7 +417,7 @@ bool CacheInfo::ShouldCache(const char* url)
 CacheWriter::CacheWriter(CacheEntry *e) : entry(e)
 {
 	char cacheDataPath[_MAX_PATH];
-	snprintf(cacheDataPath, _MAX_PATH, "%s\\%s\\%i.dat", Platform::InstallPath(), Platform::config.cachePath, entry->id);
+	snprintf(cacheDataPath, _MAX_PATH, "%s" PATH_SEPARATOR "%s" PATH_SEPARATOR "%i.dat", Platform::InstallPath(), Platform::config.cachePath, entry->id);
 	f = fopen(cacheDataPath, "wb");
 }
 
@@ -431,7 +431,7 @@ void CacheWriter::Abort()
 	fclose(f);
 	f = NULL;
 	char cacheDataPath[_MAX_PATH];
-	snprintf(cacheDataPath, _MAX_PATH, "%s\\%s\\%i.dat", Platform::InstallPath(), Platform::config.cachePath, entry->id);
+	snprintf(cacheDataPath, _MAX_PATH, "%s" PATH_SEPARATOR "%s" PATH_SEPARATOR "%i.dat", Platform::InstallPath(), Platform::config.cachePath, entry->id);
 	remove(cacheDataPath);
 }
 
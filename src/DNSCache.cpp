@@ -0,0 +1,199 @@
+//
+// Copyright (C) 2021 James Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+
+#include "DNSCache.h"
+#include "ini.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const char* const DNSCacheFile = "dns.inf";
+
+// Returns false if the path doesn't fit
+static bool GetDNSCachePath(char* path)
+{
+	return snprintf(path, _MAX_PATH, "%s" PATH_SEPARATOR "%s" PATH_SEPARATOR "%s", Platform::InstallPath(), Platform::config.cachePath, DNSCacheFile) < _MAX_PATH;
+}
+
+DNSCache::DNSCache()
+{
+	memset(entries, 0, sizeof(entries));
+	if(Platform::config.enableCache)
+	{
+		Load();
+	}
+}
+
+DNSCache& DNSCache::Get()
+{
+	static DNSCache cache;
+	return cache;
+}
+
+DNSCache::Entry* DNSCache::Find(const char* hostname)
+{
+	for(int i = 0; i < DNS_CACHE_SIZE; ++i)
+	{
+		if(entries[i].hostname[0] && stricmp(entries[i].hostname, hostname) == 0)
+		{
+			return &entries[i];
+		}
+	}
+	return NULL;
+}
+
+bool DNSCache::Lookup(const char* hostname, NetworkAddress address)
+{
+	Entry* entry = Find(hostname);
+	if(!entry)
+	{
+		return false;
+	}
+	if(entry->expiry < time(NULL))
+	{
+		entry->hostname[0] = '\0';
+		return false;
+	}
+
+	memcpy(address, entry->address, sizeof(NetworkAddress));
+	return true;
+}
+
+void DNSCache::Add(const char* hostname, NetworkAddress address)
+{
+	if(strlen(hostname) >= DNS_CACHE_HOSTNAME_LENGTH)
+	{
+		return;
+	}
+
+	Entry* entry = Find(hostname);
+	if(!entry)
+	{
+		// Replace whichever entry expires first, which will be an empty one if there are any
+		entry = &entries[0];
+		for(int i = 0; i < DNS_CACHE_SIZE; ++i)
+		{
+			if(!entries[i].hostname[0])
+			{
+				entry = &entries[i];
+				break;
+			}
+			if(entries[i].expiry < entry->expiry)
+			{
+				entry = &entries[i];
+			}
+		}
+		strcpy(entry->hostname, hostname);
+	}
+
+	memcpy(entry->address, address, sizeof(NetworkAddress));
+	entry->expiry = time(NULL) + DNS_CACHE_TTL_SECONDS;
+	Save();
+}
+
+void DNSCache::Remove(const char* hostname)
+{
+	Entry* entry = Find(hostname);
+	if(entry)
+	{
+		entry->hostname[0] = '\0';
+		Save();
+	}
+}
+
+int DNSCache::LoadHandler(void* user, const char* section, const char* name, const char* value)
+{
+	DNSCache *that = (DNSCache*)user;
+	Entry* entry = that->Find(section);
+	if(!entry)
+	{
+		if(strlen(section) >= DNS_CACHE_HOSTNAME_LENGTH)
+		{
+			return 1;
+		}
+		for(int i = 0; i < DNS_CACHE_SIZE && !entry; ++i)
+		{
+			if(!that->entries[i].hostname[0])
+			{
+				entry = &that->entries[i];
+			}
+		}
+		if(!entry)
+		{
+			return 1;
+		}
+		strcpy(entry->hostname, section);
+		entry->expiry = 0;
+	}
+
+	if(strcmp(name, "address") == 0)
+	{
+		int a, b, c, d;
+		if(sscanf(value, "%d.%d.%d.%d", &a, &b, &c, &d) == 4)
+		{
+			entry->address[0] = (uint8_t)a;
+			entry->address[1] = (uint8_t)b;
+			entry->address[2] = (uint8_t)c;
+			entry->address[3] = (uint8_t)d;
+		}
+	}
+	else if(strcmp(name, "expiry") == 0)
+	{
+		entry->expiry = atol(value);
+	}
+
+	return 1;
+}
+
+void DNSCache::Load()
+{
+	char path[_MAX_PATH];
+	if(GetDNSCachePath(path))
+	{
+		ini_parse(path, &LoadHandler, this);
+	}
+}
+
+void DNSCache::Save()
+{
+	if(!Platform::config.enableCache)
+	{
+		return;
+	}
+
+	char path[_MAX_PATH];
+	if(!GetDNSCachePath(path))
+	{
+		return;
+	}
+	FILE *f = fopen(path, "w");
+	if(!f)
+	{
+		return;
+	}
+
+	time_t now = time(NULL);
+	for(int i = 0; i < DNS_CACHE_SIZE; ++i)
+	{
+		Entry& entry = entries[i];
+		if(entry.hostname[0] && entry.expiry >= now)
+		{
+			fprintf(f, "[%s]\n", entry.hostname);
+			fprintf(f, "address = %d.%d.%d.%d\n", entry.address[0], entry.address[1], entry.address[2], entry.address[3]);
+			fprintf(f, "expiry = %li\n", (long)entry.expiry);
+			fprintf(f, "\n");
+		}
+	}
+	fclose(f);
+}
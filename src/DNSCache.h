@@ -0,0 +1,55 @@
+//
+// Copyright (C) 2021 James Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+
+#pragma once
+#ifndef _DNSCACHE_H_
+#define _DNSCACHE_H_
+
+#include <time.h>
+#include "Platform.h"
+
+#define DNS_CACHE_SIZE 16
+#define DNS_CACHE_HOSTNAME_LENGTH 64
+#define DNS_CACHE_TTL_SECONDS (60 * 60)
+
+// Remembers resolved host names so that each server is only looked up once.
+// Saved next to cache.inf when the page cache is enabled
+class DNSCache
+{
+	private:
+		struct Entry
+		{
+			char hostname[DNS_CACHE_HOSTNAME_LENGTH];
+			NetworkAddress address;
+			time_t expiry;
+		};
+
+		Entry entries[DNS_CACHE_SIZE];
+
+		DNSCache();
+
+		Entry* Find(const char* hostname);
+		void Load();
+		void Save();
+
+		static int LoadHandler(void* user, const char* section, const char* name, const char* value);
+	public:
+		static DNSCache& Get();
+
+		bool Lookup(const char* hostname, NetworkAddress address);
+		void Add(const char* hostname, NetworkAddress address);
+		void Remove(const char* hostname);
+};
+
+#endif
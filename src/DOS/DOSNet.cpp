@@ -86,6 +86,7 @@ void DOSNetworkDriver::Shutdown()
 {
 	if (isConnected)
 	{
+		HTTPRequest::CloseIdleConnections();
 		Utils::endStack();
 		isConnected = false;
 	}
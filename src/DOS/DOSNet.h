@@ -21,10 +21,8 @@
 
 #ifdef HP95LX
 #define TCP_RECV_BUFFER_SIZE  (8192)
-#define MAX_CONCURRENT_HTTP_REQUESTS 1
 #else
 #define TCP_RECV_BUFFER_SIZE  (16384)
-#define MAX_CONCURRENT_HTTP_REQUESTS 2
 #endif
 
 struct TcpSocket;
@@ -110,6 +110,34 @@ MemBlockHandle EMSManager::Allocate(size_t size)
     return result;
 }
 
+// Takes a whole page off the end of the allocation, so that Reset() never hands it out again
+MemBlockHandle EMSManager::AllocatePersistent(size_t size)
+{
+    MemBlockHandle result;
+
+    if (size <= EMS_PAGE_SIZE && numAllocatedPages > allocationPageIndex + 1)
+    {
+        numAllocatedPages--;
+        result.emsPage = numAllocatedPages;
+        result.emsPageOffset = 0;
+        result.type = MemBlockHandle::EMS;
+    }
+
+    return result;
+}
+
+// Only the page at the bottom of the persistent pages can go back to the allocation
+bool EMSManager::FreePersistent(MemBlockHandle& handle)
+{
+    if (handle.type == MemBlockHandle::EMS && handle.emsPage == numAllocatedPages)
+    {
+        numAllocatedPages++;
+        return true;
+    }
+
+    return false;
+}
+
 void* EMSManager::MapBlock(MemBlockHandle& handle)
 {
     if (isAvailable && handle.type == MemBlockHandle::EMS)
@@ -19,6 +19,8 @@ public:
 	bool IsAvailable() { return isAvailable; }
 
 	MemBlockHandle Allocate(size_t size);
+	MemBlockHandle AllocatePersistent(size_t size);
+	bool FreePersistent(MemBlockHandle& handle);
 	void* MapBlock(MemBlockHandle& handle);
 
 	void Shutdown();
@@ -163,6 +163,7 @@ static int AutoDetectVideoMode()
 #include "../ini.h"
 
 #include <libgen.h>
+#include <direct.h>
 
 #define INI_MATCH(s, n) (strcmp(section, s) == 0 && strcmp(name, n) == 0)
 
@@ -333,3 +334,8 @@ const char* Platform::InstallPath()
 	return installPath;
 }
 
+bool Platform::MakeDirectory(const char* path)
+{
+	return mkdir(path) == 0;
+}
+
@@ -447,7 +447,7 @@ void DrawSurface_4BPP_PC1512::DrawString(DrawContext& context, Font* font, const
 
 void DrawSurface_4BPP_PC1512::BlitImage(DrawContext& context, Image* image, int x, int y)
 {
-	if (!image->lines.IsAllocated() )
+	if (!image->strips.IsAllocated() )
 		return;
 
 	x += context.drawOffsetX;
@@ -495,17 +495,16 @@ void DrawSurface_4BPP_PC1512::BlitImage(DrawContext& context, Image* image, int
 	if (image->bpp == 1)
 	{
 		// Blit the image data line by line
-		for (int j = 0; j < destHeight; j++)
+		ImageLineIterator imageLines(image, srcY);
+		for (int j = 0; j < destHeight; j++, imageLines.Next())
 		{
-			MemBlockHandle* imageLines = image->lines.Get<MemBlockHandle*>();
-			MemBlockHandle imageLine = imageLines[j + srcY];
 
 			for (int plane = 0; plane < 4; plane++)
 			{
 				SetPlaneRead(plane);
 				SetPlaneWriteMask(planeBits[plane]);
 
-				uint8_t* src = imageLine.Get<uint8_t*>() + (srcX >> 3);
+				uint8_t* src = imageLines.Get() + (srcX >> 3);
 				uint8_t* dest = lines[y + j] + (x >> 3);
 				uint8_t srcMask = 0x80 >> (srcX & 7);
 				uint8_t destMask = 0x80 >> (x & 7);
@@ -543,10 +542,9 @@ void DrawSurface_4BPP_PC1512::BlitImage(DrawContext& context, Image* image, int
 	else
 	{
 		// Blit the image data line by line
-		for (int j = 0; j < destHeight; j++)
+		ImageLineIterator imageLines(image, srcY);
+		for (int j = 0; j < destHeight; j++, imageLines.Next())
 		{
-			MemBlockHandle* imageLines = image->lines.Get<MemBlockHandle*>();
-			MemBlockHandle imageLine = imageLines[j + srcY];
 
 			for (int plane = 0; plane < 4; plane++)
 			{
@@ -554,7 +552,7 @@ void DrawSurface_4BPP_PC1512::BlitImage(DrawContext& context, Image* image, int
 				uint8_t planeMask = planeBits[plane];
 				SetPlaneWriteMask(planeMask);
 
-				uint8_t* src = imageLine.Get<uint8_t*>() + (srcX >> 3);
+				uint8_t* src = imageLines.Get() + (srcX >> 3);
 				uint8_t* dest = lines[y + j] + (x >> 3);
 				uint8_t destMask = 0x80 >> (x & 7);
 				uint8_t srcBuffer = (*src++);
@@ -428,7 +428,7 @@ static void BlitLineASM(uint8_t* srcPtr, uint8_t* destLine, uint8_t destMask, in
 
 void DrawSurface_4BPP::BlitImage(DrawContext& context, Image* image, int x, int y)
 {
-	if (!image->lines.IsAllocated())
+	if (!image->strips.IsAllocated())
 		return;
 	x += context.drawOffsetX;
 	y += context.drawOffsetY;
@@ -489,11 +489,10 @@ void DrawSurface_4BPP::BlitImage(DrawContext& context, Image* image, int x, int
 		int destOffset = (x >> 3);
 
 		// Blit the image data line by line
-		for (int j = 0; j < destHeight; j++)
+		ImageLineIterator imageLines(image, srcY);
+		for (int j = 0; j < destHeight; j++, imageLines.Next())
 		{
-			MemBlockHandle* imageLines = image->lines.Get<MemBlockHandle*>();
-			MemBlockHandle imageLine = imageLines[srcY + j];
-			uint8_t* src = imageLine.Get<uint8_t*>() + srcX;
+			uint8_t* src = imageLines.Get() + srcX;
 
 #if USE_ASM_ROUTINES
 			uint8_t* dest = lines[y + j] + destOffset;
@@ -546,13 +545,12 @@ void DrawSurface_4BPP::BlitImage(DrawContext& context, Image* image, int x, int
 		outp(GC_INDEX, GC_BITMASK);
 
 		// Blit the image data line by line
-		for (int j = 0; j < destHeight; j++)
+		ImageLineIterator imageLines(image, srcY);
+		for (int j = 0; j < destHeight; j++, imageLines.Next())
 		{
 			outp(GC_DATA, 0xff);
 
-			MemBlockHandle* imageLines = image->lines.Get<MemBlockHandle*>();
-			MemBlockHandle imageLine = imageLines[j + srcY];
-			uint8_t* src = imageLine.Get<uint8_t*>() + (srcX >> 3);
+			uint8_t* src = imageLines.Get() + (srcX >> 3);
 			uint8_t* dest = lines[y + j] + (x >> 3);
 			uint8_t srcMask = 0x80 >> (srcX & 7);
 			uint8_t destMask = 0x80 >> (x & 7);
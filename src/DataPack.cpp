@@ -11,10 +11,10 @@ DataPack Assets;
 
 const char* DataPack::datapackFilenames[] =
 {
-	"CGA.DAT",
-	"EGA.DAT",
-	"DEFAULT.DAT",
-	"LOWRES.DAT"
+	"CGA.dat",
+	"EGA.dat",
+	"Default.dat",
+	"LowRes.dat"
 };
 
 static char dataPackPath[_MAX_PATH];
@@ -35,7 +35,7 @@ size_t DataPackData::Read(size_t offset, char* buffer, size_t bytes)
 
 bool DataPack::LoadPreset(DataPack::Preset preset)
 {
-	snprintf(dataPackPath, _MAX_PATH, "%s\\%s", Platform::InstallPath(), datapackFilenames[preset]);
+	snprintf(dataPackPath, _MAX_PATH, "%s" PATH_SEPARATOR "%s", Platform::InstallPath(), datapackFilenames[preset]);
 	return Load(dataPackPath);
 }
 
@@ -88,9 +88,42 @@ bool DataPack::Load(const char* path)
 	delete[] header.entries;
 	fclose(fs);
 
+	BuildFontWidthTables();
+
 	return true;
 }
 
+void DataPack::BuildFontWidthTables()
+{
+	if (!fontWidthTables)
+	{
+		fontWidthTables = new uint8_t[NUM_FONT_WIDTH_TABLES * 256];
+		if (!fontWidthTables)
+		{
+			Platform::FatalError("Could not allocate memory for font width tables");
+			return;
+		}
+	}
+
+	uint8_t* table = fontWidthTables;
+
+	for (int n = 0; n < NUM_FONT_SIZES * 2; n++)
+	{
+		Font* font = n < NUM_FONT_SIZES ? fonts[n] : monoFonts[n - NUM_FONT_SIZES];
+
+		for (int bold = 0; bold < 2; bold++)
+		{
+			memset(table, 0, FIRST_FONT_GLYPH);
+			for (int c = FIRST_FONT_GLYPH; c < 256; c++)
+			{
+				uint8_t width = font->glyphs[c - FIRST_FONT_GLYPH].width;
+				table[c] = width ? width + bold : 0;
+			}
+			table += 256;
+		}
+	}
+}
+
 int DataPack::FontSizeToIndex(int fontSize)
 {
 	switch (fontSize)
@@ -118,6 +151,18 @@ Font* DataPack::GetFont(int fontSize, FontStyle::Type fontStyle)
 	}
 }
 
+const uint8_t* DataPack::GetFontWidths(int fontSize, FontStyle::Type fontStyle)
+{
+	int index = FontSizeToIndex(fontSize);
+	if (fontStyle & FontStyle::Monospace)
+	{
+		index += NUM_FONT_SIZES;
+	}
+	index = index * 2 + ((fontStyle & FontStyle::Bold) ? 1 : 0);
+
+	return fontWidthTables + index * 256;
+}
+
 MouseCursorData* DataPack::GetMouseCursorData(MouseCursor::Type type)
 {
 	switch (type)
@@ -142,18 +187,16 @@ Image* DataPack::LoadImageAsset(FILE* fs, DataPackHeader& header, const char* en
 		{
 			Platform::FatalError("Could not allocate memory for data pack image %s", entryName);
 		}
-		memcpy(image, asset, sizeof(ImageMetadata));
+		memcpy(static_cast<ImageMetadata*>(image), asset, sizeof(ImageMetadata));
 		uint8_t* data = ((uint8_t*) asset) + sizeof(ImageMetadata);
-		MemBlockHandle* lines = new MemBlockHandle[image->height];
-		if (!lines)
+		MemBlockHandle* strips = new MemBlockHandle[1];
+		if (!strips)
 		{
 			Platform::FatalError("Could not allocate memory for data pack image %s", entryName);
 		}
-		for (int y = 0; y < image->height; y++)
-		{
-			lines[y] = MemBlockHandle(data + y * image->pitch);
-		}
-		image->lines = MemBlockHandle(lines);
+		strips[0] = MemBlockHandle(data);
+		image->strips = MemBlockHandle(strips);
+		image->linesPerStrip = image->height;
 
 		return image;
 	}
@@ -37,6 +37,7 @@ uint8 glyphData[variable]
 */
 
 #define NUM_FONT_SIZES 3
+#define NUM_FONT_WIDTH_TABLES (NUM_FONT_SIZES * 2 * 2)		// Proportional and monospace, regular and bold
 
 struct DataPackEntry
 {
@@ -98,11 +99,18 @@ struct DataPack
 	Font* GetFont(int fontSize, FontStyle::Type fontStyle);
 	MouseCursorData* GetMouseCursorData(MouseCursor::Type type);
 
+	// Width of each character in the font for a style, indexed by character code with
+	// emboldening already added. Characters without a glyph have zero width
+	const uint8_t* GetFontWidths(int fontSize, FontStyle::Type fontStyle);
+
 private:
 	void* LoadAsset(FILE* fs, DataPackHeader& header, const char* entryName, void* buffer = NULL, size_t* size = NULL);
 	Image* LoadImageAsset(FILE* fs, DataPackHeader& header, const char* entryName);
 	DataPackData* LoadDataAsset(FILE* fs,  DataPackHeader& header, const char* entryName);
 	int FontSizeToIndex(int fontSize);
+	void BuildFontWidthTables();
+
+	uint8_t* fontWidthTables;
 	static const char* datapackFilenames[];
 };
 
@@ -17,3 +17,17 @@
 #endif
 
 #endif
+
+#if defined(__unix__) || defined(__APPLE__)
+// POSIX builds have no Microsoft/Watcom string and path extensions
+#include <strings.h>
+
+#define stricmp strcasecmp
+#define strnicmp strncasecmp
+
+#ifndef _MAX_PATH
+#define _MAX_PATH 260
+#endif
+
+#define PATH_SEPARATOR "/"
+#endif
@@ -0,0 +1,185 @@
+//
+// Copyright (C) 2021 James Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "GlyphCache.h"
+#include "../Memory/Memory.h"
+
+GlyphCache::GlyphCache()
+	: numSets(0)
+	, chunk(nullptr)
+	, chunkUsed(0)
+	, conventionalAllocated(0)
+	, emsBlockUsed(0)
+	, numEMSBlocks(0)
+	, totalAllocated(0)
+	, isFull(false)
+{
+}
+
+GlyphCache& GlyphCache::Get()
+{
+	static GlyphCache cache;
+	return cache;
+}
+
+GlyphCache::GlyphSet* GlyphCache::GetSet(Font* font, bool bold)
+{
+	for (int n = 0; n < numSets; n++)
+	{
+		if (sets[n]->font == font && sets[n]->bold == bold)
+		{
+			return sets[n];
+		}
+	}
+
+	// The set itself is conventional memory too, so with no budget the cache isn't used at all
+	if (isFull || numSets == GLYPH_CACHE_MAX_SETS || conventionalAllocated + (long)sizeof(GlyphSet) > GLYPH_CACHE_BUDGET)
+	{
+		return nullptr;
+	}
+
+	GlyphSet* set = (GlyphSet*)malloc(sizeof(GlyphSet));
+	if (!set)
+	{
+		isFull = true;
+		return nullptr;
+	}
+	conventionalAllocated += sizeof(GlyphSet);
+	totalAllocated += sizeof(GlyphSet);
+
+	set->font = font;
+	set->bold = bold;
+	for (int n = 0; n < NUM_GLYPH_ENTRIES; n++)
+	{
+		set->glyphs[n].type = MemBlockHandle::Unallocated;
+	}
+
+	sets[numSets++] = set;
+	return set;
+}
+
+MemBlockHandle GlyphCache::Allocate(uint16_t size)
+{
+	MemBlockHandle result;
+
+	if (chunk && chunkUsed + size <= GLYPH_CACHE_CHUNK_SIZE)
+	{
+		result = MemBlockHandle(chunk + chunkUsed);
+		chunkUsed += size;
+		return result;
+	}
+
+	if (conventionalAllocated + GLYPH_CACHE_CHUNK_SIZE <= GLYPH_CACHE_BUDGET)
+	{
+		uint8_t* newChunk = (uint8_t*)malloc(GLYPH_CACHE_CHUNK_SIZE);
+		if (newChunk)
+		{
+			// Whatever was left in the previous chunk is abandoned
+			chunk = newChunk;
+			chunkUsed = size;
+			conventionalAllocated += GLYPH_CACHE_CHUNK_SIZE;
+			totalAllocated += GLYPH_CACHE_CHUNK_SIZE;
+			return MemBlockHandle(chunk);
+		}
+	}
+
+	if (emsBlock.IsAllocated() && emsBlockUsed + size <= GLYPH_CACHE_EMS_BLOCK_SIZE)
+	{
+		result = emsBlock;
+		result.emsPageOffset += emsBlockUsed;
+		emsBlockUsed += size;
+		return result;
+	}
+
+	if (numEMSBlocks < GLYPH_CACHE_MAX_EMS_BLOCKS)
+	{
+		MemBlockHandle block = MemoryManager::pageBlockAllocator.AllocatePersistent(GLYPH_CACHE_EMS_BLOCK_SIZE);
+		if (block.IsAllocated())
+		{
+			emsBlock = block;
+			emsBlockUsed = size;
+			numEMSBlocks++;
+			totalAllocated += GLYPH_CACHE_EMS_BLOCK_SIZE;
+			return emsBlock;
+		}
+	}
+
+	isFull = true;
+	return result;
+}
+
+uint8_t* GlyphCache::BuildGlyph(GlyphSet* set, int index)
+{
+	if (isFull)
+	{
+		return nullptr;
+	}
+
+	Font* font = set->font;
+	uint8_t widthBytes = (uint8_t)((font->glyphs[index].width + 7) >> 3);
+	uint8_t stride = GetStride(font, index);
+	uint8_t height = font->glyphHeight;
+
+	if (widthBytes > GLYPH_CACHE_MAX_WIDTH_BYTES)
+	{
+		return nullptr;
+	}
+
+	MemBlockHandle handle = Allocate((uint16_t)(GLYPH_CACHE_PHASES * height * stride));
+	if (!handle.IsAllocated())
+	{
+		return nullptr;
+	}
+
+	uint8_t* shifted = handle.Get<uint8_t*>();
+	const uint8_t* glyphData = font->glyphData + font->glyphs[index].offset;
+	uint8_t row[GLYPH_CACHE_MAX_WIDTH_BYTES];
+
+	for (uint8_t j = 0; j < height; j++)
+	{
+		memcpy(row, glyphData, widthBytes);
+		glyphData += widthBytes;
+
+		if (set->bold)
+		{
+			// Same emboldening as DrawString, a pixel carried past the last byte is dropped
+			uint8_t boldCarry = 0;
+			for (uint8_t i = 0; i < widthBytes; i++)
+			{
+				uint8_t pixels = row[i];
+				row[i] |= (pixels >> 1) | (boldCarry ? 0x80 : 0);
+				boldCarry = pixels & 1;
+			}
+		}
+
+		for (uint8_t phase = 0; phase < GLYPH_CACHE_PHASES; phase++)
+		{
+			uint8_t* out = shifted + (phase * height + j) * stride;
+			uint8_t carry = 0;
+
+			for (uint8_t i = 0; i < widthBytes; i++)
+			{
+				out[i] = carry | (uint8_t)(row[i] >> phase);
+				carry = (uint8_t)(row[i] << (8 - phase));
+			}
+			out[widthBytes] = carry;
+		}
+	}
+
+	handle.Commit();
+	set->glyphs[index] = handle;
+	return shifted;
+}
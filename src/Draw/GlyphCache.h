@@ -0,0 +1,101 @@
+//
+// Copyright (C) 2021 James Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+
+#ifndef _GLYPHCACHE_H_
+#define _GLYPHCACHE_H_
+
+#include <stdint.h>
+#include "../Font.h"
+#include "../Memory/MemBlock.h"
+
+#define GLYPH_CACHE_PHASES 8
+#define GLYPH_CACHE_MAX_SETS 12			// Regular and bold for each font in the data pack
+#define GLYPH_CACHE_MAX_WIDTH_BYTES 32
+#define GLYPH_CACHE_CHUNK_SIZE (4 * 1024u)
+#define GLYPH_CACHE_EMS_BLOCK_SIZE (16 * 1024u)
+#define GLYPH_CACHE_MAX_EMS_BLOCKS 4
+#define GLYPH_CACHE_TEXT_CHUNK_SIZE 32		// Text is copied out of EMS in pieces this size
+
+// Conventional memory that can be spent on glyph sets and glyphs before falling back to EMS
+#if defined(HP95LX)
+#define GLYPH_CACHE_BUDGET 0l
+#elif defined(__DOS__)
+#define GLYPH_CACHE_BUDGET (16 * 1024l)
+#else
+#define GLYPH_CACHE_BUDGET (1024 * 1024l)
+#endif
+
+// Small fonts can draw slower through the cache, so on DOS it is off unless -glyphcache is given
+// until it has been measured on real hardware
+#if defined(__DOS__)
+#define GLYPH_CACHE_DEFAULT_ENABLED false
+#else
+#define GLYPH_CACHE_DEFAULT_ENABLED true
+#endif
+
+// Glyph bitmaps for 1bpp surfaces, pre-shifted to each of the 8 bit positions within a byte so
+// that drawing a glyph is a plain OR or AND-NOT of whole bytes. Bold is applied up front too.
+// Glyphs are converted the first time they are drawn. If memory runs out, the remaining glyphs
+// are shifted at draw time as before
+class GlyphCache
+{
+public:
+	struct GlyphSet
+	{
+		Font* font;
+		bool bold;
+		MemBlockHandle glyphs[NUM_GLYPH_ENTRIES];
+	};
+
+	static GlyphCache& Get();
+
+	GlyphSet* GetSet(Font* font, bool bold);
+
+	// Rows for each bit phase in turn, with glyphHeight rows of GetStride() bytes per phase
+	uint8_t* GetGlyph(GlyphSet* set, int index)
+	{
+		MemBlockHandle& handle = set->glyphs[index];
+		if (handle.IsAllocated())
+		{
+			return handle.Get<uint8_t*>();
+		}
+		return BuildGlyph(set, index);
+	}
+
+	static uint8_t GetStride(Font* font, int index) { return (uint8_t)(((font->glyphs[index].width + 7) >> 3) + 1); }
+
+	long TotalAllocated() { return totalAllocated; }
+
+private:
+	GlyphCache();
+
+	uint8_t* BuildGlyph(GlyphSet* set, int index);
+	MemBlockHandle Allocate(uint16_t size);
+
+	GlyphSet* sets[GLYPH_CACHE_MAX_SETS];
+	int numSets;
+
+	uint8_t* chunk;
+	uint16_t chunkUsed;
+	long conventionalAllocated;
+
+	MemBlockHandle emsBlock;
+	uint16_t emsBlockUsed;
+	int numEMSBlocks;
+
+	long totalAllocated;
+	bool isFull;
+};
+
+#endif
@@ -270,11 +270,59 @@ void DrawSurface_1BPP::DrawString(DrawContext& context, Font* font, const char*
 		y += firstLine;
 	}
 
-	uint8_t bold = (style & FontStyle::Bold) ? 1 : 0;
-
 	if (App::config.invertScreen)
 		colour = !colour;
 
+	GlyphCache::GlyphSet* glyphSet = nullptr;
+	if (App::config.glyphCache)
+	{
+		glyphSet = GlyphCache::Get().GetSet(font, (style & FontStyle::Bold) != 0);
+	}
+
+#ifdef __DOS__
+	if (glyphSet)
+	{
+		// The text may be in an EMS page which gets unmapped when a cached glyph is fetched from EMS,
+		// so draw from a copy in conventional memory
+		char buffer[GLYPH_CACHE_TEXT_CHUNK_SIZE + 1];
+
+		while (*text)
+		{
+			int length = 0;
+			while (length < GLYPH_CACHE_TEXT_CHUNK_SIZE && text[length])
+			{
+				buffer[length] = text[length];
+				length++;
+			}
+			buffer[length] = '\0';
+			text += length;
+
+			if (!DrawGlyphs(context, font, glyphSet, buffer, x, y, firstLine, glyphHeight, colour, style))
+			{
+				break;
+			}
+		}
+	}
+	else
+#endif
+	{
+		DrawGlyphs(context, font, glyphSet, text, x, y, firstLine, glyphHeight, colour, style);
+	}
+
+	if ((style & FontStyle::Underline) && y - firstLine + font->glyphHeight - 1 < context.clipBottom)
+	{
+		HLine(context, startX, y - firstLine + font->glyphHeight - 1 - context.drawOffsetY, x - startX - context.drawOffsetX, colour);
+	}
+
+}
+
+// Returns false if drawing stopped at the right of the clip region
+bool DrawSurface_1BPP::DrawGlyphs(DrawContext& context, Font* font, GlyphCache::GlyphSet* glyphSet, const char* text, int& x, int y, uint8_t firstLine, uint8_t glyphHeight, uint8_t colour, FontStyle::Type style)
+{
+	uint8_t bold = (style & FontStyle::Bold) ? 1 : 0;
+	uint8_t italicLines = (style & FontStyle::Italic) ? (font->glyphHeight >> 1) : 0;
+	GlyphCache& glyphCache = GlyphCache::Get();
+
 	while (*text)
 	{
 		unsigned char c = (unsigned char) *text++;
@@ -297,7 +345,46 @@ void DrawSurface_1BPP::DrawString(DrawContext& context, Font* font, const char*
 
 		if (x + glyphWidth > context.clipRight)
 		{
-			break;
+			return false;
+		}
+
+		uint8_t* shiftedData = glyphSet ? glyphCache.GetGlyph(glyphSet, index) : nullptr;
+
+		if (shiftedData)
+		{
+			// Rows are already shifted and emboldened so only need combining with the screen
+			uint8_t stride = GlyphCache::GetStride(font, index);
+			uint16_t phaseSize = font->glyphHeight * stride;
+			int outY = y;
+
+			for (uint8_t j = firstLine; j < glyphHeight; j++)
+			{
+				int rowX = j < italicLines ? x + 1 : x;
+				uint8_t phase = (uint8_t)(rowX) & 0x7;
+				uint8_t count = phase ? stride : stride - 1;
+				const uint8_t* src = shiftedData + phase * phaseSize + j * stride;
+				uint8_t* VRAMptr = lines[outY] + (rowX >> 3);
+
+				if (!colour)
+				{
+					for (uint8_t i = 0; i < count; i++)
+					{
+						VRAMptr[i] &= ~src[i];
+					}
+				}
+				else
+				{
+					for (uint8_t i = 0; i < count; i++)
+					{
+						VRAMptr[i] |= src[i];
+					}
+				}
+
+				outY++;
+			}
+
+			x += glyphWidth;
+			continue;
 		}
 
 		uint8_t* glyphData = font->glyphData + font->glyphs[index].offset;
@@ -313,7 +400,7 @@ void DrawSurface_1BPP::DrawString(DrawContext& context, Font* font, const char*
 			{
 				uint8_t writeOffset = (uint8_t)(x) & 0x7;
 
-				if ((style & FontStyle::Italic) && j < (font->glyphHeight >> 1))
+				if (j < italicLines)
 				{
 					writeOffset++;
 				}
@@ -352,7 +439,7 @@ void DrawSurface_1BPP::DrawString(DrawContext& context, Font* font, const char*
 			{
 				uint8_t writeOffset = (uint8_t)(x) & 0x7;
 
-				if ((style & FontStyle::Italic) && j < (font->glyphHeight >> 1))
+				if (j < italicLines)
 				{
 					writeOffset++;
 				}
@@ -394,16 +481,12 @@ void DrawSurface_1BPP::DrawString(DrawContext& context, Font* font, const char*
 		//}
 	}
 
-	if ((style & FontStyle::Underline) && y - firstLine + font->glyphHeight - 1 < context.clipBottom)
-	{
-		HLine(context, startX, y - firstLine + font->glyphHeight - 1 - context.drawOffsetY, x - startX - context.drawOffsetX, colour);
-	}
-
+	return true;
 }
 
 void DrawSurface_1BPP::BlitImage(DrawContext& context, Image* image, int x, int y)
 {
-	if (!image->lines.IsAllocated() || image->bpp != 1)
+	if (!image->strips.IsAllocated() || image->bpp != 1)
 		return;
 
 	x += context.drawOffsetX;
@@ -450,43 +533,86 @@ void DrawSurface_1BPP::BlitImage(DrawContext& context, Image* image, int x, int
 
 	uint8_t invertMask = App::config.invertScreen ? 0xff : 0;
 
-	// Blit the image data line by line
-	for (int j = 0; j < destHeight; j++)
+	// Destination bytes touched on each line, with masks for the partially covered bytes at either end
+	int lastX = x + destWidth - 1;
+	int numBytes = (lastX >> 3) - (x >> 3) + 1;
+	uint8_t leftMask = 0xff >> (x & 7);
+	uint8_t rightMask = (uint8_t)(0xff << (7 - (lastX & 7)));
+	if (numBytes == 1)
+	{
+		leftMask &= rightMask;
+	}
+
+	// Source bit that lands on the first bit of the first destination byte. This can be up to
+	// 7 bits before the start of the line, but those bits are always masked off
+	int srcBitStart = srcX - (x & 7);
+	int srcShift = srcBitStart & 7;
+	int srcByteStart = (srcBitStart - srcShift) / 8;
+	int srcLastByte = (srcX + destWidth - 1) >> 3;
+
+	ImageLineIterator imageLines(image, srcY);
+
+	for (int j = 0; j < destHeight; j++, imageLines.Next())
 	{
-		MemBlockHandle* imageLines = image->lines.Get<MemBlockHandle*>();
-		MemBlockHandle imageLine = imageLines[j + srcY];
-		uint8_t* src = imageLine.Get<uint8_t*>() + (srcX >> 3);
+		uint8_t* srcLine = imageLines.Get();
 		uint8_t* dest = lines[y + j] + (x >> 3);
-		uint8_t srcMask = 0x80 >> (srcX & 7);
-		uint8_t destMask = 0x80 >> (x & 7);
-		uint8_t srcBuffer = (*src++) ^ invertMask;
-		uint8_t destBuffer = *dest;
 
-		for (int i = 0; i < destWidth; i++)
+		if (!srcShift)
 		{
-			if (srcBuffer & srcMask)
-			{
-				destBuffer |= destMask;
-			}
-			else
-			{
-				destBuffer &= ~destMask;
-			}
-			srcMask >>= 1;
-			if (!srcMask)
+			// Same bit phase in source and destination so whole bytes can be copied
+			uint8_t* src = srcLine + srcByteStart;
+
+			*dest = (*dest & ~leftMask) | ((*src ^ invertMask) & leftMask);
+
+			if (numBytes > 1)
 			{
-				srcMask = 0x80;
-				srcBuffer = (*src++) ^ invertMask;
+				int middleBytes = numBytes - 2;
+				if (invertMask)
+				{
+					for (int i = 1; i <= middleBytes; i++)
+					{
+						dest[i] = ~src[i];
+					}
+				}
+				else
+				{
+					memcpy(dest + 1, src + 1, middleBytes);
+				}
+
+				dest[numBytes - 1] = (dest[numBytes - 1] & ~rightMask) | ((src[numBytes - 1] ^ invertMask) & rightMask);
 			}
-			destMask >>= 1;
-			if (!destMask)
+		}
+		else
+		{
+			// Each destination byte is made from two neighbouring source bytes shifted together as a word.
+			// Source bytes outside of the line are never read, they would only have been masked off
+			int srcIndex = srcByteStart;
+			uint16_t word = srcIndex >= 0 ? srcLine[srcIndex] : 0;
+			uint8_t shift = (uint8_t)(8 - srcShift);
+			uint8_t pixels;
+
+			srcIndex++;
+			word = (word << 8) | (srcIndex <= srcLastByte ? srcLine[srcIndex] : 0);
+			pixels = (uint8_t)(word >> shift) ^ invertMask;
+			*dest = (*dest & ~leftMask) | (pixels & leftMask);
+
+			if (numBytes > 1)
 			{
-				*dest++ = destBuffer;
-				destBuffer = *dest;
-				destMask = 0x80;
+				int middleBytes = numBytes - 2;
+				uint8_t* src = srcLine + srcIndex + 1;
+
+				for (int i = 1; i <= middleBytes; i++)
+				{
+					word = (word << 8) | *src++;
+					dest[i] = (uint8_t)(word >> shift) ^ invertMask;
+				}
+
+				srcIndex += middleBytes + 1;
+				word = (word << 8) | (srcIndex <= srcLastByte ? srcLine[srcIndex] : 0);
+				pixels = (uint8_t)(word >> shift) ^ invertMask;
+				dest[numBytes - 1] = (dest[numBytes - 1] & ~rightMask) | (pixels & rightMask);
 			}
 		}
-		*dest = destBuffer;
 	}
 }
 
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include "Surface.h"
+#include "GlyphCache.h"
 
 class DrawSurface_1BPP : public DrawSurface
 {
@@ -18,6 +19,9 @@ public:
 	virtual void InvertRect(DrawContext& context, int x, int y, int width, int height);
 	virtual void VerticalScrollBar(DrawContext& context, int x, int y, int height, int position, int size);
 	virtual void ScrollScreen(int top, int bottom, int width, int amount);
+
+private:
+	bool DrawGlyphs(DrawContext& context, Font* font, GlyphCache::GlyphSet* glyphSet, const char* text, int& x, int y, uint8_t firstLine, uint8_t glyphHeight, uint8_t colour, FontStyle::Type style);
 };
 
 #endif
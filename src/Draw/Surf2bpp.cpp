@@ -1,5 +1,5 @@
 #include <memory.h>
-#include "Surf2BPP.h"
+#include "Surf2bpp.h"
 #include "../Font.h"
 #include "../Image/Image.h"
 #include "../Memory/MemBlock.h"
@@ -290,7 +290,7 @@ void DrawSurface_2BPP::DrawString(DrawContext& context, Font* font, const char*
 
 void DrawSurface_2BPP::BlitImage(DrawContext& context, Image* image, int x, int y)
 {
-	if (!image->lines.IsAllocated())
+	if (!image->strips.IsAllocated())
 		return;
 
 	x += context.drawOffsetX;
@@ -337,11 +337,10 @@ void DrawSurface_2BPP::BlitImage(DrawContext& context, Image* image, int x, int
 
 	if (image->bpp == 8)
 	{
-		for (int j = 0; j < destHeight; j++)
+		ImageLineIterator imageLines(image, srcY);
+		for (int j = 0; j < destHeight; j++, imageLines.Next())
 		{
-			MemBlockHandle* imageLines = image->lines.Get<MemBlockHandle*>();
-			MemBlockHandle imageLine = imageLines[j + srcY];
-			uint8_t* src = imageLine.Get<uint8_t*>() + srcX;
+			uint8_t* src = imageLines.Get() + srcX;
 			uint8_t* dest = lines[y + j] + (x >> 2);
 			uint8_t destMask = bitmaskTable[x & 3];
 			uint8_t destBuffer = *dest;
@@ -368,11 +367,10 @@ void DrawSurface_2BPP::BlitImage(DrawContext& context, Image* image, int x, int
 	}
 	else if (image->bpp == 1)
 	{
-		for (int j = 0; j < destHeight; j++)
+		ImageLineIterator imageLines(image, srcY);
+		for (int j = 0; j < destHeight; j++, imageLines.Next())
 		{
-			MemBlockHandle* imageLines = image->lines.Get<MemBlockHandle*>();
-			MemBlockHandle imageLine = imageLines[j + srcY];
-			uint8_t* src = imageLine.Get<uint8_t*>() + (srcX >> 3);
+			uint8_t* src = imageLines.Get() + (srcX >> 3);
 			uint8_t* dest = lines[y + j] + (x >> 2);
 			uint8_t srcMask = 0x80 >> (srcX & 7);
 			uint8_t destMask = bitmaskTable[x & 3];
@@ -247,7 +247,7 @@ void DrawSurface_8BPP::DrawString(DrawContext& context, Font* font, const char*
 
 void DrawSurface_8BPP::BlitImage(DrawContext& context, Image* image, int x, int y)
 {
-	if (!image->lines.IsAllocated())
+	if (!image->strips.IsAllocated())
 		return;
 
 	x += context.drawOffsetX;
@@ -295,11 +295,10 @@ void DrawSurface_8BPP::BlitImage(DrawContext& context, Image* image, int x, int
 	if (image->bpp == 8)
 	{
 		// Blit the image data line by line
-		for (int j = 0; j < destHeight; j++)
+		ImageLineIterator imageLines(image, srcY);
+		for (int j = 0; j < destHeight; j++, imageLines.Next())
 		{
-			MemBlockHandle* imageLines = image->lines.Get<MemBlockHandle*>();
-			MemBlockHandle imageLine = imageLines[srcY + j];
-			uint8_t* src = imageLine.Get<uint8_t*>() + srcX;
+			uint8_t* src = imageLines.Get() + srcX;
 			uint8_t* destRow = lines[y + j] + x;
 
 			for (int i = 0; i < destWidth; i++)
@@ -317,11 +316,10 @@ void DrawSurface_8BPP::BlitImage(DrawContext& context, Image* image, int x, int
 	else if (image->bpp == 1)
 	{
 		// Blit the image data line by line
-		for (int j = 0; j < destHeight; j++)
+		ImageLineIterator imageLines(image, srcY);
+		for (int j = 0; j < destHeight; j++, imageLines.Next())
 		{
-			MemBlockHandle* imageLines = image->lines.Get<MemBlockHandle*>();
-			MemBlockHandle imageLine = imageLines[srcY + j];
-			uint8_t* src = imageLine.Get<uint8_t*>() + (srcX >> 3);
+			uint8_t* src = imageLines.Get() + (srcX >> 3);
 			uint8_t srcMask = 0x80 >> (srcX & 7);
 			uint8_t* destRow = lines[y + j] + x;
 			uint8_t black = 0;
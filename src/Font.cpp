@@ -14,32 +14,6 @@
 
 #include "Font.h"
 
-int Font::CalculateWidth(const char* text, FontStyle::Type style)
-{
-	int result = 0;
-
-	uint8_t bold = (style & FontStyle::Bold) ? 1 : 0;
-
-	while (*text)
-	{
-		char c = *text++;
-
-		int index = (unsigned char)c - FIRST_FONT_GLYPH;
-		if (index < 0)
-		{
-			continue;
-		}
-
-		uint8_t width = glyphs[index].width;
-		if (width)
-		{
-			result += width + bold;
-		}
-	}
-
-	return result;
-}
-
 int Font::GetGlyphWidth(char c, FontStyle::Type style)
 {
 	int index = (unsigned char)(c)-FIRST_FONT_GLYPH;
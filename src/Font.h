@@ -47,7 +47,6 @@ struct Font
 	uint8_t glyphHeight;
 	uint8_t glyphData[1];
 
-	int CalculateWidth(const char* text, FontStyle::Type style = FontStyle::Regular);
 	int GetGlyphWidth(char c, FontStyle::Type style = FontStyle::Regular);
 };
 
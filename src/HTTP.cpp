@@ -2,8 +2,92 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "HTTP.h"
+#include "DNSCache.h"
 
-HTTPRequest::HTTPRequest() : status(HTTPRequest::Stopped), sock(NULL)
+struct IdleConnection
+{
+	NetworkTCPSocket* sock;
+	char hostname[HOSTNAME_LEN];
+	uint16_t port;
+	clock_t expiry;
+	int requestCount;
+	int maxRequests;
+};
+
+static IdleConnection idleConnections[HTTP_MAX_IDLE_CONNECTIONS];
+
+static void CloseIdleConnection(IdleConnection& connection)
+{
+	Platform::network->DestroySocket(connection.sock);
+	connection.sock = NULL;
+}
+
+// Frees up the connection closest to expiring. Returns its slot, or NULL if there were none
+static IdleConnection* CloseOldestIdleConnection()
+{
+	IdleConnection* oldest = NULL;
+	for (int n = 0; n < HTTP_MAX_IDLE_CONNECTIONS; n++)
+	{
+		if (idleConnections[n].sock && (!oldest || idleConnections[n].expiry < oldest->expiry))
+		{
+			oldest = &idleConnections[n];
+		}
+	}
+	if (oldest)
+	{
+		CloseIdleConnection(*oldest);
+	}
+	return oldest;
+}
+
+static IdleConnection* FindIdleConnection(const char* hostname, uint16_t port)
+{
+	clock_t now = clock();
+
+	for (int n = 0; n < HTTP_MAX_IDLE_CONNECTIONS; n++)
+	{
+		IdleConnection& connection = idleConnections[n];
+		if (connection.sock && (now > connection.expiry || connection.sock->IsClosed()))
+		{
+			CloseIdleConnection(connection);
+		}
+	}
+
+	for (int n = 0; n < HTTP_MAX_IDLE_CONNECTIONS; n++)
+	{
+		IdleConnection& connection = idleConnections[n];
+		if (connection.sock && connection.port == port && !stricmp(connection.hostname, hostname))
+		{
+			return &connection;
+		}
+	}
+	return NULL;
+}
+
+static IdleConnection* FindFreeIdleConnection()
+{
+	for (int n = 0; n < HTTP_MAX_IDLE_CONNECTIONS; n++)
+	{
+		if (!idleConnections[n].sock)
+		{
+			return &idleConnections[n];
+		}
+	}
+	return CloseOldestIdleConnection();
+}
+
+void HTTPRequest::CloseIdleConnections()
+{
+	for (int n = 0; n < HTTP_MAX_IDLE_CONNECTIONS; n++)
+	{
+		if (idleConnections[n].sock)
+		{
+			CloseIdleConnection(idleConnections[n]);
+		}
+	}
+}
+
+HTTPRequest::HTTPRequest() : status(HTTPRequest::Stopped), sock(NULL), inflater(NULL), triedCreatingInflater(false), cacheWriter(NULL)
 {
 	contentType[0] = '\0';
 }
@@ -14,6 +98,9 @@ void HTTPRequest::Reset()
 	lineBufferSendPos = -1;
 	contentType[0] = '\0';
 	cacheInfo = CacheInfo();
+	keepAlive = false;
+	isReusedConnection = false;
+	isContentEncoded = false;
 }
 
 void HTTPRequest::WriteLine(const char* fmt, ...)
@@ -60,7 +147,7 @@ bool HTTPRequest::SendPendingWrites()
 				lineBufferSize = 0;
 			}
 		}
-		else if (rc < 0)
+		else if (rc < 0 && !RetryOnNewConnection())
 		{
 			MarkError(WriteLineError);
 			lineBufferSendPos = -1;
@@ -161,55 +248,107 @@ void HTTPRequest::Open(char* inURL)
 
 size_t HTTPRequest::ReadData(char* buffer, size_t count)
 {
-	if (status == HTTPRequest::Downloading && sock && internalStatus == ReceiveContent)
+	if (status != HTTPRequest::Downloading)
 	{
-		if (usingChunkedTransfer && count > chunkSizeRemaining)
-		{
-			count = chunkSizeRemaining;
-		}
+		return 0;
+	}
 
-		int16_t rc = sock->Receive((unsigned char*)buffer, count);
-		if (rc < 0)
-		{
-			MarkError(ContentReceiveError);
-		}
-		else if(rc > 0)
-		{
-			ResetTimeOutTimer();
+	size_t bytesRead = isContentEncoded ? ReadInflatedContent(buffer, count) : ReceiveBody(buffer, count);
+
+	// Cache holds the content as it is passed on, so cached compressed pages are never decoded twice
+	if(bytesRead && cacheWriter) cacheWriter->Write(buffer, bytesRead);
+
+	// The consumer may stop reading as soon as it has the last of the content, so finish up straight away.
+	// A compressed stream cut short ends once nothing more can be decoded
+	if (internalStatus == ContentReceived && (!isContentEncoded || inflater->IsFinished() || !bytesRead))
+	{
+		FinishResponse();
+	}
+
+	return bytesRead;
+}
+
+// Reads the body as it arrives, without going past the end of the current chunk or the response
+size_t HTTPRequest::ReceiveBody(char* buffer, size_t count)
+{
+	if (!sock || internalStatus != ReceiveContent)
+	{
+		return 0;
+	}
+
+	if (usingChunkedTransfer && count > (size_t) chunkSizeRemaining)
+	{
+		count = chunkSizeRemaining;
+	}
+	if (contentRemaining > 0 && count > (size_t) contentRemaining)
+	{
+		// Don't read into whatever follows on a kept alive connection
+		count = contentRemaining;
+	}
+
+	int16_t rc = sock->Receive((unsigned char*)buffer, count);
+	if (rc < 0)
+	{
+		MarkError(ContentReceiveError);
+		return 0;
+	}
+
+	size_t bytesRead = (size_t)(rc);
+	if (bytesRead > 0)
+	{
+		ResetTimeOutTimer();
 
-			size_t bytesRead = (size_t)(rc);
-			if (contentRemaining > 0)
+		if (contentRemaining > 0)
+		{
+			contentRemaining -= bytesRead;
+			if (contentRemaining <= 0)
 			{
-				contentRemaining -= bytesRead;
-				if (contentRemaining <= 0)
-				{
-					if(cacheWriter)
-					{
-						cacheWriter->Write(buffer, bytesRead);
-						cacheWriter->Finish();
-						delete cacheWriter;
-						cacheWriter = NULL;
-					}
-					Stop();
-					return bytesRead;
-				}
+				internalStatus = ContentReceived;
 			}
+		}
 
-			if (usingChunkedTransfer)
+		if (usingChunkedTransfer)
+		{
+			chunkSizeRemaining -= bytesRead;
+			if (!chunkSizeRemaining)
 			{
-				chunkSizeRemaining -= bytesRead;
-				if (!chunkSizeRemaining)
-				{
-					internalStatus = ParseChunkHeader;
-				}
+				internalStatus = ParseChunkHeader;
 			}
+		}
+	}
+
+	return bytesRead;
+}
 
-			if(cacheWriter) cacheWriter->Write(buffer, bytesRead);
+// Fills as much of the buffer as the data received so far allows, so that the end of the stream is
+// reached in the same call as the last of the content
+size_t HTTPRequest::ReadInflatedContent(char* buffer, size_t count)
+{
+	size_t bytesInflated = 0;
 
-			return bytesRead;
+	while (1)
+	{
+		bytesInflated += inflater->Inflate((uint8_t*)buffer + bytesInflated, count - bytesInflated);
+		if (inflater->HasFailed())
+		{
+			MarkError(ContentDecodeError);
+			return 0;
+		}
+		if (bytesInflated == count)
+		{
+			return bytesInflated;
 		}
+
+		// All of the input so far has been used up
+		size_t space;
+		uint8_t* input = inflater->GetInputBuffer(space);
+		size_t bytesReceived = ReceiveBody((char*)input, space);
+		if (!bytesReceived)
+		{
+			return bytesInflated;
+		}
+		inflater->AddInput(bytesReceived);
 	}
-	return 0;
 }
 
 void HTTPRequest::Stop()
@@ -226,14 +365,112 @@ void HTTPRequest::Stop()
 		delete cacheWriter;
 		cacheWriter = NULL;
 	}
+	if (inflater)
+	{
+		inflater->ReleaseWindow();
+	}
 	status = HTTPRequest::Stopped;
 }
 
+// Completes the cache entry and returns the connection to the idle pool if the server will take another request on it
+void HTTPRequest::FinishResponse()
+{
+	if (cacheWriter && (!isContentEncoded || inflater->IsFinished()))
+	{
+		cacheWriter->Finish();
+		delete cacheWriter;
+		cacheWriter = NULL;
+	}
+
+	if (keepAlive && sock && !sock->IsClosed() && connectionRequestCount < connectionMaxRequests)
+	{
+		IdleConnection* connection = FindFreeIdleConnection();
+
+		connection->sock = sock;
+		strcpy(connection->hostname, hostname);
+		connection->port = serverPort;
+		connection->expiry = clock() + (clock_t)connectionIdleTimeout * CLOCKS_PER_SEC;
+		connection->requestCount = connectionRequestCount;
+		connection->maxRequests = connectionMaxRequests;
+		sock = NULL;
+	}
+
+	Stop();
+}
+
+// A server may close an idle connection just as it is reused. If nothing of the response has
+// arrived yet then the request is sent again on a new connection
+bool HTTPRequest::RetryOnNewConnection()
+{
+	if (!isReusedConnection || internalStatus != ReceiveHeaderResponse || (lineBufferSendPos < 0 && lineBufferSize > 0))
+	{
+		return false;
+	}
+
+	Platform::network->DestroySocket(sock);
+	sock = NULL;
+	isReusedConnection = false;
+	lineBufferSize = 0;
+	lineBufferSendPos = -1;
+	internalStatus = QueuedDNSRequest;
+	ResetTimeOutTimer();
+	return true;
+}
+
+void HTTPRequest::ParseKeepAliveHeader(const char* value)
+{
+	const char* param = strstr(value, "timeout=");
+	if (param)
+	{
+		// Give up on the connection a little before the server does
+		int serverTimeout = atoi(param + 8) - 1;
+		if (serverTimeout < connectionIdleTimeout)
+		{
+			connectionIdleTimeout = serverTimeout;
+		}
+	}
+
+	param = strstr(value, "max=");
+	if (param)
+	{
+		// Number of requests the server will still take on this connection
+		int maxRemaining = atoi(param + 4);
+		if (connectionRequestCount + maxRemaining < connectionMaxRequests)
+		{
+			connectionMaxRequests = connectionRequestCount + maxRemaining;
+		}
+	}
+}
+
+void HTTPRequest::ParseContentEncodingHeader(const char* value)
+{
+	while (*value == ' ')
+	{
+		value++;
+	}
+
+	// Only encodings that were asked for in Accept-Encoding are expected
+	if (inflater && inflater->HasWindow() && (!stricmp(value, "gzip") || !stricmp(value, "x-gzip") || !stricmp(value, "deflate")))
+	{
+		inflater->Reset();
+		isContentEncoded = true;
+	}
+}
+
 void HTTPRequest::MarkError(InternalStatus statusError)
 {
 	status = HTTPRequest::Error;
 	internalStatus = statusError;
-	if(cacheWriter) cacheWriter->Abort();
+	if(cacheWriter)
+	{
+		cacheWriter->Abort();
+		delete cacheWriter;
+		cacheWriter = NULL;
+	}
+	if (inflater)
+	{
+		inflater->ReleaseWindow();
+	}
 }
 
 void HTTPRequest::Update()
@@ -257,6 +494,25 @@ void HTTPRequest::Update()
 		{
 		case QueuedDNSRequest:
 		{
+			// Skip DNS and connecting if the server left a connection open
+			IdleConnection* connection = FindIdleConnection(hostname, serverPort);
+			if (connection)
+			{
+				sock = connection->sock;
+				connectionRequestCount = connection->requestCount;
+				connectionMaxRequests = connection->maxRequests;
+				connection->sock = NULL;
+				isReusedConnection = true;
+				internalStatus = SendHeaders;
+				break;
+			}
+
+			if (DNSCache::Get().Lookup(hostname, hostAddr))
+			{
+				internalStatus = OpeningSocket;
+				break;
+			}
+
 			int rc = Platform::network->ResolveAddress(hostname, hostAddr, true);
 			if(rc > 0)
 			{
@@ -264,6 +520,7 @@ void HTTPRequest::Update()
 			}
 			else if(rc == 0)
 			{
+				DNSCache::Get().Add(hostname, hostAddr);
 				internalStatus = OpeningSocket;
 			}
 			else
@@ -277,6 +534,7 @@ void HTTPRequest::Update()
 			int8_t rc = Platform::network->ResolveAddress(hostname, hostAddr, false);
 			if (rc == 0)
 			{
+				DNSCache::Get().Add(hostname, hostAddr);
 				internalStatus = OpeningSocket;
 			}
 			else if(rc < 0)
@@ -288,10 +546,18 @@ void HTTPRequest::Update()
 		case OpeningSocket:
 		{
 			sock = Platform::network->CreateSocket();
+			if (!sock && CloseOldestIdleConnection())
+			{
+				// Idle connections can be holding all of the platform's sockets
+				sock = Platform::network->CreateSocket();
+			}
 			if (!sock)
 			{
 				MarkError(SocketCreationError);
+				break;
 			}
+			connectionRequestCount = 0;
+			connectionMaxRequests = HTTP_MAX_REQUESTS_PER_CONNECTION;
 
 			if (sock->Connect(hostAddr, serverPort))
 			{
@@ -312,6 +578,8 @@ void HTTPRequest::Update()
 			}
 			else if (sock->IsClosed())
 			{
+				// Address may be out of date, so look it up again next time
+				DNSCache::Get().Remove(hostname);
 				MarkError(SocketConnectionError);
 				break;
 			}
@@ -322,10 +590,17 @@ void HTTPRequest::Update()
 			WriteLine("GET %s HTTP/1.1", path);
 			WriteLine("User-Agent: MicroWeb " __DATE__);
 			WriteLine("Host: %s", hostname);
-			WriteLine("Accept-Encoding: identity");
-			WriteLine("Connection: close");
+			if (!triedCreatingInflater)
+			{
+				inflater = Inflater::Create();
+				triedCreatingInflater = true;
+			}
+			// Only one request at a time gets the shared window when there is no EMS
+			WriteLine(inflater && inflater->AcquireWindow() ? "Accept-Encoding: gzip, deflate" : "Accept-Encoding: identity");
+			WriteLine("Connection: keep-alive");
 			WriteLine("");
 			internalStatus = ReceiveHeaderResponse;
+			connectionRequestCount++;
 		}
 		break;
 		case ReceiveHeaderResponse:
@@ -356,9 +631,14 @@ void HTTPRequest::Update()
 				//getchar();
 				internalStatus = ReceiveHeaderContent;
 
+				// HTTP/1.1 connections are persistent unless the server says otherwise
+				keepAlive = lineBuffer[7] == '1';
+				connectionIdleTimeout = HTTP_IDLE_CONNECTION_TIMEOUT_SECONDS;
+
 				contentRemaining = -1;
 				usingChunkedTransfer = false;
 				contentType[0] = '\0';
+				isContentEncoded = false;
 			}
 		}
 		break;
@@ -370,6 +650,18 @@ void HTTPRequest::Update()
 				cacheInfo.ParseHeader(lineBuffer);
 				if (lineBuffer[0] == '\0')
 				{
+					if (inflater && !isContentEncoded)
+					{
+						// Hand the window on to another request
+						inflater->ReleaseWindow();
+					}
+
+					if (contentRemaining < 0 && !usingChunkedTransfer)
+					{
+						// Content runs until the server closes the connection
+						keepAlive = false;
+					}
+
 					if (contentRemaining == 0)
 					{
 						// Received header with zero content
@@ -436,9 +728,26 @@ void HTTPRequest::Update()
 				{
 					usingChunkedTransfer = true;
 				}
+				else if (!strnicmp(lineBuffer, "Content-Encoding:", 17))
+				{
+					ParseContentEncodingHeader(lineBuffer + 17);
+				}
 				else if (!strnicmp(lineBuffer, "Content-Type:", 13))
 				{
-					strncpy(contentType, lineBuffer + 14, MAX_CONTENT_TYPE_LENGTH);
+					strncpy(contentType, lineBuffer + 14, MAX_CONTENT_TYPE_LENGTH - 1);
+					contentType[MAX_CONTENT_TYPE_LENGTH - 1] = '\0';
+				}
+				else if (!strnicmp(lineBuffer, "Connection: close", 17))
+				{
+					keepAlive = false;
+				}
+				else if (!strnicmp(lineBuffer, "Connection: keep-alive", 22))
+				{
+					keepAlive = true;
+				}
+				else if (!strnicmp(lineBuffer, "Keep-Alive:", 11))
+				{
+					ParseKeepAliveHeader(lineBuffer + 11);
 				}
 
 				//printf("Header: %s  -- \n", lineBuffer);
@@ -462,7 +771,8 @@ void HTTPRequest::Update()
 
 	if (internalStatus == ParseChunkHeader)
 	{
-		if (ReadLine())
+		// Empty line is the end of the previous chunk's data
+		if (ReadLine() && lineBuffer[0])
 		{
 			chunkSizeRemaining = strtol(lineBuffer, NULL, 16);
 
@@ -471,6 +781,20 @@ void HTTPRequest::Update()
 				status = Downloading;
 				internalStatus = ReceiveContent;
 			}
+			else
+			{
+				// Last chunk, only trailing headers are left
+				internalStatus = ReceiveChunkTrailer;
+			}
+		}
+	}
+	else if (internalStatus == ReceiveChunkTrailer)
+	{
+		if (ReadLine() && !lineBuffer[0])
+		{
+			// Response is finished off once the consumer has read everything
+			status = Downloading;
+			internalStatus = ContentReceived;
 		}
 	}
 }
@@ -492,8 +816,11 @@ bool HTTPRequest::ReadLine()
 		}
 		else if (rc < 0)
 		{
-			printf("Receive error\n");
-			MarkError(ContentReceiveError);
+			if (!RetryOnNewConnection())
+			{
+				printf("Receive error\n");
+				MarkError(ContentReceiveError);
+			}
 			return false;
 		}
 
@@ -563,6 +890,8 @@ const char* HTTPRequest::GetStatusString()
 			return "Error resolving host name";
 		case TimedOut:
 			return "Connection timed out";
+		case ContentDecodeError:
+			return "Error decompressing content";
 		}
 		break;
 
@@ -19,8 +19,14 @@
 #define HTTP_RESPONSE_TIMEOUT_SECONDS 20
 #define HTTP_RESPONSE_TIMEOUT (HTTP_RESPONSE_TIMEOUT_SECONDS * CLOCKS_PER_SEC)
 
+// Connections kept open after a complete response, for the next request to the same server
+#define HTTP_MAX_IDLE_CONNECTIONS 2
+#define HTTP_IDLE_CONNECTION_TIMEOUT_SECONDS 5
+#define HTTP_MAX_REQUESTS_PER_CONNECTION 32
+
 //Uses some of the above constants
 #include "Cache.h"
+#include "Inflate.h"
 
 class HTTPRequest
 {
@@ -47,6 +53,8 @@ public:
 	const char* GetURL() { return url.url; }
 	const char* GetContentType() { return contentType; }
 
+	static void CloseIdleConnections();
+
 private:
 	enum InternalStatus
 	{
@@ -62,6 +70,7 @@ private:
 		WriteLineError,
 		TimedOut,
 		HostNameResolveError,
+		ContentDecodeError,
 
 		// Connection states
 		QueuedDNSRequest,
@@ -72,10 +81,18 @@ private:
 		ReceiveHeaderResponse,
 		ReceiveHeaderContent,
 		ReceiveContent,
-		ParseChunkHeader
+		ParseChunkHeader,
+		ReceiveChunkTrailer,
+		ContentReceived
 	};
 
 	void MarkError(InternalStatus statusError);
+	bool RetryOnNewConnection();
+	void FinishResponse();
+	void ParseKeepAliveHeader(const char* value);
+	void ParseContentEncodingHeader(const char* value);
+	size_t ReceiveBody(char* buffer, size_t count);
+	size_t ReadInflatedContent(char* buffer, size_t count);
 	bool ReadLine();
 	void WriteLine(const char* fmt, ...);
 	bool SendPendingWrites();
@@ -103,6 +120,17 @@ private:
 
 	long chunkSizeRemaining;
 	bool usingChunkedTransfer;
+
+	// Created the first time a request is sent, NULL if there wasn't the memory to decode compressed content
+	Inflater* inflater;
+	bool triedCreatingInflater;
+	bool isContentEncoded;
+
+	bool keepAlive;
+	bool isReusedConnection;
+	int connectionRequestCount;
+	int connectionMaxRequests;
+	int connectionIdleTimeout;
 	
 	clock_t timeout;
 
@@ -9,10 +9,10 @@
 #include "../VidModes.h"
 #include "Image.h"
 #include "../Draw/Surface.h"
+#include "../Memory/Memory.h"
 #pragma warning(disable:4996)
 
 #include <stdio.h>
-#include <conio.h>
 
 typedef union 
 {
@@ -26,7 +26,7 @@ static ImageDecoderUnion* imageDecoderUnion = nullptr;
 
 #define COLDITH(x) ((x * 4) - 32)
 
-const int8_t ImageDecoder::colourDitherMatrix[16] = 
+const int8_t ImageDecoder::colourDitherMatrix[IMAGE_DITHER_CELLS] = 
 { 
 //    0,  8,  2, 10,
 //    12,  4, 14,  6,
@@ -74,6 +74,40 @@ void ImageDecoder::Allocate()
     }
 }
 
+// Top three bits of a channel value after adding the offset for a dither cell
+static inline uint8_t DitherLevel(uint8_t value, int offset)
+{
+	int level = value + offset;
+	if (level > 255)
+		level = 255;
+	else if (level < 0)
+		level = 0;
+	return (uint8_t)(level >> 5);
+}
+
+void ImageDecoder::BuildDitheredPalette(DitheredPalette& table, const uint8_t* rgbPalette, int numEntries, int transparentIndex)
+{
+	const uint8_t* videoLUT = Platform::video->paletteLUT;
+
+	for (int cell = 0; cell < IMAGE_DITHER_CELLS; cell++)
+	{
+		int offset = colourDitherMatrix[cell];
+		uint8_t* output = table[cell];
+		const uint8_t* rgb = rgbPalette;
+
+		for (int n = 0; n < numEntries; n++, rgb += 3)
+		{
+			// Same as RGB332() on the dithered channels
+			output[n] = videoLUT[(DitherLevel(rgb[0], offset) << 5) | (DitherLevel(rgb[1], offset) << 2) | (DitherLevel(rgb[2], offset) >> 1)];
+		}
+
+		if (transparentIndex >= 0 && transparentIndex < numEntries)
+		{
+			output[transparentIndex] = TRANSPARENT_COLOUR_VALUE;
+		}
+	}
+}
+
 ImageDecoder* ImageDecoder::Get()
 {
 	return (ImageDecoder*)(imageDecoderUnion->buffer);
@@ -185,10 +219,102 @@ void ImageDecoder::Begin(Image* image, bool dimensionsOnly)
     onlyDownloadDimensions = dimensionsOnly;
     state = ImageDecoder::Decoding;
     outputImage = image;
+    updatedTop = updatedBottom = 0;
+    sourceWidth = sourceHeight = 0;
     outputImage->bpp = Platform::video->drawSurface->format == DrawSurface::Format_1BPP ? 1 : 8;
 }
 
-void ImageDecoder::CalculateImageDimensions(int sourceWidth, int sourceHeight)
+bool ImageDecoder::GetUpdatedLines(int& top, int& bottom)
+{
+	if (updatedBottom <= updatedTop)
+	{
+		return false;
+	}
+
+	top = updatedTop;
+	bottom = updatedBottom;
+	updatedTop = updatedBottom = 0;
+	return true;
+}
+
+void ImageDecoder::MarkLinesUpdated(int top, int bottom)
+{
+	if (updatedBottom <= updatedTop)
+	{
+		updatedTop = top;
+		updatedBottom = bottom;
+	}
+	else
+	{
+		if (top < updatedTop)
+			updatedTop = top;
+		if (bottom > updatedBottom)
+			updatedBottom = bottom;
+	}
+}
+
+bool ImageDecoder::AllocateImage(uint8_t fillValue)
+{
+	if (!outputImage->height || !outputImage->pitch)
+	{
+		return false;
+	}
+
+	uint16_t stripSize = IMAGE_STRIP_SIZE;
+	if (stripSize > MemoryManager::pageBlockAllocator.MaxBlockSize())
+	{
+		stripSize = MemoryManager::pageBlockAllocator.MaxBlockSize();
+	}
+
+	outputImage->linesPerStrip = outputImage->pitch < stripSize ? stripSize / outputImage->pitch : 1;
+	if (outputImage->linesPerStrip > outputImage->height)
+	{
+		outputImage->linesPerStrip = outputImage->height;
+	}
+
+	uint16_t numStrips = outputImage->NumStrips();
+
+	outputImage->strips = MemoryManager::pageBlockAllocator.Allocate(sizeof(MemBlockHandle) * numStrips);
+	if (!outputImage->strips.IsAllocated())
+	{
+		return false;
+	}
+
+	for (uint16_t n = 0; n < numStrips; n++)
+	{
+		uint16_t numLines = outputImage->linesPerStrip;
+		if (n == numStrips - 1)
+		{
+			numLines = outputImage->height - n * outputImage->linesPerStrip;
+		}
+		uint16_t size = numLines * outputImage->pitch;
+
+		MemBlockHandle strip = MemoryManager::pageBlockAllocator.Allocate(size);
+		if (!strip.IsAllocated())
+		{
+			outputImage->strips.type = MemBlockHandle::Unallocated;
+			return false;
+		}
+
+		memset(strip.Get<uint8_t*>(), fillValue, size);
+		strip.Commit();
+
+		MemBlockHandle* strips = outputImage->strips.Get<MemBlockHandle*>();
+		strips[n] = strip;
+		outputImage->strips.Commit();
+	}
+
+	return true;
+}
+
+void ImageDecoder::CalculateImageDimensions(int inSourceWidth, int inSourceHeight)
+{
+	sourceWidth = inSourceWidth;
+	sourceHeight = inSourceHeight;
+	CalculateImageDimensions(outputImage, sourceWidth, sourceHeight);
+}
+
+void ImageDecoder::CalculateImageDimensions(Image* outputImage, int sourceWidth, int sourceHeight)
 {
 	VideoModeInfo* modeInfo = Platform::video->GetVideoModeInfo();
 
@@ -6,6 +6,8 @@
 struct Image;
 class LinearAllocator;
 
+#define IMAGE_DITHER_CELLS 16		// Entries in the 4x4 colour dither matrix
+
 #pragma pack(push, 1)
 struct uint16_be
 {
@@ -17,7 +19,7 @@ struct uint16_be
 
 	operator uint16_t ()
 	{
-		return (highByte << 8) | lowByte;
+		return (uint16_t)((uint16_t)highByte << 8) | lowByte;
 	}
 };
 
@@ -63,11 +65,21 @@ public:
 		Jpeg
 	};
 
-	ImageDecoder() : outputImage(NULL), state(Stopped), structFillPosition(0) {}
+	ImageDecoder() : structFillPosition(0), outputImage(NULL), state(Stopped) {}
 	
 	void Begin(Image* image, bool dimensionsOnly);
 	virtual void Process(uint8_t* data, size_t dataLength) = 0;
 	State GetState() { return state; }
+
+	// Size of the image before it was scaled for the video mode and layout
+	int GetSourceWidth() { return sourceWidth; }
+	int GetSourceHeight() { return sourceHeight; }
+
+	// Range of output lines written since the last call, bottom exclusive. Returns false if nothing has changed
+	bool GetUpdatedLines(int& top, int& bottom);
+
+	// Decoded lines completely cover whatever was drawn behind them
+	virtual bool IsOpaque() { return true; }
 	
 	static void Allocate();
 	static ImageDecoder* Get();
@@ -75,6 +87,9 @@ public:
 	static ImageDecoder* CreateFromExtension(const char* path);
 	static ImageDecoder* CreateFromMIME(const char* type);
 
+	// Scales source dimensions for the video mode, keeping any width / height already set by layout
+	static void CalculateImageDimensions(Image* image, int sourceWidth, int sourceHeight);
+
 protected:
 	bool FillStruct(uint8_t** data, size_t& dataLength, void* dest, size_t size);
 	uint8_t NextByte(uint8_t** data, size_t& dataLength)
@@ -89,12 +104,24 @@ protected:
 
 	void CalculateImageDimensions(int sourceWidth, int sourceHeight);
 
+	// Allocates the strips for the output image with every pixel set to fillValue
+	bool AllocateImage(uint8_t fillValue);
+
+	void MarkLinesUpdated(int top, int bottom);
+
+	// Video mode colour for each palette entry at each cell of colourDitherMatrix, indexed by
+	// [4 * (y & 3) + (x & 3)][entry], so that dithering a pixel is a single lookup
+	typedef uint8_t DitheredPalette[IMAGE_DITHER_CELLS][256];
+	static void BuildDitheredPalette(DitheredPalette& table, const uint8_t* rgbPalette, int numEntries, int transparentIndex);
+
 	Image* outputImage;
 	ImageDecoder::State state;
 	bool onlyDownloadDimensions;
+	int updatedTop, updatedBottom;
+	int sourceWidth, sourceHeight;
 
 	static const uint8_t greyDitherMatrix[256];
-	static const int8_t colourDitherMatrix[16];
+	static const int8_t colourDitherMatrix[IMAGE_DITHER_CELLS];
 
 };
 
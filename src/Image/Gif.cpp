@@ -7,6 +7,7 @@
 #include "../App.h"
 #include "../Draw/Surface.h"
 #include <stdio.h>
+#include <string.h>
 
 #ifdef _WIN32
 #define DEBUG_MESSAGE(...) printf(__VA_ARGS__);
@@ -26,6 +27,11 @@ GifDecoder::GifDecoder()
 	transparentColourIndex = -1;
 }
 
+bool GifDecoder::IsValidHeader(const Header& header)
+{
+	return !memcmp(header.versionTag, "GIF89a", 6) || !memcmp(header.versionTag, "GIF87a", 6);
+}
+
 void GifDecoder::Process(uint8_t* data, size_t dataLength)
 {
 	if(state != ImageDecoder::Decoding)
@@ -42,7 +48,7 @@ void GifDecoder::Process(uint8_t* data, size_t dataLength)
 				if(FillStruct(&data, dataLength, &header, sizeof(Header)))
 				{
 					// Header structure is complete
-					if(memcmp(header.versionTag, "GIF89a", 6) && memcmp(header.versionTag, "GIF87a", 6))
+					if(!IsValidHeader(header))
 					{
 						// Not a GIF89a
 						state = ImageDecoder::Error;
@@ -73,43 +79,14 @@ void GifDecoder::Process(uint8_t* data, size_t dataLength)
 						outputImage->pitch = outputImage->width;
 					}
 
-					outputImage->lines = MemoryManager::pageBlockAllocator.Allocate(sizeof(MemBlockHandle) * outputImage->height);
-					if(!outputImage->lines.IsAllocated())
+					if (!AllocateImage(TRANSPARENT_COLOUR_VALUE))
 					{
 						// Allocation error
 						DEBUG_MESSAGE("Could not allocate!\n");
 						state = ImageDecoder::Error;
 						return;
 					}
-
-					MemBlockHandle* lines = outputImage->lines.Get<MemBlockHandle*>();
-
-					for (int j = 0; j < outputImage->height; j++)
-					{
-						lines[j] = MemoryManager::pageBlockAllocator.Allocate(outputImage->pitch);
-
-						if (!lines[j].IsAllocated())
-						{
-							// Allocation error
-							DEBUG_MESSAGE("Could not allocate!\n");
-							outputImage->lines.type = MemBlockHandle::Unallocated;
-							state = ImageDecoder::Error;
-							return;
-						}
-					}
-
-					outputImage->lines.Commit();
-					for (int j = 0; j < outputImage->height; j++)
-					{
-						lines = outputImage->lines.Get<MemBlockHandle*>();
-						MemBlockHandle line = lines[j];
-						void* pixels = line.GetPtr();
-						if (pixels)
-						{
-							memset(pixels, TRANSPARENT_COLOUR_VALUE, outputImage->pitch);
-							line.Commit();
-						}
-					}
+					lineOutput = ImageLineIterator(outputImage, 0);
 					
 					backgroundColour = header.backgroundColour;
 					
@@ -269,13 +246,32 @@ void GifDecoder::Process(uint8_t* data, size_t dataLength)
 				lzwCodeSize = NextByte(&data, dataLength);
 				DEBUG_MESSAGE("LZW code size: %d\n", lzwCodeSize);
 
+				if (lzwCodeSize >= GIF_MAX_LZW_CODE_LENGTH)
+				{
+					DEBUG_MESSAGE("Invalid LZW code size\n");
+					state = ImageDecoder::Error;
+					return;
+				}
+
 				// Init LZW vars
-				code = 0;
 				clearCode = 1 << lzwCodeSize;
 				stopCode = clearCode + 1;
-				codeLength = resetCodeLength = lzwCodeSize + 1;
-				codeBit = 0;
-				prev = -1;
+				resetCodeLength = lzwCodeSize + 1;
+				bitBuffer = 0;
+				bitCount = 0;
+
+				if (outputImage->bpp == 8)
+				{
+					BuildDitheredPalette(ditheredPalette, palette, clearCode < 256 ? clearCode : 256, transparentColourIndex);
+				}
+
+				// Single byte strings are never replaced so only need setting up once per image
+				for (int n = 0; n < clearCode; n++)
+				{
+					dictionary[n].byte = dictionary[n].first = (uint8_t) n;
+					dictionary[n].prev = -1;
+					dictionary[n].len = 1;
+				}
 				ClearDictionary();
 
 				internalState = ParseImageSubBlockSize;
@@ -303,142 +299,67 @@ void GifDecoder::Process(uint8_t* data, size_t dataLength)
 			
 			case ParseImageSubBlock:
 			{
-				if(imageSubBlockSize)
+				// Decode as much of the sub block as has arrived in one go
+				size_t available = imageSubBlockSize < dataLength ? imageSubBlockSize : dataLength;
+				uint8_t* end = data + available;
+				imageSubBlockSize -= (uint8_t) available;
+				dataLength -= available;
+
+				while (data < end)
 				{
-					imageSubBlockSize--;
-					uint8_t dataByte = NextByte(&data, dataLength);
-					//DEBUG_MESSAGE("-Data: %x\n", dataByte);
-					
-					for(int n = 0; n < 8; n++)
+					bitBuffer |= (uint32_t)(*data++) << bitCount;
+					bitCount += 8;
+
+					while (bitCount >= codeLength)
 					{
-						if(dataByte & (1 << n))
+						int code = (int)(bitBuffer & codeMask);
+						bitBuffer >>= codeLength;
+						bitCount -= codeLength;
+
+						if (code == clearCode)
 						{
-							code |= (1 << codeBit);
+							ClearDictionary();
+							continue;
 						}
-						codeBit++;
-						
-						if (codeBit == codeLength)
+						else if (code == stopCode)
 						{
-							//DEBUG_MESSAGE("code: %x [len=%d]\n", code, codeLength);
+							// Anything after the stop code is ignored
+							state = ImageDecoder::Success;
+							return;
+						}
 
-							// Code complete
-							if (code == clearCode)
-							{
-								DEBUG_MESSAGE("CLEAR\n");
-								codeLength = resetCodeLength;
-								ClearDictionary();
-								prev = -1;
-								codeBit = 0;
-								code = 0;
-								continue;
-							}
-							else if (code == stopCode)
-							{
-								DEBUG_MESSAGE("STOP\n");
-								if (imageSubBlockSize)
-								{
-									DEBUG_MESSAGE("Malformed GIF\n");
-									// FIXME
-									//state = ImageDecoder::Success;
-									//return;
-									//state = ImageDecoder::Error;
-								}
-								continue;
-							}
+						if (code > dictionaryIndex || (code == dictionaryIndex && prev == -1))
+						{
+							DEBUG_MESSAGE("Error: code = %x, but dictionaryIndex = %x\n", code, dictionaryIndex);
+							state = ImageDecoder::Error;
+							return;
+						}
 
-							if (prev > -1 && codeLength <= 12)
-							{
-								if (code > dictionaryIndex)
-								{
-									DEBUG_MESSAGE("Error: code = %x, but dictionaryIndex = %x\n", code, dictionaryIndex);
-									state = ImageDecoder::Error;
-									return;
-								}
-
-								int ptr = (code == dictionaryIndex) ? prev : code;
-								while (dictionary[ptr].prev != -1)
-								{
-									ptr = dictionary[ptr].prev;
-								}
-								dictionary[dictionaryIndex].byte = dictionary[ptr].byte;
-
-								dictionary[dictionaryIndex].prev = prev;
-								if (prev != -1)
-								{
-									/*if (dictionary[prev].len == 255)
-									{
-										DEBUG_MESSAGE("Dictionary entry length too long");
-										state = ImageDecoder::Error;
-										return;
-									}*/
-
-									dictionary[dictionaryIndex].len = dictionary[prev].len + 1;
-								}
-								else
-								{
-									dictionary[dictionaryIndex].len = 1;
-								}
-
-								dictionaryIndex++;
-
-								if(dictionaryIndex == (1 << (codeLength)) && codeLength < 12)
-								{
-									codeLength++;
-									//DEBUG_MESSAGE("Code length: %d\n", codeLength);
-								}
-							}
+						if (prev != -1 && dictionaryIndex < GIF_MAX_DICTIONARY_ENTRIES)
+						{
+							DictionaryEntry& entry = dictionary[dictionaryIndex];
+							entry.prev = (int16_t) prev;
+							entry.first = dictionary[prev].first;
+							entry.byte = (code == dictionaryIndex) ? entry.first : dictionary[code].first;
+							entry.len = dictionary[prev].len + 1;
+
+							dictionaryIndex++;
 
-							prev = code;
-							
+							if (dictionaryIndex == (1 << codeLength) && codeLength < GIF_MAX_LZW_CODE_LENGTH)
 							{
-								uint8_t stack[1024];
-								int stackSize = 0;
-								
-								while(code != -1)
-								{
-									if (stackSize >= 1024)
-									{
-										Platform::FatalError("Stack overflow in GIF decoding");
-									}
-
-									stack[stackSize++] = dictionary[code].byte;
-									//DEBUG_MESSAGE(" value: %x\n", dictionary[code].byte);
-
-									code = dictionary[code].prev;
-								}
-								
-								while (stackSize)
-								{
-									if (lineBufferSkipCount == lineBufferDivider - 1)
-									{
-										lineBuffer[lineBufferSize++] = stack[stackSize - 1];
-										lineBufferSkipCount = 0;
-									}
-									else
-									{
-										lineBufferSkipCount++;
-									}
-
-									lineBufferFlushCount++;
-									stackSize--;
-
-									if (lineBufferFlushCount == imageDescriptor.width)
-									{
-										ProcessLineBuffer();
-										lineBufferSize = 0;
-										lineBufferFlushCount = 0;
-									}
-								}
+								codeLength++;
+								codeMask = (uint16_t)((1 << codeLength) - 1);
 							}
-							
-							codeBit = 0;
-							code = 0;
 						}
+
+						prev = code;
+
+						EmitString(code);
 					}
 				}
-				else
+
+				if (!imageSubBlockSize)
 				{
-				//DEBUG_MESSAGE("--\n");
 					internalState = ParseImageSubBlockSize;
 				}
 			}
@@ -513,14 +434,72 @@ void GifDecoder::Process(uint8_t* data, size_t dataLength)
 
 void GifDecoder::ClearDictionary()
 {
-	for(dictionaryIndex = 0; dictionaryIndex < (1 << lzwCodeSize); dictionaryIndex++)
+	dictionaryIndex = clearCode + 2;
+	codeLength = resetCodeLength;
+	codeMask = (uint16_t)((1 << codeLength) - 1);
+	prev = -1;
+}
+
+void GifDecoder::EmitString(int code)
+{
+	DictionaryEntry* entry = &dictionary[code];
+	uint16_t length = entry->len;
+
+	if (lineBufferDivider == 1 && lineBufferFlushCount + length <= imageDescriptor.width)
 	{
-		dictionary[dictionaryIndex].byte = (uint8_t) dictionaryIndex;
-		dictionary[dictionaryIndex].prev = -1;
-		dictionary[dictionaryIndex].len = 1;
+		// The whole string fits on the current line so is written straight into place, last byte first
+		uint8_t* start = lineBuffer + lineBufferSize;
+		uint8_t* output = start + length;
+
+		*--output = entry->byte;
+		while (output != start)
+		{
+			entry = &dictionary[entry->prev];
+			*--output = entry->byte;
+		}
+
+		lineBufferSize += length;
+		lineBufferFlushCount += length;
+
+		if (lineBufferFlushCount == imageDescriptor.width)
+		{
+			ProcessLineBuffer();
+			lineBufferSize = 0;
+			lineBufferFlushCount = 0;
+		}
+		return;
+	}
+
+	uint8_t* output = stringBuffer + length;
+
+	*--output = entry->byte;
+	while (output != stringBuffer)
+	{
+		entry = &dictionary[entry->prev];
+		*--output = entry->byte;
+	}
+
+	for (uint16_t n = 0; n < length; n++)
+	{
+		if (lineBufferSkipCount == lineBufferDivider - 1)
+		{
+			lineBuffer[lineBufferSize++] = stringBuffer[n];
+			lineBufferSkipCount = 0;
+		}
+		else
+		{
+			lineBufferSkipCount++;
+		}
+
+		lineBufferFlushCount++;
+
+		if (lineBufferFlushCount == imageDescriptor.width)
+		{
+			ProcessLineBuffer();
+			lineBufferSize = 0;
+			lineBufferFlushCount = 0;
+		}
 	}
-	
-	dictionaryIndex += 2;
 }
 
 // Compute output index of y-th input line, in frame of height h. 
@@ -547,35 +526,92 @@ int GifDecoder::CalculateLineIndex(int y)
 void GifDecoder::ProcessLineBuffer()
 {
 	int outputY = linesProcessed;
+	int blockHeight = 1;
 	
 	if (imageDescriptor.fields & GIF_INTERLACE_BIT)
 	{
 		outputY = CalculateLineIndex(linesProcessed);
+
+		// Lines from the earlier passes are repeated over the lines below them that later passes
+		// will fill in, so that the whole image can be shown after the first pass
+		if ((outputY & 7) == 0)
+			blockHeight = 8;
+		else if ((outputY & 3) == 0)
+			blockHeight = 4;
+		else if ((outputY & 1) == 0)
+			blockHeight = 2;
 	}
 
+	int blockEnd = outputY + blockHeight;
+	if (blockEnd > header.height)
+	{
+		blockEnd = header.height;
+	}
+
+	int first, last, emitEnd;
+
 	if (outputImage->height == header.height)
 	{
-		EmitLine(outputY);
+		first = outputY;
+		last = blockEnd;
+		emitEnd = outputY + 1;
 	}
 	else
 	{
-		int first = outputY * (long)outputImage->height / header.height;
-		int last = (outputY + 1) * (long)outputImage->height / header.height;
+		first = outputY * (long)outputImage->height / header.height;
+		last = blockEnd * (long)outputImage->height / header.height;
+		emitEnd = (outputY + 1) * (long)outputImage->height / header.height;
+	}
 
-		for (int y = first; y < last; y++)
+	// Lines belonging to this source line are each emitted so they get their own row of the dither
+	// pattern. The rest only stand in until later passes and take a copy of the last emitted line
+	if (emitEnd <= first)
+	{
+		emitEnd = first + 1;
+	}
+	if (emitEnd > last)
+	{
+		emitEnd = last;
+	}
+
+	for (int y = first; y < emitEnd; y++)
+	{
+		EmitLine(y);
+	}
+
+	if (emitEnd < last)
+	{
+		if (outputImage->pitch <= GIF_LINE_BUFFER_MAX_SIZE)
+		{
+			// The line buffer is finished with, so holds the packed line while other strips are accessed
+			lineOutput.SetLine(emitEnd - 1);
+			memcpy(lineBuffer, lineOutput.Get(), outputImage->pitch);
+
+			for (int y = emitEnd; y < last; y++)
+			{
+				lineOutput.Next();
+				memcpy(lineOutput.Get(), lineBuffer, outputImage->pitch);
+				lineOutput.Commit();
+			}
+		}
+		else
 		{
-			EmitLine(y);
+			for (int y = emitEnd; y < last; y++)
+			{
+				EmitLine(y);
+			}
 		}
 	}
 
+	MarkLinesUpdated(first, last);
+
 	linesProcessed++;
 }
 
 void GifDecoder::EmitLine(int y)
 {
-	MemBlockHandle* lines = outputImage->lines.Get<MemBlockHandle*>();
-	MemBlockHandle lineOutput = lines[y];
-	uint8_t* output = lineOutput.Get<uint8_t*>();
+	lineOutput.SetLine(y);
+	uint8_t* output = lineOutput.Get();
 	
 	if (outputImage->bpp == 8)
 	{
@@ -587,40 +623,14 @@ void GifDecoder::EmitLine(int y)
 
 		if (useColourDithering)
 		{
-			const int8_t* ditherPattern = colourDitherMatrix + 4 * (y & 3);
-			int ditherIndex = 0;
+			// One table of palette entries per cell along this row of the dither matrix
+			const uint8_t (*cellPalettes)[256] = ditheredPalette + 4 * (y & 3);
 
 			if (outputImage->width == lineBufferSize)
 			{
 				for (int i = 0; i < lineBufferSize; i++)
 				{
-					int8_t offset = ditherPattern[ditherIndex];
-					ditherIndex = (ditherIndex + 1) & 3;
-
-					if (lineBuffer[i] == transparentColourIndex)
-					{
-						output[i] = TRANSPARENT_COLOUR_VALUE;
-						continue;
-					}
-
-					int index = lineBuffer[i] * 3;
-					int red = palette[index] + offset;
-					if (red > 255)
-						red = 255;
-					else if (red < 0)
-						red = 0;
-					int green = palette[index + 1] + offset;
-					if (green > 255)
-						green = 255;
-					else if (green < 0)
-						green = 0;
-					int blue = palette[index + 2] + offset;
-					if (blue > 255)
-						blue = 255;
-					else if (blue < 0)
-						blue = 0;
-
-					output[i] = Platform::video->paletteLUT[RGB332(red, green, blue)];
+					output[i] = cellPalettes[i & 3][lineBuffer[i]];
 				}
 			}
 			else
@@ -632,34 +642,7 @@ void GifDecoder::EmitLine(int y)
 
 				for (int i = 0; i < outputImage->width; i++)
 				{
-					int offset = ditherPattern[ditherIndex];
-					ditherIndex = (ditherIndex + 1) & 3;
-
-					if (lineBuffer[x] == transparentColourIndex)
-					{
-						output[i] = TRANSPARENT_COLOUR_VALUE;
-					}
-					else
-					{
-						int index = lineBuffer[x] * 3;
-						int red = palette[index] + offset;
-						if (red > 255)
-							red = 255;
-						else if (red < 0)
-							red = 0;
-						int green = palette[index + 1] + offset;
-						if (green > 255)
-							green = 255;
-						else if (green < 0)
-							green = 0;
-						int blue = palette[index + 2] + offset;
-						if (blue > 255)
-							blue = 255;
-						else if (blue < 0)
-							blue = 0;
-
-						output[i] = Platform::video->paletteLUT[RGB332(red, green, blue)];
-					}
+					output[i] = cellPalettes[i & 3][lineBuffer[x]];
 
 					while (D > 0)
 					{
@@ -3,9 +3,10 @@
 
 #include <stdint.h>
 #include "Decoder.h"
+#include "Image.h"
 
 #define GIF_MAX_LZW_CODE_LENGTH 12
-#define GIF_MAX_DICTIONARY_ENTRIES (1 << (GIF_MAX_LZW_CODE_LENGTH + 1))
+#define GIF_MAX_DICTIONARY_ENTRIES (1 << GIF_MAX_LZW_CODE_LENGTH)
 
 #define GIF_INTERLACE_BIT 0x40
 #define GIF_LINE_BUFFER_MAX_SIZE 640
@@ -16,10 +17,27 @@ public:
 	GifDecoder();
 	
 	virtual void Process(uint8_t* data, size_t dataLength);
-	
+	virtual bool IsOpaque() { return transparentColourIndex < 0; }
+
+	#pragma pack(push, 1)
+	struct Header
+	{
+		char versionTag[6];		// Should be GIF89a
+		uint16_t width;
+		uint16_t height;
+		uint8_t fields;
+		uint8_t backgroundColour;
+		uint8_t aspectRatio;
+	};
+	#pragma pack(pop)
+
+	// Also used by ImageProbe, which reads the header without a decoder
+	static bool IsValidHeader(const Header& header);
+
 private:
 
 	void ClearDictionary();
+	void EmitString(int code);
 	
 	int CalculateLineIndex(int y);
 	void ProcessLineBuffer();
@@ -44,16 +62,6 @@ private:
 	};
 
 	#pragma pack(push, 1)
-	struct Header
-	{
-		char versionTag[6];		// Should be GIF89a
-		uint16_t width;
-		uint16_t height;
-		uint8_t fields;
-		uint8_t backgroundColour;
-		uint8_t aspectRatio;
-	};
-
 	struct ImageDescriptor
 	{
 		uint16_t x, y;
@@ -67,9 +75,11 @@ private:
 		uint8_t size;
 	};
 	
+	// Each entry is the string of its prev entry with byte added on the end
 	struct DictionaryEntry
 	{
 		uint8_t byte;
+		uint8_t first;			// First byte of the whole string
 		int16_t prev;
 		uint16_t len;
 	};
@@ -86,6 +96,7 @@ private:
 	
 	uint8_t palette[256*3];			// RGB values
 	uint8_t paletteLUT[256];		// GIF palette colour to video mode palette colour
+	DitheredPalette ditheredPalette;	// Built for each image once its palette and transparency are known
 	int paletteSize;
 	uint8_t backgroundColour;
 	int transparentColourIndex;
@@ -93,6 +104,8 @@ private:
 	
 	DictionaryEntry dictionary[GIF_MAX_DICTIONARY_ENTRIES];
 
+	ImageLineIterator lineOutput;
+
 //	union
 	//{
 		struct
@@ -114,18 +127,22 @@ private:
 			uint8_t imageSubBlockSize;
 
 			int codeLength;
+			uint16_t codeMask;
 			int resetCodeLength;
 			int clearCode;
 			int stopCode;
-			int code;
 			int prev;
 			int dictionaryIndex;
-			int codeBit;
+
+			// Bits read from the data but not yet used, lowest bits first
+			uint32_t bitBuffer;
+			uint8_t bitCount;
 			
 			int drawX, drawY;
 			int outputLine;
 
 			uint8_t lineBuffer[GIF_LINE_BUFFER_MAX_SIZE];
+			uint8_t stringBuffer[GIF_MAX_DICTIONARY_ENTRIES];	// For strings that can't go straight into lineBuffer
 			int lineBufferSize;
 			int linesProcessed;
 			int lineBufferDivider;
@@ -5,6 +5,8 @@
 
 #include "../Memory/MemBlock.h"
 
+#define IMAGE_STRIP_SIZE (4 * 1024)		// Divides evenly into an EMS page
+
 struct ImageMetadata
 {
 	uint16_t width;
@@ -13,13 +15,79 @@ struct ImageMetadata
 	uint8_t bpp;
 };
 
+// Lines are stored in strips of linesPerStrip consecutive lines, each strip being a single block
+// sized to fit in an EMS page or swap allocation. The last strip may hold fewer lines
 struct Image : ImageMetadata
 {
-	Image() 
+	Image()
 	{
 		width = height = pitch = bpp = 0;
+		linesPerStrip = 0;
 	}
-	MemBlockHandle lines;
+
+	uint16_t NumStrips() { return (uint16_t)((height + linesPerStrip - 1) / linesPerStrip); }
+
+	MemBlockHandle strips;		// Table of MemBlockHandle, one per strip
+	uint16_t linesPerStrip;
+};
+
+// Steps through the lines of an image in order. The strip table is only looked at when moving
+// on to the next strip, so EMS and swap mapping happen once per strip rather than once per line
+class ImageLineIterator
+{
+public:
+	ImageLineIterator() : image(nullptr) {}
+
+	ImageLineIterator(Image* inImage, int y) : image(inImage)
+	{
+		stripSize = (uint16_t)(image->linesPerStrip * image->pitch);
+		stripIndex = (uint16_t)(y / image->linesPerStrip);
+		lineOffset = (uint16_t)((y % image->linesPerStrip) * image->pitch);
+		FetchStrip();
+	}
+
+	// Jumps to another line, only going back to the strip table if it is in a different strip
+	void SetLine(int y)
+	{
+		uint16_t newStripIndex = (uint16_t)(y / image->linesPerStrip);
+		lineOffset = (uint16_t)((y % image->linesPerStrip) * image->pitch);
+		if (newStripIndex != stripIndex)
+		{
+			stripIndex = newStripIndex;
+			FetchStrip();
+		}
+	}
+
+	uint8_t* Get() { return strip.Get<uint8_t*>() + lineOffset; }
+
+	// Needed after writing to the line in case it is stored in the swap file
+	void Commit() { strip.Commit(); }
+
+	void Next()
+	{
+		lineOffset += image->pitch;
+		if (lineOffset == stripSize)
+		{
+			stripIndex++;
+			lineOffset = 0;
+			FetchStrip();
+		}
+	}
+
+private:
+	void FetchStrip()
+	{
+		if (stripIndex < image->NumStrips())
+		{
+			strip = image->strips.Get<MemBlockHandle*>()[stripIndex];
+		}
+	}
+
+	Image* image;
+	MemBlockHandle strip;
+	uint16_t stripIndex;
+	uint16_t lineOffset;
+	uint16_t stripSize;
 };
 
 #endif
@@ -0,0 +1,371 @@
+//
+// Copyright (C) 2021 James Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "ImgCache.h"
+#include "../Platform.h"
+#include "../Draw/Surface.h"
+#include "../Memory/Memory.h"
+
+// Either block could be in EMS, so the destination is looked up again in case mapping the source replaced it
+static void CopyBlock(MemBlockHandle dest, MemBlockHandle src, uint16_t size)
+{
+	dest.Get<uint8_t*>();
+	uint8_t* srcData = src.Get<uint8_t*>();
+	uint8_t* destData = dest.Get<uint8_t*>();
+	memcpy(destData, srcData, size);
+	dest.Commit();
+}
+
+ImageCache::ImageCache()
+	: numEntries(0)
+	, numPages(0)
+	, maxPages(-1)
+	, canAllocatePages(true)
+	, isLoading(false)
+	, useCounter(0)
+	, unitsUsed(0)
+{
+}
+
+ImageCache& ImageCache::Get()
+{
+	static ImageCache cache;
+	return cache;
+}
+
+ImageCache::Entry* ImageCache::Find(const char* url, int width, int height, int bpp)
+{
+	for (int n = 0; n < numEntries; n++)
+	{
+		Entry& entry = entries[n];
+		if (entry.metadata.width == width && entry.metadata.height == height && entry.metadata.bpp == bpp && !strcmp(entry.url, url))
+		{
+			return &entry;
+		}
+	}
+	return nullptr;
+}
+
+bool ImageCache::FindSourceDimensions(const char* url, uint16_t& width, uint16_t& height)
+{
+	for (int n = 0; n < numEntries; n++)
+	{
+		if (!strcmp(entries[n].url, url))
+		{
+			width = entries[n].sourceWidth;
+			height = entries[n].sourceHeight;
+			return true;
+		}
+	}
+	return false;
+}
+
+void ImageCache::Put(const char* url, int sourceWidth, int sourceHeight, Image* image)
+{
+	if (!IMAGE_CACHE_MAX_PAGES || !image->strips.IsAllocated() || Find(url, image->width, image->height, image->bpp))
+	{
+		return;
+	}
+
+	if ((long)image->linesPerStrip * image->pitch > IMAGE_CACHE_PAGE_SIZE)
+	{
+		return;
+	}
+
+	// Built up separately, so that making room can't move it around in the entry table
+	Entry newEntry;
+	newEntry.sourceWidth = (uint16_t)sourceWidth;
+	newEntry.sourceHeight = (uint16_t)sourceHeight;
+	newEntry.metadata = *image;
+	newEntry.linesPerStrip = image->linesPerStrip;
+	newEntry.numStrips = image->NumStrips();
+	newEntry.url = (char*)malloc(strlen(url) + 1);
+	newEntry.strips = (StripLocation*)malloc(sizeof(StripLocation) * newEntry.numStrips);
+
+	if (!newEntry.url || !newEntry.strips)
+	{
+		free(newEntry.url);
+		free(newEntry.strips);
+		return;
+	}
+	strcpy(newEntry.url, url);
+
+	for (uint16_t n = 0; n < newEntry.numStrips; n++)
+	{
+		uint16_t size = GetStripSize(&newEntry, n);
+
+		if (!AllocateUnits(newEntry.strips[n], GetNumUnits(size)))
+		{
+			newEntry.numStrips = n;
+			Free(&newEntry);
+			return;
+		}
+
+		MemBlockHandle strip = image->strips.Get<MemBlockHandle*>()[n];
+		CopyBlock(GetBlock(newEntry.strips[n]), strip, size);
+	}
+
+	if (numEntries == IMAGE_CACHE_MAX_ENTRIES)
+	{
+		Remove(LeastRecentlyUsed());
+	}
+
+	newEntry.lastUsed = ++useCounter;
+	entries[numEntries++] = newEntry;
+}
+
+bool ImageCache::Load(const char* url, Image* image)
+{
+	uint8_t bpp = Platform::video->drawSurface->format == DrawSurface::Format_1BPP ? 1 : 8;
+	Entry* entry = Find(url, image->width, image->height, bpp);
+	if (!entry)
+	{
+		return false;
+	}
+
+	image->pitch = entry->metadata.pitch;
+	image->bpp = entry->metadata.bpp;
+	image->linesPerStrip = entry->linesPerStrip;
+
+	isLoading = true;
+	bool result = LoadStrips(entry, image);
+	isLoading = false;
+
+	if (result)
+	{
+		entry->lastUsed = ++useCounter;
+	}
+	return result;
+}
+
+bool ImageCache::LoadStrips(Entry* entry, Image* image)
+{
+	image->strips = MemoryManager::pageBlockAllocator.Allocate(sizeof(MemBlockHandle) * entry->numStrips);
+	if (!image->strips.IsAllocated())
+	{
+		return false;
+	}
+
+	for (uint16_t n = 0; n < entry->numStrips; n++)
+	{
+		uint16_t size = GetStripSize(entry, n);
+
+		MemBlockHandle strip = MemoryManager::pageBlockAllocator.Allocate(size);
+		if (!strip.IsAllocated())
+		{
+			image->strips.type = MemBlockHandle::Unallocated;
+			return false;
+		}
+
+		CopyBlock(strip, GetBlock(entry->strips[n]), size);
+
+		MemBlockHandle* strips = image->strips.Get<MemBlockHandle*>();
+		strips[n] = strip;
+		image->strips.Commit();
+	}
+
+	return true;
+}
+
+uint16_t ImageCache::GetStripSize(Entry* entry, uint16_t strip)
+{
+	uint16_t numLines = entry->linesPerStrip;
+	if (strip == entry->numStrips - 1)
+	{
+		numLines = entry->metadata.height - strip * entry->linesPerStrip;
+	}
+	return numLines * entry->metadata.pitch;
+}
+
+bool ImageCache::AllocateUnits(StripLocation& location, int numUnits)
+{
+	while (true)
+	{
+		// First fit in the pages already allocated
+		for (int p = 0; p < numPages; p++)
+		{
+			int run = 0;
+			for (int u = 0; u < (int) IMAGE_CACHE_UNITS_PER_PAGE; u++)
+			{
+				if (pages[p].used[u >> 3] & (1 << (u & 7)))
+				{
+					run = 0;
+				}
+				else if (++run == numUnits)
+				{
+					location.page = (uint8_t)p;
+					location.unit = (uint8_t)(u + 1 - numUnits);
+					SetUnits(location, numUnits, true);
+					return true;
+				}
+			}
+		}
+
+		if (AllocatePage())
+		{
+			continue;
+		}
+
+		Entry* oldest = LeastRecentlyUsed();
+		if (!oldest)
+		{
+			return false;
+		}
+		Remove(oldest);
+	}
+}
+
+bool ImageCache::AllocatePage()
+{
+	MemBlockHandle block;
+
+#ifdef __DOS__
+	if (maxPages < 0)
+	{
+		maxPages = (int)(MemoryManager::pageBlockAllocator.PersistentPoolSize() / IMAGE_CACHE_EMS_FRACTION / IMAGE_CACHE_PAGE_SIZE);
+		if (maxPages > IMAGE_CACHE_MAX_PAGES)
+		{
+			maxPages = IMAGE_CACHE_MAX_PAGES;
+		}
+		MemoryManager::pageBlockAllocator.SetReclaimHandler(ReclaimPage);
+	}
+
+	// Pages come off the end of the EMS the page allocates from, so only take one if the page still has room to grow
+	if (numPages >= maxPages || MemoryManager::pageBlockAllocator.PersistentPoolFree() < IMAGE_CACHE_PAGE_SIZE + IMAGE_CACHE_EMS_RESERVE)
+	{
+		return false;
+	}
+	block = MemoryManager::pageBlockAllocator.AllocatePersistent(IMAGE_CACHE_PAGE_SIZE);
+#else
+	if (!canAllocatePages || numPages >= IMAGE_CACHE_MAX_PAGES)
+	{
+		return false;
+	}
+	void* buffer = malloc(IMAGE_CACHE_PAGE_SIZE);
+	if (buffer)
+	{
+		block = MemBlockHandle(buffer);
+	}
+	else
+	{
+		canAllocatePages = false;
+	}
+#endif
+
+	if (!block.IsAllocated())
+	{
+		return false;
+	}
+
+	pages[numPages].block = block;
+	memset(pages[numPages].used, 0, sizeof(pages[numPages].used));
+	numPages++;
+	return true;
+}
+
+bool ImageCache::ReleasePage()
+{
+	if (isLoading || !numPages || !MemoryManager::pageBlockAllocator.FreePersistent(pages[numPages - 1].block))
+	{
+		return false;
+	}
+
+	numPages--;
+
+	// Removing an entry moves the last one into its place, which has already been looked at
+	for (int n = numEntries - 1; n >= 0; n--)
+	{
+		Entry& entry = entries[n];
+		for (uint16_t s = 0; s < entry.numStrips; s++)
+		{
+			if (entry.strips[s].page == numPages)
+			{
+				Remove(&entry);
+				break;
+			}
+		}
+	}
+	return true;
+}
+
+void ImageCache::Clear()
+{
+	while (numEntries)
+	{
+		Remove(&entries[numEntries - 1]);
+	}
+}
+
+void ImageCache::SetUnits(StripLocation location, int numUnits, bool isUsed)
+{
+	uint8_t* used = pages[location.page].used;
+
+	for (int u = location.unit; u < location.unit + numUnits; u++)
+	{
+		if (isUsed)
+			used[u >> 3] |= (uint8_t)(1 << (u & 7));
+		else
+			used[u >> 3] &= (uint8_t)~(1 << (u & 7));
+	}
+
+	unitsUsed += isUsed ? numUnits : -numUnits;
+}
+
+MemBlockHandle ImageCache::GetBlock(StripLocation location)
+{
+	MemBlockHandle block = pages[location.page].block;
+	uint16_t offset = location.unit * IMAGE_CACHE_UNIT_SIZE;
+
+	if (block.type == MemBlockHandle::Conventional)
+	{
+		block.conventionalPointer = (uint8_t*)block.conventionalPointer + offset;
+	}
+	else
+	{
+		block.emsPageOffset += offset;
+	}
+	return block;
+}
+
+void ImageCache::Free(Entry* entry)
+{
+	for (uint16_t n = 0; n < entry->numStrips; n++)
+	{
+		SetUnits(entry->strips[n], GetNumUnits(GetStripSize(entry, n)), false);
+	}
+	free(entry->url);
+	free(entry->strips);
+}
+
+void ImageCache::Remove(Entry* entry)
+{
+	Free(entry);
+	*entry = entries[--numEntries];
+}
+
+ImageCache::Entry* ImageCache::LeastRecentlyUsed()
+{
+	Entry* result = nullptr;
+
+	for (int n = 0; n < numEntries; n++)
+	{
+		if (!result || entries[n].lastUsed < result->lastUsed)
+		{
+			result = &entries[n];
+		}
+	}
+	return result;
+}
@@ -0,0 +1,121 @@
+//
+// Copyright (C) 2021 James Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+
+#ifndef _IMGCACHE_H_
+#define _IMGCACHE_H_
+
+#include <stdint.h>
+#include "Image.h"
+#include "../Memory/MemBlock.h"
+
+#define IMAGE_CACHE_PAGE_SIZE (16 * 1024u)		// Same as an EMS page
+#define IMAGE_CACHE_UNIT_SIZE 256
+#define IMAGE_CACHE_UNITS_PER_PAGE (IMAGE_CACHE_PAGE_SIZE / IMAGE_CACHE_UNIT_SIZE)
+#define IMAGE_CACHE_MAX_ENTRIES 64
+
+// Most memory that decoded images can be kept in between pages. On DOS this only comes from EMS,
+// as conventional memory is needed for the page itself, and is further limited by the size of the card
+#if defined(HP95LX)
+#define IMAGE_CACHE_BUDGET 0l
+#elif defined(__DOS__)
+#define IMAGE_CACHE_BUDGET (256 * 1024l)
+#else
+#define IMAGE_CACHE_BUDGET (2048 * 1024l)
+#endif
+
+#define IMAGE_CACHE_MAX_PAGES ((int)(IMAGE_CACHE_BUDGET / IMAGE_CACHE_PAGE_SIZE))
+
+// Share of the EMS left over once the cache is first used that it can grow to, and how much of it must
+// stay free for the current page whenever the cache takes another page
+#define IMAGE_CACHE_EMS_FRACTION 4
+#define IMAGE_CACHE_EMS_RESERVE (64 * 1024l)
+
+// Decoded images from earlier pages, keyed by absolute URL and output size and format, so that
+// going back to a page or visiting another one with the same logos and icons doesn't download or
+// decode them again. Strips are copied into pages that survive the page allocators being reset,
+// and the least recently used images are dropped when there isn't room for a new one
+class ImageCache
+{
+public:
+	static ImageCache& Get();
+
+	// Keeps a copy of a fully decoded image
+	void Put(const char* url, int sourceWidth, int sourceHeight, Image* image);
+
+	// Allocates and fills in the strips of an image already sized by layout. Returns false if it isn't cached
+	bool Load(const char* url, Image* image);
+
+	// Size of the image before it was scaled for the video mode and layout
+	bool FindSourceDimensions(const char* url, uint16_t& width, uint16_t& height);
+
+	// Drops every image, so that reloading a page fetches them again
+	void Clear();
+
+	long TotalUsed() { return (long)unitsUsed * IMAGE_CACHE_UNIT_SIZE; }
+
+private:
+	struct StripLocation
+	{
+		uint8_t page;
+		uint8_t unit;
+	};
+
+	struct Entry
+	{
+		char* url;
+		uint16_t sourceWidth, sourceHeight;
+		ImageMetadata metadata;
+		uint16_t linesPerStrip;
+		uint16_t numStrips;
+		StripLocation* strips;
+		long lastUsed;
+	};
+
+	struct Page
+	{
+		MemBlockHandle block;
+		uint8_t used[IMAGE_CACHE_UNITS_PER_PAGE / 8];	// Bit per unit
+	};
+
+	ImageCache();
+
+	Entry* Find(const char* url, int width, int height, int bpp);
+	bool LoadStrips(Entry* entry, Image* image);
+	bool AllocateUnits(StripLocation& location, int numUnits);
+	bool AllocatePage();
+	// Gives the most recent page back to the page allocator along with the images in it, if it is on top of the persistent blocks
+	bool ReleasePage();
+	static bool ReclaimPage() { return Get().ReleasePage(); }
+	void SetUnits(StripLocation location, int numUnits, bool isUsed);
+	MemBlockHandle GetBlock(StripLocation location);
+	uint16_t GetStripSize(Entry* entry, uint16_t strip);
+	static int GetNumUnits(uint16_t size) { return (size + IMAGE_CACHE_UNIT_SIZE - 1) / IMAGE_CACHE_UNIT_SIZE; }
+	void Free(Entry* entry);
+	void Remove(Entry* entry);
+	Entry* LeastRecentlyUsed();
+
+	Entry entries[IMAGE_CACHE_MAX_ENTRIES];
+	int numEntries;
+
+	Page pages[IMAGE_CACHE_MAX_PAGES + 1];
+	int numPages;
+	int maxPages;	// -1 until the EMS left over is measured
+	bool canAllocatePages;
+	bool isLoading;	// Entries can't be dropped to make room for the strips of the one being loaded
+
+	long useCounter;
+	long unitsUsed;
+};
+
+#endif
@@ -2,30 +2,6 @@
 #include "Image.h"
 #include "../Platform.h"
 
-// Start of Frame markers, non-differential, Huffman coding
-const uint8_t SOF0 = 0xC0; // Baseline DCT
-const uint8_t SOF1 = 0xC1; // Extended sequential DCT
-const uint8_t SOF2 = 0xC2; // Progressive DCT
-const uint8_t SOF3 = 0xC3; // Lossless (sequential)
-
-// Start of Frame markers, differential, Huffman coding
-const uint8_t SOF5 = 0xC5; // Differential sequential DCT
-const uint8_t SOF6 = 0xC6; // Differential progressive DCT
-const uint8_t SOF7 = 0xC7; // Differential lossless (sequential)
-
-// Start of Frame markers, non-differential, arithmetic coding
-const uint8_t SOF9 = 0xC9; // Extended sequential DCT
-const uint8_t SOF10 = 0xCA; // Progressive DCT
-const uint8_t SOF11 = 0xCB; // Lossless (sequential)
-
-// Start of Frame markers, differential, arithmetic coding
-const uint8_t SOF13 = 0xCD; // Differential sequential DCT
-const uint8_t SOF14 = 0xCE; // Differential progressive DCT
-const uint8_t SOF15 = 0xCF; // Differential lossless (sequential)
-
-const uint8_t SOI = 0xD8; // Start of Image
-const uint8_t EOI = 0xD9; // End of Image
-
 JpegDecoder::JpegDecoder()
 	: internalState(ParseStartMarker)
 {
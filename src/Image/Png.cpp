@@ -13,6 +13,11 @@ PngDecoder::PngDecoder()
 {
 }
 
+bool PngDecoder::IsSignature(const uint8_t* data)
+{
+	return !memcmp(data, pngSignature, PNG_SIGNATURE_LENGTH);
+}
+
 void PngDecoder::Process(uint8_t* data, size_t dataLength)
 {
 	if (state != ImageDecoder::Decoding)
@@ -27,7 +32,7 @@ void PngDecoder::Process(uint8_t* data, size_t dataLength)
 		case ParseSignature:
 			if (FillStruct(&data, dataLength, signature, PNG_SIGNATURE_LENGTH))
 			{
-				if(memcmp(signature, pngSignature, PNG_SIGNATURE_LENGTH))
+				if(!IsSignature(signature))
 				{
 					state = ImageDecoder::Error;
 					return;
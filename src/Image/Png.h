@@ -11,15 +11,6 @@ public:
 	PngDecoder();
 	virtual void Process(uint8_t* data, size_t dataLength) override;
 
-private:
-	enum InternalState
-	{
-		ParseSignature,
-		ParseChunkHeader,
-		SkipChunk,
-		ParseImageHeader,
-	};
-
 #pragma pack(push, 1)
 	struct ChunkHeader
 	{
@@ -39,6 +30,18 @@ private:
 	};
 #pragma pack(pop)
 
+	// Also used by ImageProbe, which reads the headers without a decoder
+	static bool IsSignature(const uint8_t* data);
+
+private:
+	enum InternalState
+	{
+		ParseSignature,
+		ParseChunkHeader,
+		SkipChunk,
+		ParseImageHeader,
+	};
+
 	InternalState internalState;
 
 	uint8_t signature[PNG_SIGNATURE_LENGTH];
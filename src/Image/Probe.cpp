@@ -0,0 +1,183 @@
+//
+// Copyright (C) 2021 James Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+
+#include <string.h>
+#include "Probe.h"
+#include "Gif.h"
+#include "Png.h"
+#include "Jpeg.h"
+
+void ImageProbe::Begin()
+{
+	state = ImageProbe::Probing;
+	internalState = ParseSignature;
+	bufferSize = 0;
+	skipRemaining = 0;
+	sourceWidth = sourceHeight = 0;
+}
+
+bool ImageProbe::FillBuffer(const uint8_t*& data, size_t& dataLength, size_t size)
+{
+	while (bufferSize < size && dataLength)
+	{
+		buffer[bufferSize++] = *data++;
+		dataLength--;
+	}
+	return bufferSize == size;
+}
+
+ImageProbe::State ImageProbe::Process(const uint8_t* data, size_t dataLength)
+{
+	while (dataLength && state == ImageProbe::Probing)
+	{
+		switch (internalState)
+		{
+		case ParseSignature:
+			// Two bytes are enough to tell the formats apart. GIF and PNG carry on filling the same
+			// buffer, as the bytes are part of their header and signature
+			if (FillBuffer(data, dataLength, 2))
+			{
+				if (buffer[0] == 'G' && buffer[1] == 'I')
+				{
+					internalState = ParseGifHeader;
+				}
+				else if (buffer[0] == 0x89 && buffer[1] == 'P')
+				{
+					internalState = ParsePngSignature;
+				}
+				else if (buffer[0] == 0xff && buffer[1] == SOI)
+				{
+					bufferSize = 0;
+					internalState = ParseJpegMarker;
+				}
+				else
+				{
+					state = ImageProbe::Error;
+				}
+			}
+			break;
+
+		case ParseGifHeader:
+			if (FillBuffer(data, dataLength, sizeof(GifDecoder::Header)))
+			{
+				GifDecoder::Header* header = (GifDecoder::Header*) buffer;
+				if (!GifDecoder::IsValidHeader(*header))
+				{
+					state = ImageProbe::Error;
+				}
+				else
+				{
+					sourceWidth = header->width;
+					sourceHeight = header->height;
+					state = ImageProbe::Success;
+				}
+			}
+			break;
+
+		case ParsePngSignature:
+			if (FillBuffer(data, dataLength, PNG_SIGNATURE_LENGTH))
+			{
+				bufferSize = 0;
+				if (!PngDecoder::IsSignature(buffer))
+				{
+					state = ImageProbe::Error;
+				}
+				internalState = ParsePngChunkHeader;
+			}
+			break;
+
+		case ParsePngChunkHeader:
+			// IHDR must be the first chunk
+			if (FillBuffer(data, dataLength, sizeof(PngDecoder::ChunkHeader)))
+			{
+				bufferSize = 0;
+				if (memcmp(((PngDecoder::ChunkHeader*) buffer)->type, "IHDR", 4))
+				{
+					state = ImageProbe::Error;
+				}
+				internalState = ParsePngImageHeader;
+			}
+			break;
+
+		case ParsePngImageHeader:
+			if (FillBuffer(data, dataLength, sizeof(PngDecoder::ImageHeader)))
+			{
+				PngDecoder::ImageHeader* header = (PngDecoder::ImageHeader*) buffer;
+				sourceWidth = (int) (uint32_t) header->width;
+				sourceHeight = (int) (uint32_t) header->height;
+				state = ImageProbe::Success;
+			}
+			break;
+
+		case ParseJpegMarker:
+			if (FillBuffer(data, dataLength, sizeof(uint16_be)))
+			{
+				uint16_be* marker = (uint16_be*) buffer;
+				bufferSize = 0;
+				if (marker->highByte != 0xff || marker->lowByte == EOI)
+				{
+					state = ImageProbe::Error;
+				}
+				else if (marker->lowByte == SOF0 || marker->lowByte == SOF2)
+				{
+					internalState = ParseJpegFrameHeader;
+				}
+				else
+				{
+					internalState = ParseJpegSegmentLength;
+				}
+			}
+			break;
+
+		case ParseJpegSegmentLength:
+			if (FillBuffer(data, dataLength, sizeof(uint16_be)))
+			{
+				bufferSize = 0;
+				skipRemaining = (long) (uint16_t) *((uint16_be*) buffer) - 2;
+				if (skipRemaining < 0)
+				{
+					state = ImageProbe::Error;
+				}
+				internalState = SkipJpegSegment;
+			}
+			break;
+
+		case SkipJpegSegment:
+			if ((long)dataLength >= skipRemaining)
+			{
+				data += skipRemaining;
+				dataLength -= skipRemaining;
+				internalState = ParseJpegMarker;
+			}
+			else
+			{
+				skipRemaining -= dataLength;
+				dataLength = 0;
+			}
+			break;
+
+		case ParseJpegFrameHeader:
+			if (FillBuffer(data, dataLength, sizeof(JpegDecoder::FrameHeader)))
+			{
+				JpegDecoder::FrameHeader* header = (JpegDecoder::FrameHeader*) buffer;
+				sourceWidth = (uint16_t) header->width;
+				sourceHeight = (uint16_t) header->height;
+				state = ImageProbe::Success;
+			}
+			break;
+		}
+	}
+
+	return state;
+}
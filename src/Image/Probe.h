@@ -0,0 +1,71 @@
+//
+// Copyright (C) 2021 James Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+
+#ifndef _PROBE_H_
+#define _PROBE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define IMAGE_PROBE_BUFFER_SIZE 16		// Big enough for the largest header read, see Probe.cpp
+
+// Reads just enough of a GIF, PNG or JPEG stream to find the image dimensions.
+// Unlike ImageDecoder this keeps no large buffers, so several images can be
+// probed at once while the page is still being laid out. The headers are read
+// into the same structures the decoders use
+class ImageProbe
+{
+public:
+	enum State
+	{
+		Probing,
+		Success,
+		Error
+	};
+
+	ImageProbe() { Begin(); }
+
+	void Begin();
+	State Process(const uint8_t* data, size_t dataLength);
+	State GetState() { return state; }
+
+	// Dimensions as stored in the file, before any scaling for the video mode
+	int sourceWidth;
+	int sourceHeight;
+
+private:
+	enum InternalState
+	{
+		ParseSignature,
+		ParseGifHeader,
+		ParsePngSignature,
+		ParsePngChunkHeader,
+		ParsePngImageHeader,
+		ParseJpegMarker,
+		ParseJpegSegmentLength,
+		SkipJpegSegment,
+		ParseJpegFrameHeader
+	};
+
+	bool FillBuffer(const uint8_t*& data, size_t& dataLength, size_t size);
+
+	State state;
+	InternalState internalState;
+
+	uint8_t buffer[IMAGE_PROBE_BUFFER_SIZE];
+	size_t bufferSize;
+	long skipRemaining;
+};
+
+#endif
@@ -0,0 +1,703 @@
+//
+// Copyright (C) 2021 James Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "Inflate.h"
+#include "Memory/Memory.h"
+
+#define GZIP_FLAG_HEADER_CRC 0x02
+#define GZIP_FLAG_EXTRA 0x04
+#define GZIP_FLAG_NAME 0x08
+#define GZIP_FLAG_COMMENT 0x10
+
+#define GZIP_TRAILER_LENGTH 8
+#define ZLIB_TRAILER_LENGTH 4
+
+#define NEED_MORE_INPUT -1
+#define INVALID_CODE -2
+
+static const uint16_t lengthBase[29] =
+{
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t lengthExtraBits[29] =
+{
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t distanceBase[30] =
+{
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t distanceExtraBits[30] =
+{
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+static const uint8_t codeLengthOrder[19] =
+{
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+uint8_t* Inflater::sharedWindow = NULL;
+Inflater* Inflater::sharedWindowOwner = NULL;
+
+Inflater* Inflater::Create()
+{
+	Inflater* inflater = new Inflater();
+	if (inflater && !inflater->AllocateWindow())
+	{
+		delete inflater;
+		inflater = NULL;
+	}
+	return inflater;
+}
+
+Inflater::Inflater() : window(NULL), hasHistory(false)
+{
+	literalCode.symbol = literalSymbols;
+	distanceCode.symbol = distanceSymbols;
+	Reset();
+}
+
+Inflater::~Inflater()
+{
+	if (hasHistory)
+	{
+		free(window);
+	}
+	else
+	{
+		ReleaseWindow();
+	}
+}
+
+bool Inflater::AllocateWindow()
+{
+	int numHistoryBlocks = 0;
+	while (numHistoryBlocks < (int) INFLATE_HISTORY_BLOCKS)
+	{
+		historyBlocks[numHistoryBlocks] = MemoryManager::pageBlockAllocator.AllocatePersistent(INFLATE_HISTORY_BLOCK_SIZE);
+		if (!historyBlocks[numHistoryBlocks].IsAllocated())
+		{
+			break;
+		}
+		numHistoryBlocks++;
+	}
+	hasHistory = numHistoryBlocks == INFLATE_HISTORY_BLOCKS;
+
+	if (hasHistory)
+	{
+		windowSize = INFLATE_BOUNDED_WINDOW_SIZE;
+		windowMask = windowSize - 1;
+		window = (uint8_t*)malloc(windowSize);
+		return window != NULL;
+	}
+
+	// Give back a partial history, newest first as persistent blocks come off a stack
+	while (numHistoryBlocks > 0)
+	{
+		numHistoryBlocks--;
+		MemoryManager::pageBlockAllocator.FreePersistent(historyBlocks[numHistoryBlocks]);
+	}
+
+#ifdef INFLATE_REQUIRE_EMS_WINDOW
+	return false;
+#else
+	// The conventional window is only picked up once compressed content is asked for
+	windowSize = INFLATE_WINDOW_SIZE;
+	windowMask = windowSize - 1;
+	return true;
+#endif
+}
+
+bool Inflater::AcquireWindow()
+{
+	if (window)
+	{
+		return true;
+	}
+	if (sharedWindowOwner)
+	{
+		return false;
+	}
+	if (!sharedWindow)
+	{
+		sharedWindow = (uint8_t*)malloc(INFLATE_WINDOW_SIZE);
+		if (!sharedWindow)
+		{
+			return false;
+		}
+	}
+	sharedWindowOwner = this;
+	window = sharedWindow;
+	return true;
+}
+
+void Inflater::ReleaseWindow()
+{
+	if (sharedWindowOwner == this)
+	{
+		sharedWindowOwner = NULL;
+		window = NULL;
+	}
+}
+
+void Inflater::Reset()
+{
+	state = StreamHeader;
+	inputPos = 0;
+	inputLength = 0;
+	bitBuffer = 0;
+	bitCount = 0;
+	outputPosition = 0;
+	trailerLength = 0;
+	skipBytes = 0;
+}
+
+uint8_t* Inflater::GetInputBuffer(size_t& space)
+{
+	if (inputPos == inputLength)
+	{
+		inputPos = 0;
+		inputLength = 0;
+	}
+	space = INFLATE_INPUT_BUFFER_SIZE - inputLength;
+	return input + inputLength;
+}
+
+size_t Inflater::Inflate(uint8_t* output, size_t outputLength)
+{
+	out = output;
+	outEnd = output + outputLength;
+
+	while (Step());
+
+	return (size_t)(out - output);
+}
+
+void Inflater::FillBits()
+{
+	while (bitCount <= 24 && inputPos < inputLength)
+	{
+		bitBuffer |= (uint32_t)input[inputPos++] << bitCount;
+		bitCount += 8;
+	}
+}
+
+bool Inflater::NeedBits(uint8_t count)
+{
+	if (bitCount < count)
+	{
+		FillBits();
+	}
+	return bitCount >= count;
+}
+
+// Only used on byte aligned parts of the stream
+int Inflater::ReadByte()
+{
+	if (!NeedBits(8))
+	{
+		return -1;
+	}
+	int result = (int)(bitBuffer & 0xff);
+	DropBits(8);
+	return result;
+}
+
+// Finds the next symbol without consuming its bits, so that decoding can stop part way through
+// a code and carry on when more input arrives
+int Inflater::PeekSymbol(const Huffman& huffman, uint8_t& codeBits)
+{
+	FillBits();
+
+	uint32_t bits = bitBuffer;
+	uint16_t code = 0;
+	uint16_t first = 0;
+	uint16_t index = 0;
+
+	for (uint8_t length = 1; length <= INFLATE_MAX_CODE_BITS; length++)
+	{
+		if (length > bitCount)
+		{
+			return NEED_MORE_INPUT;
+		}
+
+		code |= (uint16_t)(bits & 1);
+		bits >>= 1;
+
+		uint16_t count = huffman.count[length];
+		if (code < first + count)
+		{
+			codeBits = length;
+			return huffman.symbol[index + (code - first)];
+		}
+		index += count;
+		first += count;
+		first <<= 1;
+		code <<= 1;
+	}
+
+	return INVALID_CODE;
+}
+
+// Returns negative for an over-subscribed set of lengths. Incomplete codes are allowed and
+// fail when an unused code turns up in the data
+int Inflater::BuildHuffman(Huffman& huffman, const uint8_t* lengths, int numSymbols)
+{
+	uint16_t offsets[INFLATE_MAX_CODE_BITS + 1];
+
+	memset(huffman.count, 0, sizeof(huffman.count));
+	for (int symbol = 0; symbol < numSymbols; symbol++)
+	{
+		huffman.count[lengths[symbol]]++;
+	}
+	if (huffman.count[0] == numSymbols)
+	{
+		return 0;
+	}
+
+	int left = 1;
+	for (int length = 1; length <= INFLATE_MAX_CODE_BITS; length++)
+	{
+		left <<= 1;
+		left -= huffman.count[length];
+		if (left < 0)
+		{
+			return left;
+		}
+	}
+
+	offsets[1] = 0;
+	for (int length = 1; length < INFLATE_MAX_CODE_BITS; length++)
+	{
+		offsets[length + 1] = offsets[length] + huffman.count[length];
+	}
+
+	for (int symbol = 0; symbol < numSymbols; symbol++)
+	{
+		if (lengths[symbol])
+		{
+			huffman.symbol[offsets[lengths[symbol]]++] = symbol;
+		}
+	}
+
+	return left;
+}
+
+void Inflater::BuildFixedTables()
+{
+	int symbol = 0;
+	for (; symbol < 144; symbol++)
+		lengths[symbol] = 8;
+	for (; symbol < 256; symbol++)
+		lengths[symbol] = 9;
+	for (; symbol < 280; symbol++)
+		lengths[symbol] = 7;
+	for (; symbol < INFLATE_MAX_LITERAL_CODES; symbol++)
+		lengths[symbol] = 8;
+	BuildHuffman(literalCode, lengths, INFLATE_MAX_LITERAL_CODES);
+
+	for (symbol = 0; symbol < 30; symbol++)
+		lengths[symbol] = 5;
+	BuildHuffman(distanceCode, lengths, 30);
+}
+
+void Inflater::PutByte(uint8_t value)
+{
+	window[(uint16_t)outputPosition & windowMask] = value;
+	*out++ = value;
+	outputPosition++;
+
+	if (hasHistory && !((uint16_t)outputPosition & (windowMask >> 1)))
+	{
+		FlushToHistory();
+	}
+}
+
+// Copies the half of the window that has just been filled out to the EMS history
+void Inflater::FlushToHistory()
+{
+	uint16_t halfWindowSize = windowSize / 2;
+	uint16_t position = (uint16_t)(outputPosition - halfWindowSize);
+	memcpy(MapHistory(position & (INFLATE_WINDOW_SIZE - 1)), window + (position & windowMask), halfWindowSize);
+}
+
+uint8_t* Inflater::MapHistory(uint16_t position)
+{
+	MemBlockHandle block = historyBlocks[position / INFLATE_HISTORY_BLOCK_SIZE];
+	block.emsPageOffset += position % INFLATE_HISTORY_BLOCK_SIZE;
+	return block.Get<uint8_t*>();
+}
+
+bool Inflater::Fail()
+{
+	state = Failed;
+	return false;
+}
+
+void Inflater::EndBlock()
+{
+	if (isLastBlock)
+	{
+		// Trailer is byte aligned
+		DropBits(bitCount & 7);
+		skipBytes = trailerLength;
+		state = Trailer;
+	}
+	else
+	{
+		state = BlockHeader;
+	}
+}
+
+// Returns false when no more progress can be made until there is more input or output space
+bool Inflater::Step()
+{
+	uint8_t codeBits;
+	int symbol;
+
+	switch (state)
+	{
+	case StreamHeader:
+	{
+		if (!NeedBits(16))
+			return false;
+
+		uint8_t first = (uint8_t)Bits(8);
+		uint8_t second = (uint8_t)(Bits(16) >> 8);
+
+		if (first == 0x1f && second == 0x8b)
+		{
+			DropBits(16);
+			trailerLength = GZIP_TRAILER_LENGTH;
+			state = GzipFlags;
+		}
+		else if ((first & 0x0f) == 8 && ((((uint16_t)first << 8) | second) % 31) == 0)
+		{
+			// zlib header, preset dictionaries are never used for HTTP content
+			if (second & 0x20)
+				return Fail();
+			DropBits(16);
+			trailerLength = ZLIB_TRAILER_LENGTH;
+			state = BlockHeader;
+		}
+		else
+		{
+			// Some servers send raw deflate data for 'Content-Encoding: deflate'
+			state = BlockHeader;
+		}
+		return true;
+	}
+
+	case GzipFlags:
+		if (!NeedBits(16))
+			return false;
+		if (Bits(8) != 8)
+			return Fail();
+		gzipFlags = (uint8_t)(Bits(16) >> 8);
+		DropBits(16);
+
+		// Modification time, extra flags and OS
+		skipBytes = 6;
+		state = GzipHeader;
+		return true;
+
+	case GzipHeader:
+		// Skips over whichever optional fields are present
+		while (skipBytes)
+		{
+			if (ReadByte() < 0)
+				return false;
+			skipBytes--;
+		}
+
+		if (gzipFlags & GZIP_FLAG_EXTRA)
+		{
+			if (!NeedBits(16))
+				return false;
+			skipBytes = Bits(16);
+			DropBits(16);
+			gzipFlags &= ~GZIP_FLAG_EXTRA;
+		}
+		else if (gzipFlags & (GZIP_FLAG_NAME | GZIP_FLAG_COMMENT))
+		{
+			symbol = ReadByte();
+			if (symbol < 0)
+				return false;
+			if (!symbol)
+			{
+				gzipFlags &= (gzipFlags & GZIP_FLAG_NAME) ? ~GZIP_FLAG_NAME : ~GZIP_FLAG_COMMENT;
+			}
+		}
+		else if (gzipFlags & GZIP_FLAG_HEADER_CRC)
+		{
+			skipBytes = 2;
+			gzipFlags &= ~GZIP_FLAG_HEADER_CRC;
+		}
+		else
+		{
+			state = BlockHeader;
+		}
+		return true;
+
+	case BlockHeader:
+		if (!NeedBits(3))
+			return false;
+		isLastBlock = Bits(1) != 0;
+		symbol = Bits(3) >> 1;
+		DropBits(3);
+
+		switch (symbol)
+		{
+		case 0:
+			DropBits(bitCount & 7);
+			state = StoredHeader;
+			break;
+		case 1:
+			BuildFixedTables();
+			state = LengthSymbol;
+			break;
+		case 2:
+			state = TableHeader;
+			break;
+		default:
+			return Fail();
+		}
+		return true;
+
+	case StoredHeader:
+	{
+		if (!NeedBits(32))
+			return false;
+		storedRemaining = Bits(16);
+		DropBits(16);
+		uint16_t complement = Bits(16);
+		DropBits(16);
+		if (storedRemaining != (uint16_t)~complement)
+			return Fail();
+		state = StoredCopy;
+		return true;
+	}
+
+	case StoredCopy:
+		while (storedRemaining)
+		{
+			if (out == outEnd)
+				return false;
+			symbol = ReadByte();
+			if (symbol < 0)
+				return false;
+			PutByte((uint8_t)symbol);
+			storedRemaining--;
+		}
+		EndBlock();
+		return true;
+
+	case TableHeader:
+		if (!NeedBits(14))
+			return false;
+		literalCodeCount = Bits(5) + 257;
+		DropBits(5);
+		distanceCodeCount = Bits(5) + 1;
+		DropBits(5);
+		codeLengthCodeCount = Bits(4) + 4;
+		DropBits(4);
+		if (literalCodeCount > 286 || distanceCodeCount > 30)
+			return Fail();
+
+		memset(lengths, 0, 19);
+		codeIndex = 0;
+		state = CodeLengthCodes;
+		return true;
+
+	case CodeLengthCodes:
+		while (codeIndex < codeLengthCodeCount)
+		{
+			if (!NeedBits(3))
+				return false;
+			lengths[codeLengthOrder[codeIndex++]] = (uint8_t)Bits(3);
+			DropBits(3);
+		}
+
+		// Code length code is only needed until the real tables are built, so borrows the distance table
+		if (BuildHuffman(distanceCode, lengths, 19) != 0)
+			return Fail();
+		codeIndex = 0;
+		state = CodeLengths;
+		return true;
+
+	case CodeLengths:
+		while (codeIndex < literalCodeCount + distanceCodeCount)
+		{
+			symbol = PeekSymbol(distanceCode, codeBits);
+			if (symbol == NEED_MORE_INPUT)
+				return false;
+			if (symbol < 0)
+				return Fail();
+
+			if (symbol < 16)
+			{
+				DropBits(codeBits);
+				lengths[codeIndex++] = (uint8_t)symbol;
+				continue;
+			}
+
+			uint8_t extraBits = symbol == 16 ? 2 : symbol == 17 ? 3 : 7;
+			if (!NeedBits(codeBits + extraBits))
+				return false;
+			DropBits(codeBits);
+
+			int repeat = (symbol == 18 ? 11 : 3) + Bits(extraBits);
+			DropBits(extraBits);
+
+			uint8_t value = 0;
+			if (symbol == 16)
+			{
+				if (!codeIndex)
+					return Fail();
+				value = lengths[codeIndex - 1];
+			}
+			if (codeIndex + repeat > literalCodeCount + distanceCodeCount)
+				return Fail();
+			while (repeat--)
+			{
+				lengths[codeIndex++] = value;
+			}
+		}
+
+		// Every block has to be able to end
+		if (!lengths[256])
+			return Fail();
+		if (BuildHuffman(literalCode, lengths, literalCodeCount) < 0 || BuildHuffman(distanceCode, lengths + literalCodeCount, distanceCodeCount) < 0)
+			return Fail();
+		state = LengthSymbol;
+		return true;
+
+	case LengthSymbol:
+		// The end of block code is taken even when the output is full, so that the end of the stream
+		// can be reached along with the last of the output
+		while (1)
+		{
+			symbol = PeekSymbol(literalCode, codeBits);
+			if (symbol == NEED_MORE_INPUT)
+				return false;
+			if (symbol < 0)
+				return Fail();
+
+			if (symbol < 256)
+			{
+				if (out == outEnd)
+					return false;
+				DropBits(codeBits);
+				PutByte((uint8_t)symbol);
+				continue;
+			}
+			if (symbol == 256)
+			{
+				DropBits(codeBits);
+				EndBlock();
+				return true;
+			}
+
+			symbol -= 257;
+			if (symbol >= 29)
+				return Fail();
+			if (!NeedBits(codeBits + lengthExtraBits[symbol]))
+				return false;
+			DropBits(codeBits);
+			matchLength = lengthBase[symbol] + Bits(lengthExtraBits[symbol]);
+			DropBits(lengthExtraBits[symbol]);
+			state = DistanceSymbol;
+			return true;
+		}
+
+	case DistanceSymbol:
+		symbol = PeekSymbol(distanceCode, codeBits);
+		if (symbol == NEED_MORE_INPUT)
+			return false;
+		if (symbol < 0 || symbol >= 30)
+			return Fail();
+		if (!NeedBits(codeBits + distanceExtraBits[symbol]))
+			return false;
+		DropBits(codeBits);
+		matchDistance = distanceBase[symbol] + Bits(distanceExtraBits[symbol]);
+		DropBits(distanceExtraBits[symbol]);
+		if (matchDistance > outputPosition)
+			return Fail();
+		state = CopyMatch;
+		return true;
+
+	case CopyMatch:
+		while (matchLength)
+		{
+			if (out == outEnd)
+				return false;
+
+			if (matchDistance <= windowSize)
+			{
+				PutByte(window[(uint16_t)(outputPosition - matchDistance) & windowMask]);
+				matchLength--;
+			}
+			else
+			{
+				// Older output is only in the EMS history. Take a copy before writing anything,
+				// since writing may need to map in a different part of the history
+				uint8_t buffer[INFLATE_HISTORY_COPY_SIZE];
+				uint16_t position = (uint16_t)(outputPosition - matchDistance) & (INFLATE_WINDOW_SIZE - 1);
+				uint16_t length = INFLATE_HISTORY_BLOCK_SIZE - position % INFLATE_HISTORY_BLOCK_SIZE;
+				if (length > INFLATE_HISTORY_COPY_SIZE)
+					length = INFLATE_HISTORY_COPY_SIZE;
+				if (length > matchLength)
+					length = matchLength;
+				if (length > (size_t)(outEnd - out))
+					length = (uint16_t)(outEnd - out);
+
+				memcpy(buffer, MapHistory(position), length);
+				for (uint16_t n = 0; n < length; n++)
+				{
+					PutByte(buffer[n]);
+				}
+				matchLength -= length;
+			}
+		}
+		state = LengthSymbol;
+		return true;
+
+	case Trailer:
+		// Checksums are not verified, a corrupt stream almost always fails to decode anyway
+		while (skipBytes)
+		{
+			if (ReadByte() < 0)
+				return false;
+			skipBytes--;
+		}
+		state = Finished;
+		return true;
+
+	case Finished:
+	case Failed:
+		// Anything after the end of the stream is ignored
+		inputPos = inputLength;
+		bitCount = 0;
+		bitBuffer = 0;
+		return false;
+	}
+
+	return false;
+}
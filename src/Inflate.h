@@ -0,0 +1,160 @@
+//
+// Copyright (C) 2021 James Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+
+#ifndef _INFLATE_H_
+#define _INFLATE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "Memory/MemBlock.h"
+
+// Deflate streams can refer back to anything in the last 32K of output
+#define INFLATE_WINDOW_SIZE (32 * 1024u)
+
+// When the full window is kept in EMS, only the most recent output stays in conventional memory.
+// Matches in HTML are mostly short range so rarely need to go out to EMS
+#define INFLATE_BOUNDED_WINDOW_SIZE (4 * 1024u)
+#define INFLATE_HISTORY_BLOCK_SIZE (16 * 1024u)
+#define INFLATE_HISTORY_BLOCKS (INFLATE_WINDOW_SIZE / INFLATE_HISTORY_BLOCK_SIZE)
+#define INFLATE_HISTORY_COPY_SIZE 32
+
+#define INFLATE_INPUT_BUFFER_SIZE 256
+#define INFLATE_MAX_CODE_BITS 15
+#define INFLATE_MAX_LITERAL_CODES 288
+#define INFLATE_MAX_DISTANCE_CODES 32
+
+#ifdef HP95LX
+// Not enough conventional memory to spare for a full window, so compressed content needs EMS
+#define INFLATE_REQUIRE_EMS_WINDOW
+#endif
+
+// Streaming decoder for gzip, zlib and raw deflate data. Compressed data can be added in any
+// sized pieces and decoded output is read back as it becomes available
+class Inflater
+{
+public:
+	static Inflater* Create();
+	~Inflater();
+
+	void Reset();
+
+	// Compressed data is received straight into the inflater's input buffer
+	uint8_t* GetInputBuffer(size_t& space);
+	void AddInput(size_t length) { inputLength += length; }
+
+	size_t Inflate(uint8_t* output, size_t outputLength);
+
+	bool IsFinished() { return state == Finished; }
+	bool HasFailed() { return state == Failed; }
+
+	// Without EMS the full window has to be in conventional memory, so a single one is shared and
+	// only held while a request is asking for compressed content. Fails if another inflater has it
+	bool AcquireWindow();
+	void ReleaseWindow();
+	bool HasWindow() { return window != NULL; }
+
+private:
+	enum State
+	{
+		StreamHeader,
+		GzipFlags,
+		GzipHeader,
+		BlockHeader,
+		StoredHeader,
+		StoredCopy,
+		TableHeader,
+		CodeLengthCodes,
+		CodeLengths,
+		LengthSymbol,
+		DistanceSymbol,
+		CopyMatch,
+		Trailer,
+		Finished,
+		Failed
+	};
+
+	struct Huffman
+	{
+		uint16_t count[INFLATE_MAX_CODE_BITS + 1];
+		uint16_t* symbol;
+	};
+
+	Inflater();
+	bool AllocateWindow();
+
+	bool Step();
+	bool Fail();
+	void EndBlock();
+
+	void FillBits();
+	bool NeedBits(uint8_t count);
+	uint16_t Bits(uint8_t count) { return (uint16_t)(bitBuffer & ((1ul << count) - 1)); }
+	void DropBits(uint8_t count) { bitBuffer >>= count; bitCount -= count; }
+	int ReadByte();
+
+	int PeekSymbol(const Huffman& huffman, uint8_t& codeBits);
+	static int BuildHuffman(Huffman& huffman, const uint8_t* lengths, int numSymbols);
+	void BuildFixedTables();
+
+	void PutByte(uint8_t value);
+	void FlushToHistory();
+	uint8_t* MapHistory(uint16_t position);
+
+	State state;
+
+	uint8_t input[INFLATE_INPUT_BUFFER_SIZE];
+	size_t inputPos;
+	size_t inputLength;
+
+	uint32_t bitBuffer;
+	uint8_t bitCount;
+
+	uint8_t* out;
+	uint8_t* outEnd;
+
+	uint8_t gzipFlags;
+	uint16_t skipBytes;
+	uint8_t trailerLength;
+	bool isLastBlock;
+
+	uint16_t storedRemaining;
+	uint16_t matchLength;
+	uint16_t matchDistance;
+
+	int literalCodeCount;
+	int distanceCodeCount;
+	int codeLengthCodeCount;
+	int codeIndex;
+	uint8_t lengths[INFLATE_MAX_LITERAL_CODES + INFLATE_MAX_DISTANCE_CODES];
+
+	Huffman literalCode;
+	Huffman distanceCode;
+	uint16_t literalSymbols[INFLATE_MAX_LITERAL_CODES];
+	uint16_t distanceSymbols[INFLATE_MAX_DISTANCE_CODES];
+
+	// Ring buffer of the most recent output
+	uint8_t* window;
+	uint16_t windowSize;
+	uint16_t windowMask;
+	uint32_t outputPosition;
+
+	// Full 32K of output when the window is bounded
+	bool hasHistory;
+	MemBlockHandle historyBlocks[INFLATE_HISTORY_BLOCKS];
+
+	static uint8_t* sharedWindow;
+	static Inflater* sharedWindowOwner;
+};
+
+#endif
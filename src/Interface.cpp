@@ -259,7 +259,7 @@ void AppInterface::Update()
 
 		case 'm':
 		{
-			char tempMessage[100];
+			char tempMessage[MEMORY_REPORT_MAX_LENGTH];
 			MemoryManager::GenerateMemoryReport(tempMessage);
 			SetStatusMessage(tempMessage, StatusBarNode::GeneralStatus);
 		}
@@ -515,8 +515,7 @@ void AppInterface::SetTitle(const char* title)
 	strncpy(prevTitleBuffer, titleBuffer, MAX_TITLE_LENGTH);
 	strncpy(titleBuffer, title, MAX_TITLE_LENGTH);
 	titleBuffer[MAX_TITLE_LENGTH - 1] = '\0';
-	Font* font = titleNode->GetStyleFont();
-	int titleWidth = font->CalculateWidth(titleBuffer, titleNode->GetStyle().fontStyle);
+	int titleWidth = titleNode->GetResolvedStyle().CalculateWidth(titleBuffer);
 	titleNode->anchor.x = Platform::video->screenWidth / 2 - titleWidth / 2;
 	if (titleNode->anchor.x < 0)
 	{
@@ -5,9 +5,12 @@
 #include "App.h"
 #include "Render.h"
 #include "Nodes/ImgNode.h"
+#include "Nodes/Table.h"
+#include "Nodes/Block.h"
+#include "Nodes/Text.h"
 
 Layout::Layout(Page& inPage)
-	: page(inPage), cursorStack(MemoryManager::pageAllocator), paramStack(MemoryManager::pageAllocator)
+	: page(inPage), cursorStack(MemoryManager::pageAllocator), paramStack(MemoryManager::pageAllocator), resizedImages(nullptr), freeNodeListEntries(nullptr)
 {
 }
 
@@ -17,11 +20,14 @@ void Layout::Reset()
 	cursorStack.Reset();
 	currentLineHeight = 0;
 	lineStartNode = nullptr;
+	lineStartTextLine = 0;
 	lastNodeContext = nullptr;
 	currentNodeToProcess = nullptr;
 	Cursor().Clear();
 	tableDepth = 0;
 	isFinished = false;
+	resizedImages = nullptr;
+	freeNodeListEntries = nullptr;
 
 	LayoutParams& params = GetParams();
 	params.marginLeft = 0;
@@ -33,21 +39,6 @@ void Layout::Update()
 	while (currentNodeToProcess && currentNodeToProcess != lastNodeToProcess)
 	{
 		currentNodeToProcess->Handler().BeginLayoutContext(*this, currentNodeToProcess);
-
-		if (currentNodeToProcess->type == Node::Image && App::config.loadImages)
-		{
-			ImageNode::Data* imageData = static_cast<ImageNode::Data*>(currentNodeToProcess->data);
-			if (!imageData->HasDimensions())
-			{
-				// Waiting to first determine image size
-				if (!App::Get().pageContentLoadTask.IsBusy())
-				{
-					App::Get().LoadImageNodeContent(currentNodeToProcess);
-				}
-				return;
-			}
-		}
-
 		currentNodeToProcess->Handler().GenerateLayout(*this, currentNodeToProcess);
 
 		if (currentNodeToProcess->firstChild)
@@ -94,6 +85,11 @@ void Layout::Update()
 
 	}
 
+	if (resizedImages)
+	{
+		ReflowResizedImages();
+	}
+
 	if (!isFinished && App::Get().parser.IsFinished() && !currentNodeToProcess)
 	{
 		if (!MemoryManager::pageAllocator.GetError())
@@ -101,11 +97,425 @@ void Layout::Update()
 			page.GetApp().pageRenderer.MarkPageLayoutComplete();
 		}
 
-		// Layout has finished so now we can load image content
-		App::Get().LoadImageNodeContent(page.GetRootNode());
-		page.GetApp().ui.SetStatusMessage("Loading images...", StatusBarNode::GeneralStatus);
-		isFinished = true;
+		// Image content can only be loaded once every image has its final size
+		if (!App::Get().IsProbingImages() && !resizedImages)
+		{
+			App::Get().LoadImageNodeContent(page.GetRootNode());
+			page.GetApp().ui.SetStatusMessage("Loading images...", StatusBarNode::GeneralStatus);
+			isFinished = true;
+		}
+	}
+}
+
+NodeListEntry* Layout::AllocateNodeListEntry(Node* node)
+{
+	NodeListEntry* entry = freeNodeListEntries;
+	if (entry)
+	{
+		freeNodeListEntries = entry->next;
 	}
+	else
+	{
+		entry = MemoryManager::pageAllocator.Alloc<NodeListEntry>();
+		if (!entry)
+		{
+			return nullptr;
+		}
+	}
+	entry->node = node;
+	entry->next = nullptr;
+	return entry;
+}
+
+void Layout::FreeNodeList(NodeListEntry* list)
+{
+	while (list)
+	{
+		NodeListEntry* next = list->next;
+		list->next = freeNodeListEntries;
+		freeNodeListEntries = list;
+		list = next;
+	}
+}
+
+bool Layout::AddUniqueNode(NodeListEntry*& list, Node* node)
+{
+	for (NodeListEntry* entry = list; entry; entry = entry->next)
+	{
+		if (entry->node == node)
+		{
+			return true;
+		}
+	}
+
+	NodeListEntry* entry = AllocateNodeListEntry(node);
+	if (!entry)
+	{
+		return false;
+	}
+	entry->next = list;
+	list = entry;
+	return true;
+}
+
+void Layout::MarkImageSizeChanged(Node* node)
+{
+	AddUniqueNode(resizedImages, node);
+}
+
+void Layout::ReflowResizedImages()
+{
+	App& app = page.GetApp();
+	bool isPageComplete = app.parser.IsFinished() && !currentNodeToProcess;
+	bool isProbing = app.IsProbingImages();
+	int visibleBottom = app.ui.GetScrollPositionY() + app.ui.windowRect.height;
+
+	NodeListEntry* dirtyBlocks = nullptr;
+	NodeListEntry* dirtyTables = nullptr;
+	bool needsPageRelayout = false;
+
+	// Only the queued images are looked at. Ones that can't be reflowed yet stay queued
+	NodeListEntry** link = &resizedImages;
+	while (NodeListEntry* entry = *link)
+	{
+		Node* node = entry->node;
+		bool isFinishedWith = true;
+
+		Node* tableNode = nullptr;
+		for (Node* parent = node->parent; parent; parent = parent->parent)
+		{
+			if (parent->type == Node::Table)
+			{
+				tableNode = parent;
+			}
+		}
+
+		ImageNode::Data* data = static_cast<ImageNode::Data*>(node->data);
+		if (data->state == ImageNode::ProbedDimensions)
+		{
+			// A table still being generated has to finish first so that its columns are sized consistently
+			if (tableNode && !tableNode->isLayoutComplete)
+			{
+				isFinishedWith = false;
+			}
+			else
+			{
+				ImageNode::ApplyProbedDimensions(node);
+			}
+		}
+
+		if (isFinishedWith && ImageNode::HasLayoutSizeChanged(node))
+		{
+			// Changes offscreen are batched up while there are still probes in flight
+			bool isDeferred = isProbing && node->anchor.y >= visibleBottom;
+
+			if (tableNode && tableNode->isLayoutComplete && !isDeferred)
+			{
+				// A table holding several changed images is only reflowed once
+				isFinishedWith = AddUniqueNode(dirtyTables, tableNode);
+			}
+			else if (!tableNode && isPageComplete && !isDeferred)
+			{
+				// Inline content outside of a table can affect everything after it. The blocks around
+				// each changed image are laid out again once they have all been found
+				Node* blockNode = FindRelayoutBlock(node);
+				if (blockNode)
+				{
+					AddDirtyBlock(dirtyBlocks, blockNode);
+				}
+				else
+				{
+					needsPageRelayout = true;
+				}
+			}
+			else
+			{
+				isFinishedWith = false;
+			}
+		}
+
+		if (isFinishedWith)
+		{
+			*link = entry->next;
+			entry->next = nullptr;
+			FreeNodeList(entry);
+		}
+		else
+		{
+			link = &entry->next;
+		}
+	}
+
+	if (needsPageRelayout)
+	{
+		FreeNodeList(dirtyTables);
+		FreeNodeList(dirtyBlocks);
+		RelayoutPage();
+		return;
+	}
+
+	if (dirtyTables)
+	{
+		// Reflowing a table only moves what comes after it, so the topmost table is where the page starts to change
+		Node* topTable = dirtyTables->node;
+		for (NodeListEntry* entry = dirtyTables; entry; entry = entry->next)
+		{
+			if (entry->node->anchor.y < topTable->anchor.y)
+			{
+				topTable = entry->node;
+			}
+		}
+		for (NodeListEntry* entry = dirtyTables; entry; entry = entry->next)
+		{
+			ReflowTable(entry->node);
+		}
+		app.pageRenderer.OnPageLayoutChanged(topTable);
+		FreeNodeList(dirtyTables);
+	}
+
+	if (dirtyBlocks)
+	{
+		RelayoutDirtyBlocks(dirtyBlocks);
+		FreeNodeList(dirtyBlocks);
+	}
+}
+
+void Layout::ReflowTable(Node* tableNode)
+{
+	TableNode::Data* data = static_cast<TableNode::Data*>(tableNode->data);
+	int oldBottom = tableNode->anchor.y + tableNode->size.y;
+
+	Node* savedLineStartNode = lineStartNode;
+	int savedLineStartTextLine = lineStartTextLine;
+	Node* savedLastNodeContext = lastNodeContext;
+	int savedLineHeight = currentLineHeight;
+	int savedTableDepth = tableDepth;
+
+	// Recreate the state the table was originally laid out in
+	PushCursor();
+	PushLayout();
+	Cursor().x = data->layoutMarginLeft;
+	Cursor().y = tableNode->anchor.y;
+	GetParams().marginLeft = data->layoutMarginLeft;
+	GetParams().marginRight = data->layoutMarginRight;
+	lineStartNode = nullptr;
+	currentLineHeight = 0;
+	tableDepth = 0;
+
+	RecalculateLayoutForNode(tableNode);
+
+	PopLayout();
+	PopCursor();
+	lineStartNode = savedLineStartNode;
+	lineStartTextLine = savedLineStartTextLine;
+	lastNodeContext = savedLastNodeContext;
+	currentLineHeight = savedLineHeight;
+	tableDepth = savedTableDepth;
+
+	int deltaY = tableNode->anchor.y + tableNode->size.y - oldBottom;
+	if (deltaY)
+	{
+		// Shift everything after the table, including where layout will continue from
+		Node* next = tableNode;
+		while (next && !next->next)
+		{
+			next = next->parent;
+		}
+		if (next)
+		{
+			TranslateNodes(next->next, 0, nullptr, 0, deltaY);
+		}
+
+		for (Node* parent = tableNode->parent; parent; parent = parent->parent)
+		{
+			if (parent->size.y && parent->anchor.y + parent->size.y >= oldBottom)
+			{
+				parent->size.y += deltaY;
+			}
+		}
+
+		for (Stack<Coord>::Entry* entry = cursorStack.top; entry; entry = entry->prev)
+		{
+			entry->obj.y += deltaY;
+		}
+	}
+}
+
+Node* Layout::FindRelayoutBlock(Node* node)
+{
+	Node* result = nullptr;
+
+	for (Node* parent = node->parent; parent; parent = parent->parent)
+	{
+		if (parent->type == Node::Table)
+		{
+			// Table sizes depend on all of their contents, see ReflowTable
+			return nullptr;
+		}
+		if (parent->type == Node::Block && !result)
+		{
+			result = parent;
+		}
+	}
+
+	return result;
+}
+
+// Blocks start and end on a new line, so only the height of what is inside them affects the
+// layout of anything after them
+void Layout::RelayoutBlock(Node* blockNode, int top)
+{
+	BlockNode::Data* data = static_cast<BlockNode::Data*>(blockNode->data);
+
+	Node* savedLineStartNode = lineStartNode;
+	int savedLineStartTextLine = lineStartTextLine;
+	Node* savedLastNodeContext = lastNodeContext;
+	int savedLineHeight = currentLineHeight;
+	int savedTableDepth = tableDepth;
+
+	// Recreate the state the block was originally laid out in
+	PushCursor();
+	PushLayout();
+	Cursor().x = data->layoutMarginLeft;
+	Cursor().y = top;
+	GetParams().marginLeft = data->layoutMarginLeft;
+	GetParams().marginRight = data->layoutMarginRight;
+	lineStartNode = nullptr;
+	currentLineHeight = 0;
+	tableDepth = 0;
+
+	RecalculateLayoutForNode(blockNode);
+
+	PopLayout();
+	PopCursor();
+	lineStartNode = savedLineStartNode;
+	lineStartTextLine = savedLineStartTextLine;
+	lastNodeContext = savedLastNodeContext;
+	currentLineHeight = savedLineHeight;
+	tableDepth = savedTableDepth;
+}
+
+// Blocks are kept in page order, with a block before any block inside it
+void Layout::AddDirtyBlock(NodeListEntry*& blocks, Node* blockNode)
+{
+	if (blockNode->isLayoutDirty)
+	{
+		return;
+	}
+
+	NodeListEntry* entry = AllocateNodeListEntry(blockNode);
+	if (!entry)
+	{
+		return;
+	}
+	blockNode->isLayoutDirty = true;
+
+	NodeListEntry** link = &blocks;
+	while (*link && ((*link)->node->anchor.y < blockNode->anchor.y || ((*link)->node->anchor.y == blockNode->anchor.y && blockNode->IsChildOf((*link)->node))))
+	{
+		link = &(*link)->next;
+	}
+	entry->next = *link;
+	*link = entry;
+}
+
+void Layout::RelayoutDirtyBlocks(NodeListEntry* blocks)
+{
+	// Whatever is between the blocks only needs moving down by the change in height of the blocks above it
+	int deltaY = 0;
+	int changedBottom = 0;
+	Node* changedNode = nullptr;
+	Node* moveStart = nullptr;
+
+	for (NodeListEntry* entry = blocks; entry; entry = entry->next)
+	{
+		Node* node = entry->node;
+
+		if (!node->isLayoutDirty)
+		{
+			// Already laid out again as part of a block around it
+			continue;
+		}
+
+		if (deltaY && moveStart && moveStart != node)
+		{
+			TranslateNodes(moveStart, 0, node->GetPreviousInTree(), 0, deltaY);
+		}
+
+		int top = node->anchor.y + deltaY;
+		int oldBottom = top + node->size.y;
+
+		RelayoutBlock(node, top);
+
+		int newBottom = node->anchor.y + node->size.y;
+
+		for (Node* parent = node->parent; parent; parent = parent->parent)
+		{
+			if (parent->size.y && parent->anchor.y + parent->size.y >= oldBottom)
+			{
+				parent->size.y += newBottom - oldBottom;
+			}
+		}
+
+		if (!changedNode)
+		{
+			changedNode = node;
+		}
+		if (oldBottom > changedBottom)
+		{
+			changedBottom = oldBottom;
+		}
+		if (newBottom > changedBottom)
+		{
+			changedBottom = newBottom;
+		}
+		deltaY += newBottom - oldBottom;
+
+		// Carry on after the block
+		moveStart = node;
+		while (moveStart && !moveStart->next)
+		{
+			moveStart = moveStart->parent;
+		}
+		moveStart = moveStart ? moveStart->next : nullptr;
+	}
+
+	if (deltaY)
+	{
+		if (moveStart)
+		{
+			TranslateNodes(moveStart, 0, nullptr, 0, deltaY);
+		}
+
+		for (Stack<Coord>::Entry* entry = cursorStack.top; entry; entry = entry->prev)
+		{
+			entry->obj.y += deltaY;
+		}
+
+		// Everything below the first block has moved
+		changedBottom = INT_MAX;
+	}
+
+	if (changedNode)
+	{
+		page.GetApp().pageRenderer.OnPageLayoutChanged(changedNode, changedBottom);
+	}
+}
+
+void Layout::RelayoutPage()
+{
+	bool wasFinished = isFinished;
+
+	// Everything is laid out again, so nothing is left waiting to be reflowed
+	FreeNodeList(resizedImages);
+	NodeListEntry* freeEntries = freeNodeListEntries;
+
+	Reset();
+	freeNodeListEntries = freeEntries;
+	RecalculateLayoutForNode(page.GetRootNode());
+
+	isFinished = wasFinished;
+	page.GetApp().pageRenderer.OnPageLayoutChanged(page.GetRootNode());
 }
 
 void Layout::BreakNewLine()
@@ -122,12 +532,12 @@ void Layout::BreakNewLine()
 		if (lineStartNode->GetStyle().alignment == ElementAlignment::Center)
 		{
 			int shift = AvailableWidth() / 2;
-			TranslateNodes(lineStartNode, lastNodeContext, shift, 0);
+			TranslateNodes(lineStartNode, lineStartTextLine, lastNodeContext, shift, 0);
 		}
 		else if (lineStartNode->GetStyle().alignment == ElementAlignment::Right)
 		{
 			int shift = AvailableWidth();
-			TranslateNodes(lineStartNode, lastNodeContext, shift, 0);
+			TranslateNodes(lineStartNode, lineStartTextLine, lastNodeContext, shift, 0);
 		}
 	}
 
@@ -142,7 +552,7 @@ void Layout::BreakNewLine()
 	lineStartNode = nullptr;
 }
 
-void Layout::ProgressCursor(Node* nodeContext, int width, int lineHeight)
+void Layout::ProgressCursor(Node* nodeContext, int width, int lineHeight, int textLine)
 {
 	// Horrible hack to add padding / spacing between nodes. FIXME
 	if (width)
@@ -153,6 +563,7 @@ void Layout::ProgressCursor(Node* nodeContext, int width, int lineHeight)
 	if (!lineStartNode)
 	{
 		lineStartNode = nodeContext;
+		lineStartTextLine = textLine;
 	}
 
 	lastNodeContext = nodeContext;
@@ -162,19 +573,27 @@ void Layout::ProgressCursor(Node* nodeContext, int width, int lineHeight)
 		// Line height has increased so move everything down accordingly
 		int deltaY = lineHeight - currentLineHeight;
 //		TranslateNodes(lineStartNode, 0, deltaY, true);
-		TranslateNodes(lineStartNode, nodeContext, 0, deltaY);
+		TranslateNodes(lineStartNode, lineStartTextLine, nodeContext, 0, deltaY);
 		currentLineHeight = lineHeight;
 	}
 
 	Cursor().x += width;
 }
 
-void Layout::TranslateNodes(Node* start, Node* end, int deltaX, int deltaY)
+void Layout::TranslateNodes(Node* start, int startTextLine, Node* end, int deltaX, int deltaY)
 {
 	for (Node* node = start; node; node = node->GetNextInTree())
 	{
-		node->anchor.x += deltaX;
-		node->anchor.y += deltaY;
+		if (node->type == Node::Text)
+		{
+			// The line may begin part way through wrapped text, so only the lines from there on move
+			TextElement::TranslateLines(node, node == start ? startTextLine : 0, deltaX, deltaY);
+		}
+		else
+		{
+			node->anchor.x += deltaX;
+			node->anchor.y += deltaY;
+		}
 
 		if (node == end)
 		{
@@ -238,6 +657,7 @@ void Layout::PadVertical(int down)
 
 void Layout::RecalculateLayoutForNode(Node* targetNode)
 {
+	targetNode->isLayoutDirty = false;
 	targetNode->Handler().BeginLayoutContext(*this, targetNode);
 	targetNode->Handler().GenerateLayout(*this, targetNode);
 
@@ -11,6 +11,12 @@ struct LayoutParams
 	int marginLeft, marginRight;
 };
 
+struct NodeListEntry
+{
+	Node* node;
+	NodeListEntry* next;
+};
+
 class Layout
 {
 public:
@@ -33,11 +39,24 @@ public:
 
 	void OnNodeEmitted(Node* node);
 	void MarkParsingComplete();
-	void ProgressCursor(Node* nodeContext, int width, int lineHeight);
+	void ProgressCursor(Node* nodeContext, int width, int lineHeight, int textLine = 0);
 
 	void RecalculateLayout();
 	void RecalculateLayoutForNode(Node* node);
 
+	// Images are laid out at a placeholder size until their dimensions are probed. Images that may
+	// have changed size are queued until they can be reflowed, see ReflowResizedImages
+	void MarkImageSizeChanged(Node* node);
+	bool HasResizedImages() { return resizedImages != nullptr; }
+	void ReflowResizedImages();
+	void ReflowTable(Node* tableNode);
+	void RelayoutPage();
+
+	// Lays out again only the blocks in the list, which are flagged with isLayoutDirty, moving everything after them
+	void RelayoutDirtyBlocks(NodeListEntry* blocks);
+	Node* FindRelayoutBlock(Node* node);
+	void RelayoutBlock(Node* blockNode, int top);
+
 	int CalculateWidth(ExplicitDimension explicitWidth);
 	int CalculateHeight(ExplicitDimension explicitHeight);
 
@@ -54,6 +73,7 @@ public:
 	bool IsFinished() { return isFinished; }
 
 	Node* lineStartNode;
+	int lineStartTextLine;		// Wrapped line of lineStartNode that the current line begins with
 	Node* lastNodeContext;
 
 	Node* currentNodeToProcess;
@@ -73,9 +93,19 @@ public:
 
 	Stack<LayoutParams> paramStack;
 
-	void TranslateNodes(Node* start, Node* end, int deltaX, int deltaY);
+	void TranslateNodes(Node* start, int startTextLine, Node* end, int deltaX, int deltaY);
 
 	bool isFinished;
+
+private:
+	// Entries come from the page allocator and are kept for reuse once finished with
+	NodeListEntry* AllocateNodeListEntry(Node* node);
+	void FreeNodeList(NodeListEntry* list);
+	bool AddUniqueNode(NodeListEntry*& list, Node* node);		// Returns false if there was no room to add it
+	void AddDirtyBlock(NodeListEntry*& blocks, Node* blockNode);
+
+	NodeListEntry* resizedImages;
+	NodeListEntry* freeNodeListEntries;
 };
 
 /*
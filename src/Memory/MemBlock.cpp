@@ -52,6 +52,7 @@ MemBlockAllocator::MemBlockAllocator()
 	, swapBuffer(nullptr)
 	, lastSwapRead(-1)
 	, maxSwapSize(0)
+	, reclaimHandler(nullptr)
 {
 }
 
@@ -102,6 +103,51 @@ MemBlockHandle MemBlockAllocator::AllocString(const char* inString)
 	return result;
 }
 
+MemBlockHandle MemBlockAllocator::AllocatePersistent(uint16_t size)
+{
+#ifdef __DOS__
+	if (ems.IsAvailable())
+	{
+		return ems.AllocatePersistent(size);
+	}
+#endif
+	return MemBlockHandle();
+}
+
+bool MemBlockAllocator::FreePersistent(MemBlockHandle& handle)
+{
+#ifdef __DOS__
+	if (ems.IsAvailable() && ems.FreePersistent(handle))
+	{
+		handle = MemBlockHandle();
+		return true;
+	}
+#endif
+	return false;
+}
+
+long MemBlockAllocator::PersistentPoolSize()
+{
+#ifdef __DOS__
+	if (ems.IsAvailable())
+	{
+		return ems.TotalAllocated();
+	}
+#endif
+	return 0;
+}
+
+long MemBlockAllocator::PersistentPoolFree()
+{
+#ifdef __DOS__
+	if (ems.IsAvailable())
+	{
+		return ems.TotalAllocated() - ems.TotalUsed();
+	}
+#endif
+	return 0;
+}
+
 MemBlockHandle MemBlockAllocator::Allocate(uint16_t size)
 {
 	MemBlockHandle result;
@@ -111,6 +157,10 @@ MemBlockHandle MemBlockAllocator::Allocate(uint16_t size)
 	if (ems.IsAvailable())
 	{
 		result = ems.Allocate(size);
+		while (!result.IsAllocated() && reclaimHandler && reclaimHandler())
+		{
+			result = ems.Allocate(size);
+		}
 		if (result.IsAllocated())
 		{
 			totalAllocated += size;
@@ -123,7 +173,7 @@ MemBlockHandle MemBlockAllocator::Allocate(uint16_t size)
 	
 	conventionalMemoryAvailable += MemoryManager::pageAllocator.TotalAllocated() - MemoryManager::pageAllocator.TotalUsed();
 
-	if (swapFile && conventionalMemoryAvailable < 16 * 1024)	// If we have less than 16K available, fall back to disk
+	if (swapFile && conventionalMemoryAvailable < LOW_MEMORY_THRESHOLD)	// If we have less than 16K available, fall back to disk
 	{
 		uint16_t sizeNeededForSwap = size + sizeof(uint16_t);
 
@@ -167,6 +217,31 @@ MemBlockHandle MemBlockAllocator::Allocate(uint16_t size)
 	return result;
 }
 
+bool MemBlockAllocator::IsMemoryLow()
+{
+	if (MemoryManager::pageAllocator.GetError() == LinearAllocator::Error_OutOfMemory)
+	{
+		return true;
+	}
+
+#ifdef __DOS__
+	if (ems.IsAvailable() && ems.TotalAllocated() - ems.TotalUsed() >= LOW_MEMORY_THRESHOLD)
+	{
+		return false;
+	}
+
+	if (swapFile && swapFileLength + LOW_MEMORY_THRESHOLD < maxSwapSize)
+	{
+		return false;
+	}
+
+	return _memmax() + MemoryManager::pageAllocator.TotalAllocated() - MemoryManager::pageAllocator.TotalUsed() < LOW_MEMORY_THRESHOLD;
+#else
+	// Page chunks come from the heap as needed, so memory only runs short once an allocation fails
+	return false;
+#endif
+}
+
 void* MemBlockAllocator::AccessSwap(MemBlockHandle& handle)
 {
 	if (swapFile && lastSwapRead != handle.swapFilePosition)
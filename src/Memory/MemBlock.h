@@ -46,6 +46,8 @@ struct  MemBlockHandle
 };
 #pragma pack(pop)
 
+#define LOW_MEMORY_THRESHOLD (16 * 1024l)
+
 class LinearAllocator;
 
 class MemBlockAllocator
@@ -59,8 +61,28 @@ public:
 	MemBlockHandle Allocate(uint16_t size);
 	MemBlockHandle AllocString(const char* inString);
 
+	// Blocks that are kept across Reset(). These only come from EMS, otherwise unallocated is returned
+	MemBlockHandle AllocatePersistent(uint16_t size);
+
+	// Persistent blocks are taken off a stack, so only the most recently allocated one can be given
+	// back. Returns false, leaving the block allocated, for any other
+	bool FreePersistent(MemBlockHandle& handle);
+
+	// EMS shared by the page and persistent blocks, and how much of it the page hasn't used yet. Both are 0 without EMS
+	long PersistentPoolSize();
+	long PersistentPoolFree();
+
+	// Called when EMS runs out for the page, to give persistent blocks back. Returns true if one was freed
+	void SetReclaimHandler(bool (*handler)()) { reclaimHandler = handler; }
+
 	long TotalAllocated() { return totalAllocated; }
 
+	// Conventional memory is nearly used up and EMS and the swap file can't take up the slack either
+	bool IsMemoryLow();
+
+	// Larger blocks can't fall back to the swap file when conventional memory runs out
+	uint16_t MaxBlockSize() { return swapFile ? MAX_SWAP_ALLOCATION - sizeof(uint16_t) : 0xffff; }
+
 	void Reset();
 
 private:
@@ -74,6 +96,7 @@ private:
 	long lastSwapRead;
 	long maxSwapSize;
 	long totalAllocated;
+	bool (*reclaimHandler)();
 };
 
 
@@ -1,6 +1,7 @@
 #include <string.h>
 #include <malloc.h>
 #include "Memory.h"
+#include "../Style.h"
 #ifdef _DOS
 #include <dos.h>
 #include "../DOS/EMS.h"
@@ -23,7 +24,7 @@ void MemoryManager::GenerateMemoryReport(char* outString)
 	int EMSallocated = ems.TotalAllocated() / 1024;
 	int EMSused = ems.TotalUsed() / 1024;
 	int DOSavailable = _memmax() / 1024;
-	snprintf(outString, 100, "Conv: Alloc: %dK Used: %dK DOS free: %dK EMS: Alloc: %dK Used: %dK Block: %dK Err: %d\n", 
+	snprintf(outString, MEMORY_REPORT_MAX_LENGTH, "Conv: Alloc: %dK Used: %dK DOS free: %dK EMS: Alloc: %dK Used: %dK Block: %dK Err: %d ", 
 			(int)(MemoryManager::pageAllocator.TotalAllocated() / 1024), 
 			(int)(MemoryManager::pageAllocator.TotalUsed() / 1024), 
 			DOSavailable, 
@@ -32,10 +33,17 @@ void MemoryManager::GenerateMemoryReport(char* outString)
 			(int)(MemoryManager::pageBlockAllocator.TotalAllocated() / 1024),
 			MemoryManager::pageAllocator.GetError());
 #else
-	snprintf(outString, 100, "Conv: Alloc: %dK Used: %dK Block allocation: %dK\n", 
+	snprintf(outString, MEMORY_REPORT_MAX_LENGTH, "Conv: Alloc: %dK Used: %dK Block allocation: %dK ", 
 			(int)(MemoryManager::pageAllocator.TotalAllocated() / 1024), 
 			(int)(MemoryManager::pageAllocator.TotalUsed() / 1024),
 			(int)(MemoryManager::pageBlockAllocator.TotalAllocated() / 1024));
 #endif
 
+	StylePool& stylePool = StylePool::Get();
+	int length = strlen(outString);
+	snprintf(outString + length, MEMORY_REPORT_MAX_LENGTH - length, "Styles: %d/%d Hit: %ld Miss: %ld\n",
+			stylePool.NumStyles(),
+			MAX_STYLES,
+			stylePool.NumHits(),
+			stylePool.NumMisses());
 }
@@ -5,6 +5,8 @@
 #include "LinAlloc.h"
 #include "MemBlock.h"
 
+#define MEMORY_REPORT_MAX_LENGTH 160
+
 class MemoryManager
 {
 public:
@@ -24,7 +24,6 @@ NodeHandler* Node::nodeHandlers[Node::NumNodeTypes] =
 {
 	new SectionElement(),
 	new TextElement(),
-	new SubTextElement(),
 	new ImageNode(),
 	new BreakNode(),
 	new StyleNode(),
@@ -48,6 +47,7 @@ NodeHandler* Node::nodeHandlers[Node::NumNodeTypes] =
 Node::Node(Type inType, void* inData)
 	: type(inType)
 	, isLayoutComplete(false)
+	, isLayoutDirty(false)
 	, parent(nullptr)
 	, next(nullptr)
 	, firstChild(nullptr)
@@ -164,7 +164,7 @@ bool Node::IsPointInsideChildren(int x, int y)
 
 	if (firstChild == nullptr)
 	{
-		return IsPointInsideNode(x, y);
+		return Handler().IsPointInside(this, x, y);
 	}
 
 	for (Node* it = firstChild; it; it = it->next)
@@ -213,6 +213,11 @@ void NodeHandler::EndLayoutContext(Layout& layout, Node* node)
 {
 }
 
+bool NodeHandler::IsPointInside(Node* node, int x, int y)
+{
+	return node->IsPointInsideNode(x, y);
+}
+
 Node* Node::FindParentOfType(Node::Type searchType)
 {
 	for(Node* node = parent; node; node = node->parent)
@@ -347,8 +352,12 @@ void Node::SetStyle(const ElementStyle& style)
 	}
 }
 
+const ResolvedStyle& Node::GetResolvedStyle()
+{
+	return StylePool::Get().GetResolvedStyle(styleHandle);
+}
+
 Font* Node::GetStyleFont()
 {
-	const ElementStyle& style = GetStyle();
-	return Assets.GetFont(style.fontSize, style.fontStyle);
+	return GetResolvedStyle().font;
 }
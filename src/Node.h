@@ -23,6 +23,7 @@ public:
 	virtual void EndLayoutContext(Layout& layout, Node* node);
 	virtual void ApplyStyle(Node* node) {}
 	virtual Node* Pick(Node* node, int x, int y);
+	virtual bool IsPointInside(Node* node, int x, int y);
 	virtual bool CanPick(Node* node) { return false; }
 	virtual bool HandleEvent(Node* node, const Event& event) { return false; }
 
@@ -70,7 +71,6 @@ public:
 	{
 		Section,
 		Text,
-		SubText,
 		Image,
 		Break,
 		Style,
@@ -118,6 +118,7 @@ public:
 
 	const ElementStyle& GetStyle();
 	void SetStyle(const ElementStyle& style);
+	const ResolvedStyle& GetResolvedStyle();
 	Font* GetStyleFont();
 
 	void Redraw();
@@ -126,8 +127,9 @@ public:
 	Node* GetNextInTree();
 
 	ElementStyleHandle styleHandle;
-	Type type : 7;
+	Type type : 6;
 	bool isLayoutComplete : 1;
+	bool isLayoutDirty : 1;		// Queued to be laid out again, see Layout::RelayoutDirtyBlocks
 
 	Coord anchor;				// Top left page position
 	Coord size;					// Rectangle size that encapsulates node and its children
@@ -0,0 +1,432 @@
+//
+// Copyright (C) 2021 James Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+
+#include "NodeIndex.h"
+#include "Node.h"
+#include "Memory/Memory.h"
+#include <limits.h>
+
+static int16_t ClampExtent(int value)
+{
+	if (value > SHRT_MAX)
+		return SHRT_MAX;
+	if (value < SHRT_MIN)
+		return SHRT_MIN;
+	return (int16_t)value;
+}
+
+NodeIndex::NodeIndex()
+{
+	Reset();
+}
+
+void NodeIndex::Reset()
+{
+	// Blocks come from the page allocator so are released along with the page
+	root = nullptr;
+	firstLeaf = nullptr;
+	lastLeaf = nullptr;
+	numOpenNodes = 0;
+	numNodes = 0;
+	hasFailed = false;
+}
+
+NodeIndex::Block* NodeIndex::AllocateBlock(bool isLeaf)
+{
+	Block* block = MemoryManager::pageAllocator.Alloc<Block>();
+	if (block)
+	{
+		block->parent = nullptr;
+		block->nextLeaf = nullptr;
+		block->leafNumber = 0;
+		block->top = SHRT_MAX;
+		block->bottom = SHRT_MIN;
+		block->openMask = 0;
+		block->count = 0;
+		block->isLeaf = isLeaf;
+	}
+	return block;
+}
+
+bool NodeIndex::AppendLeaf(Block* leaf)
+{
+	if (!root)
+	{
+		root = firstLeaf = lastLeaf = leaf;
+		return true;
+	}
+
+	// Attach to the rightmost block on each level, growing the tree upwards when the root is full
+	Block* child = leaf;
+	Block* sibling = lastLeaf;
+
+	while (true)
+	{
+		Block* parent = sibling->parent;
+
+		if (!parent)
+		{
+			parent = AllocateBlock(false);
+			if (!parent)
+			{
+				return false;
+			}
+			parent->children[parent->count++] = sibling;
+			parent->top = sibling->top;
+			parent->bottom = sibling->bottom;
+			sibling->parent = parent;
+			root = parent;
+		}
+
+		if (parent->count < NODE_INDEX_BRANCHING)
+		{
+			parent->children[parent->count++] = child;
+			child->parent = parent;
+			break;
+		}
+
+		Block* newParent = AllocateBlock(false);
+		if (!newParent)
+		{
+			return false;
+		}
+		newParent->children[newParent->count++] = child;
+		child->parent = newParent;
+
+		child = newParent;
+		sibling = parent;
+	}
+
+	leaf->leafNumber = lastLeaf->leafNumber + 1;
+	lastLeaf->nextLeaf = leaf;
+	lastLeaf = leaf;
+	return true;
+}
+
+long NodeIndex::Add(Node* node)
+{
+	// Positions keep counting even if the index has failed so that they still match tree order
+	long position = numNodes++;
+
+	if (hasFailed)
+	{
+		return position;
+	}
+
+	// Anything still open that this node isn't inside of has finished its layout
+	while (numOpenNodes)
+	{
+		OpenNode& open = openNodes[numOpenNodes - 1];
+		if (node->IsChildOf(open.leaf->nodes[open.index]))
+		{
+			break;
+		}
+		CloseTop();
+	}
+
+	Block* leaf = lastLeaf;
+	if (leaf && leaf->count == NODE_INDEX_BRANCHING && leaf->nextLeaf)
+	{
+		// Reuse a block left over from before the index was cleared
+		leaf = lastLeaf = leaf->nextLeaf;
+	}
+	else if (!leaf || leaf->count == NODE_INDEX_BRANCHING)
+	{
+		leaf = AllocateBlock(true);
+		if (!leaf || !AppendLeaf(leaf))
+		{
+			hasFailed = true;
+			return position;
+		}
+	}
+
+	uint8_t index = leaf->count++;
+	leaf->nodes[index] = node;
+
+	int16_t top = ClampExtent(node->anchor.y);
+	int16_t bottom = ClampExtent(node->anchor.y + node->size.y);
+
+	if (node->firstChild)
+	{
+		// Children are still being laid out so the size of this node isn't known yet
+		leaf->openMask |= (1u << index);
+		bottom = SHRT_MAX;
+
+		if (numOpenNodes < NODE_INDEX_MAX_OPEN_NODES)
+		{
+			openNodes[numOpenNodes].leaf = leaf;
+			openNodes[numOpenNodes].index = index;
+			numOpenNodes++;
+		}
+	}
+
+	for (Block* block = leaf; block; block = block->parent)
+	{
+		if (top < block->top)
+			block->top = top;
+		if (bottom > block->bottom)
+			block->bottom = bottom;
+	}
+
+	return position;
+}
+
+void NodeIndex::Close(Node* node)
+{
+	if (numOpenNodes)
+	{
+		OpenNode& open = openNodes[numOpenNodes - 1];
+		if (open.leaf->nodes[open.index] == node)
+		{
+			CloseTop();
+		}
+	}
+}
+
+void NodeIndex::CloseTop()
+{
+	numOpenNodes--;
+	OpenNode& open = openNodes[numOpenNodes];
+	open.leaf->openMask &= ~(1u << open.index);
+
+	for (Block* block = open.leaf; block; block = block->parent)
+	{
+		CalculateExtent(block);
+	}
+}
+
+void NodeIndex::CloseAll()
+{
+	numOpenNodes = 0;
+	if (root)
+	{
+		CloseBlock(root);
+	}
+}
+
+void NodeIndex::Clear()
+{
+	numOpenNodes = 0;
+	numNodes = 0;
+	lastLeaf = firstLeaf;
+	if (root)
+	{
+		ClearBlock(root);
+	}
+}
+
+bool NodeIndex::Truncate(Node* node)
+{
+	uint8_t index;
+	Block* leaf = (root && !hasFailed) ? FindInBlock(root, node, index) : nullptr;
+	if (!leaf)
+	{
+		return false;
+	}
+
+	numOpenNodes = 0;
+	numNodes = (long)leaf->leafNumber * NODE_INDEX_BRANCHING + index;
+	lastLeaf = leaf;
+	leaf->count = index;
+	leaf->openMask &= (1u << index) - 1;
+
+	// Blocks after the node are kept for reuse in the same way as Clear
+	for (Block* block = leaf; block; block = block->parent)
+	{
+		Block* parent = block->parent;
+		if (parent)
+		{
+			int n = parent->count - 1;
+			while (parent->children[n] != block)
+			{
+				ClearBlock(parent->children[n--]);
+			}
+		}
+		CalculateExtent(block);
+	}
+
+	// Containers of the node have their bottom unbounded again until what is inside them is added back
+	for (Node* parent = node->parent; parent; parent = parent->parent)
+	{
+		Block* parentLeaf = FindInBlock(root, parent, index);
+		if (!parentLeaf)
+		{
+			continue;
+		}
+
+		parentLeaf->openMask |= (1u << index);
+		for (Block* block = parentLeaf; block; block = block->parent)
+		{
+			block->bottom = SHRT_MAX;
+		}
+
+		if (numOpenNodes < NODE_INDEX_MAX_OPEN_NODES)
+		{
+			openNodes[numOpenNodes].leaf = parentLeaf;
+			openNodes[numOpenNodes].index = index;
+			numOpenNodes++;
+		}
+	}
+
+	// Found innermost first, but Add expects the innermost on top
+	for (int n = 0; n < numOpenNodes / 2; n++)
+	{
+		OpenNode swap = openNodes[n];
+		openNodes[n] = openNodes[numOpenNodes - 1 - n];
+		openNodes[numOpenNodes - 1 - n] = swap;
+	}
+
+	return true;
+}
+
+void NodeIndex::CalculateExtent(Block* block)
+{
+	int16_t top = SHRT_MAX;
+	int16_t bottom = SHRT_MIN;
+
+	for (int n = 0; n < block->count; n++)
+	{
+		int16_t childTop, childBottom;
+
+		if (block->isLeaf)
+		{
+			Node* node = block->nodes[n];
+			childTop = ClampExtent(node->anchor.y);
+			childBottom = (block->openMask & (1u << n)) ? SHRT_MAX : ClampExtent(node->anchor.y + node->size.y);
+		}
+		else
+		{
+			childTop = block->children[n]->top;
+			childBottom = block->children[n]->bottom;
+		}
+
+		if (childTop < top)
+			top = childTop;
+		if (childBottom > bottom)
+			bottom = childBottom;
+	}
+
+	block->top = top;
+	block->bottom = bottom;
+}
+
+void NodeIndex::CloseBlock(Block* block)
+{
+	if (block->isLeaf)
+	{
+		block->openMask = 0;
+	}
+	else
+	{
+		for (int n = 0; n < block->count; n++)
+		{
+			CloseBlock(block->children[n]);
+		}
+	}
+
+	CalculateExtent(block);
+}
+
+void NodeIndex::ClearBlock(Block* block)
+{
+	if (block->isLeaf)
+	{
+		block->count = 0;
+		block->openMask = 0;
+	}
+	else
+	{
+		for (int n = 0; n < block->count; n++)
+		{
+			ClearBlock(block->children[n]);
+		}
+	}
+
+	block->top = SHRT_MAX;
+	block->bottom = SHRT_MIN;
+}
+
+void NodeIndex::FindOverlapping(int top, int bottom, Callback callback, void* userData)
+{
+	if (root)
+	{
+		FindInBlock(root, top, bottom, callback, userData);
+	}
+}
+
+void NodeIndex::FindInBlock(Block* block, int top, int bottom, Callback callback, void* userData)
+{
+	if (block->top >= bottom || block->bottom <= top)
+	{
+		return;
+	}
+
+	for (int n = 0; n < block->count; n++)
+	{
+		if (block->isLeaf)
+		{
+			Node* node = block->nodes[n];
+			if (node->anchor.y < bottom && ((block->openMask & (1u << n)) || node->anchor.y + node->size.y > top))
+			{
+				callback(userData, node, (long)block->leafNumber * NODE_INDEX_BRANCHING + n);
+			}
+		}
+		else
+		{
+			FindInBlock(block->children[n], top, bottom, callback, userData);
+		}
+	}
+}
+
+long NodeIndex::FindPosition(Node* node)
+{
+	if (!root || hasFailed)
+	{
+		return -1;
+	}
+
+	uint8_t index;
+	Block* leaf = FindInBlock(root, node, index);
+	return leaf ? (long)leaf->leafNumber * NODE_INDEX_BRANCHING + index : -1;
+}
+
+NodeIndex::Block* NodeIndex::FindInBlock(Block* block, Node* node, uint8_t& index)
+{
+	if (block->top > node->anchor.y || block->bottom < node->anchor.y)
+	{
+		return nullptr;
+	}
+
+	for (int n = 0; n < block->count; n++)
+	{
+		if (block->isLeaf)
+		{
+			if (block->nodes[n] == node)
+			{
+				index = (uint8_t)n;
+				return block;
+			}
+		}
+		else
+		{
+			Block* leaf = FindInBlock(block->children[n], node, index);
+			if (leaf)
+			{
+				return leaf;
+			}
+		}
+	}
+
+	return nullptr;
+}
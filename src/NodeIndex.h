@@ -0,0 +1,106 @@
+//
+// Copyright (C) 2021 James Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+
+#ifndef _NODEINDEX_H_
+#define _NODEINDEX_H_
+
+#include <stdint.h>
+
+class Node;
+
+#define NODE_INDEX_BRANCHING 16
+#define NODE_INDEX_MAX_OPEN_NODES 32
+
+// Nodes with completed layout, kept in tree order and grouped into blocks that record the vertical
+// extent of everything beneath them. Finding the nodes in a band of the page only descends into the
+// blocks overlapping it, and results still come out in tree order so parents draw before children
+class NodeIndex
+{
+public:
+	// Position is the order nodes were added in, which is also their order in the tree
+	typedef void (*Callback)(void* userData, Node* node, long position);
+
+	NodeIndex();
+
+	void Reset();
+
+	// Nodes are added in tree order as their layout completes. Returns the position of the node
+	long Add(Node* node);
+
+	// Containers are added before their children, so their extent is unbounded until this is called
+	void Close(Node* node);
+
+	// Layout of the whole page has finished, nothing is left open
+	void CloseAll();
+
+	// Empties the index ready for it to be rebuilt after a relayout, keeping its blocks for reuse
+	void Clear();
+
+	// Empties the index from the node onwards so it can be rebuilt after part of the page is relaid out.
+	// Whatever contains the node is open again. Returns false if the node isn't in the index
+	bool Truncate(Node* node);
+
+	void FindOverlapping(int top, int bottom, Callback callback, void* userData);
+
+	// Returns -1 if the node isn't in the index
+	long FindPosition(Node* node);
+
+	bool HasFailed() { return hasFailed; }
+
+private:
+	struct Block
+	{
+		Block* parent;
+		Block* nextLeaf;
+		uint16_t leafNumber;
+		int16_t top, bottom;
+		uint16_t openMask;
+		uint8_t count;
+		bool isLeaf;
+		union
+		{
+			Node* nodes[NODE_INDEX_BRANCHING];
+			Block* children[NODE_INDEX_BRANCHING];
+		};
+	};
+
+	struct OpenNode
+	{
+		Block* leaf;
+		uint8_t index;
+	};
+
+	Block* AllocateBlock(bool isLeaf);
+	bool AppendLeaf(Block* leaf);
+	void CloseTop();
+
+	static void CalculateExtent(Block* block);
+	static void CloseBlock(Block* block);
+	static void ClearBlock(Block* block);
+	static void FindInBlock(Block* block, int top, int bottom, Callback callback, void* userData);
+	static Block* FindInBlock(Block* block, Node* node, uint8_t& index);
+
+	Block* root;
+	Block* firstLeaf;
+	Block* lastLeaf;
+
+	OpenNode openNodes[NODE_INDEX_MAX_OPEN_NODES];
+	int numOpenNodes;
+
+	long numNodes;
+
+	bool hasFailed;
+};
+
+#endif
@@ -19,6 +19,8 @@ void BlockNode::BeginLayoutContext(Layout& layout, Node* node)
 
 	layout.BreakNewLine();
 	node->anchor = layout.GetCursor();
+	data->layoutMarginLeft = layout.GetParams().marginLeft;
+	data->layoutMarginRight = layout.GetParams().marginRight;
 
 	layout.PadVertical(data->verticalPadding);
 	layout.PushLayout();
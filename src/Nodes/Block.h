@@ -8,9 +8,10 @@ public:
 	class Data
 	{
 	public:
-		Data(int inHorizontalPadding, int inVerticalPadding) : horizontalPadding(inHorizontalPadding), verticalPadding(inVerticalPadding) {}
+		Data(int inHorizontalPadding, int inVerticalPadding) : horizontalPadding(inHorizontalPadding), verticalPadding(inVerticalPadding), layoutMarginLeft(0), layoutMarginRight(0) {}
 		int horizontalPadding;
 		int verticalPadding;
+		int layoutMarginLeft, layoutMarginRight;	// Margins the block was laid out within, for relaying out on its own
 	};
 
 	static Node* Construct(Allocator& allocator, int horizontalPadding = 0, int verticalPadding = 0);
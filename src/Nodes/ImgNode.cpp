@@ -6,47 +6,42 @@
 #include "../Draw/Surface.h"
 #include "../App.h"
 #include "../Image/Decoder.h"
+#include "../Image/Probe.h"
+#include "../Image/ImgCache.h"
 #include "../DataPack.h"
 #include "../HTTP.h"
 #include "Text.h"
+#include "Table.h"
 
 void ImageNode::Draw(DrawContext& context, Node* node)
 {
 	ImageNode::Data* data = static_cast<ImageNode::Data*>(node->data);
 	//printf("--IMG [%d, %d]\n", node->anchor.x, node->anchor.y);
-	uint8_t outlineColour = App::Get().page.colourScheme.textColour;
 
-	if (data->state == ImageNode::FinishedDownloadingContent && data->image.lines.IsAllocated())
+	if (data->state == ImageNode::FinishedDownloadingContent && data->image.strips.IsAllocated())
 	{
 		context.surface->BlitImage(context, &data->image, node->anchor.x, node->anchor.y);
 	}
-	else
+	else if (data->state == ImageNode::DownloadingContent && data->decodedHeight && data->image.strips.IsAllocated())
 	{
-		Image* image = data->state == ImageNode::ErrorDownloading ? Assets.brokenImageIcon : Assets.imageIcon;
-
-		if (data->IsBrokenImageWithoutDimensions())
-		{
-			context.surface->BlitImage(context, image, node->anchor.x, node->anchor.y);
-		}
-		else
-		{
-			context.surface->HLine(context, node->anchor.x, node->anchor.y, node->size.x, outlineColour);
-			context.surface->HLine(context, node->anchor.x, node->anchor.y + node->size.y - 1, node->size.x, outlineColour);
-			context.surface->VLine(context, node->anchor.x, node->anchor.y + 1, node->size.y - 2, outlineColour);
-			context.surface->VLine(context, node->anchor.x + node->size.x - 1, node->anchor.y + 1, node->size.y - 2, outlineColour);
+		// Show what has been decoded so far, with the placeholder underneath it
+		int splitY = node->anchor.y + data->decodedHeight;
 
-			DrawContext croppedContext = context;
-			croppedContext.Restrict(node->anchor.x + 1, node->anchor.y + 1, node->anchor.x + node->size.x - 1, node->anchor.y + node->size.y - 1);
-			croppedContext.surface->BlitImage(croppedContext, image, node->anchor.x + 2, node->anchor.y + 2);
+		DrawContext decodedContext = context;
+		decodedContext.Restrict(node->anchor.x, node->anchor.y, node->anchor.x + node->size.x, splitY);
+		decodedContext.surface->BlitImage(decodedContext, &data->image, node->anchor.x, node->anchor.y);
 
-			if (data->altText)
-			{
-				Font* font = node->GetStyleFont();
-				uint8_t textColour = App::Get().page.colourScheme.textColour;
-				croppedContext.surface->DrawString(croppedContext, font, data->altText, node->anchor.x + image->width + 4, node->anchor.y + 2, textColour, node->GetStyle().fontStyle);
-			}
+		if (data->decodedHeight < node->size.y)
+		{
+			DrawContext placeholderContext = context;
+			placeholderContext.Restrict(node->anchor.x, splitY, node->anchor.x + node->size.x, node->anchor.y + node->size.y);
+			DrawPlaceholder(placeholderContext, node);
 		}
 	}
+	else
+	{
+		DrawPlaceholder(context, node);
+	}
 
 	Node* focusedNode = App::Get().ui.GetFocusedNode();
 	if (focusedNode && node->IsChildOf(focusedNode))
@@ -55,6 +50,36 @@ void ImageNode::Draw(DrawContext& context, Node* node)
 	}
 }
 
+void ImageNode::DrawPlaceholder(DrawContext& context, Node* node)
+{
+	ImageNode::Data* data = static_cast<ImageNode::Data*>(node->data);
+	uint8_t outlineColour = App::Get().page.colourScheme.textColour;
+	Image* image = data->state == ImageNode::ErrorDownloading ? Assets.brokenImageIcon : Assets.imageIcon;
+
+	if (data->IsBrokenImageWithoutDimensions())
+	{
+		context.surface->BlitImage(context, image, node->anchor.x, node->anchor.y);
+	}
+	else
+	{
+		context.surface->HLine(context, node->anchor.x, node->anchor.y, node->size.x, outlineColour);
+		context.surface->HLine(context, node->anchor.x, node->anchor.y + node->size.y - 1, node->size.x, outlineColour);
+		context.surface->VLine(context, node->anchor.x, node->anchor.y + 1, node->size.y - 2, outlineColour);
+		context.surface->VLine(context, node->anchor.x + node->size.x - 1, node->anchor.y + 1, node->size.y - 2, outlineColour);
+
+		DrawContext croppedContext = context;
+		croppedContext.Restrict(node->anchor.x + 1, node->anchor.y + 1, node->anchor.x + node->size.x - 1, node->anchor.y + node->size.y - 1);
+		croppedContext.surface->BlitImage(croppedContext, image, node->anchor.x + 2, node->anchor.y + 2);
+
+		if (data->altText)
+		{
+			Font* font = node->GetStyleFont();
+			uint8_t textColour = App::Get().page.colourScheme.textColour;
+			croppedContext.surface->DrawString(croppedContext, font, data->altText, node->anchor.x + image->width + 4, node->anchor.y + 2, textColour, node->GetStyle().fontStyle);
+		}
+	}
+}
+
 bool ImageNode::Data::IsBrokenImageWithoutDimensions()
 {
 	return state == ImageNode::ErrorDownloading && image.width == Assets.brokenImageIcon->width && image.height == Assets.brokenImageIcon->height;
@@ -91,24 +116,43 @@ void ImageNode::BeginLayoutContext(Layout& layout, Node* node)
 				data->image.height = 1;
 		}
 	}
+
+	if (data->state == ImageNode::ProbedDimensions)
+	{
+		// A table being finalised has already sized its columns, so that has to wait for a reflow
+		TableNode::Data* tableData = node->FindParentDataOfType<TableNode::Data>(Node::Table);
+		if (!tableData || tableData->state != TableNode::Data::FinalisingLayout)
+		{
+			ApplyProbedDimensions(node);
+		}
+	}
 }
 
 void ImageNode::GenerateLayout(Layout& layout, Node* node)
 {
 	ImageNode::Data* data = static_cast<ImageNode::Data*>(node->data);
 
-	if (!data->AreDimensionsLocked())
+	if (!data->HasDimensions() && App::config.loadImages)
+	{
+		// Dimensions are still being probed: lay out a placeholder and reflow once they arrive
+		node->size.x = data->image.width > 0 ? data->image.width : Assets.imageIcon->width + 4;
+		node->size.y = data->image.height > 0 ? data->image.height : Assets.imageIcon->height + 4;
+	}
+	else
 	{
-		if (data->image.width > layout.MaxAvailableWidth())
+		if (!data->AreDimensionsLocked())
 		{
-			int imageWidth = data->image.width;
-			data->image.width = layout.MaxAvailableWidth();
-			data->image.height = (uint16_t)(((long)data->image.height * data->image.width) / imageWidth);
+			if (data->image.width > layout.MaxAvailableWidth())
+			{
+				int imageWidth = data->image.width;
+				data->image.width = layout.MaxAvailableWidth();
+				data->image.height = (uint16_t)(((long)data->image.height * data->image.width) / imageWidth);
+			}
 		}
-	}
 
-	node->size.x = data->image.width;
-	node->size.y = data->image.height;
+		node->size.x = data->image.width;
+		node->size.y = data->image.height;
+	}
 
 	if (layout.AvailableWidth() < node->size.x)
 	{
@@ -130,7 +174,8 @@ void ImageNode::LoadContent(Node* node, LoadTask& loadTask)
 	ImageNode::Data* data = static_cast<ImageNode::Data*>(node->data);
 	if (data && data->state != ImageNode::ErrorDownloading && data->state != ImageNode::FinishedDownloadingContent) 
 	{
-		if (data->HasDimensions() && !App::Get().page.layout.IsFinished())
+		// Dimensions are found by the image probes while layout is still running
+		if (!App::Get().page.layout.IsFinished())
 		{
 			return;
 		}
@@ -143,10 +188,33 @@ void ImageNode::LoadContent(Node* node, LoadTask& loadTask)
 		else 
 		{
 			bool loadDimensionsOnly = !data->HasDimensions();
+
+			if (!loadDimensionsOnly && ImageCache::Get().Load(URL::GenerateFromRelative(App::Get().page.pageURL.url, data->source).url, &data->image))
+			{
+				// Decoded on an earlier page so there is nothing to download
+				data->state = ImageNode::FinishedDownloadingContent;
+				App::Get().pageRenderer.MarkNodeDirty(node);
+				return;
+			}
+
 			if (!loadDimensionsOnly && App::Get().pageLoadTask.HasContent())
 				return;
 
-			loadTask.Load(URL::GenerateFromRelative(App::Get().page.pageURL.url, data->source).url);
+			ImageSpool* spool = App::Get().FindImageSpool(data->source);
+			if (spool && spool->IsWriting())
+			{
+				// The dimension probe is still downloading it, App::UpdateContentLoadTask() waits for that
+				return;
+			}
+
+			if (spool && spool->isComplete)
+			{
+				spool->Load(loadTask);
+			}
+			else
+			{
+				loadTask.Load(URL::GenerateFromRelative(App::Get().page.pageURL.url, data->source).url);
+			}
 			data->state = ImageNode::DeterminingFormat;
 		}
 	}
@@ -192,9 +260,101 @@ void ImageNode::ImageLoadError(Node* node)
 			}
 		}
 		data->state = ImageNode::ErrorDownloading;
+
+		if (data->decodedHeight)
+		{
+			// Part of the image was already shown
+			App::Get().pageRenderer.MarkNodeDirty(node);
+		}
 	}
 }
 
+void ImageNode::FinishDimensionProbe(Node* node, ImageProbe& probe)
+{
+	ImageNode::Data* data = static_cast<ImageNode::Data*>(node->data);
+
+	if (probe.GetState() == ImageProbe::Success)
+	{
+		data->probedWidth = (uint16_t) probe.sourceWidth;
+		data->probedHeight = (uint16_t) probe.sourceHeight;
+	}
+	else
+	{
+		Platform::Log("Image probe failed: %s", data->source);
+	}
+	data->state = ImageNode::ProbedDimensions;
+
+	Layout& layout = App::Get().page.layout;
+	layout.MarkImageSizeChanged(node);
+
+	// Other uses of the same image that are still waiting can share the result. The ones layout
+	// hasn't reached yet pick it up when they are laid out
+	bool isLaidOut = true;
+	for (Node* n = node->GetNextInTree(); n; n = n->GetNextInTree())
+	{
+		if (n == layout.currentNodeToProcess)
+		{
+			isLaidOut = false;
+		}
+
+		if (n->type == Node::Image)
+		{
+			ImageNode::Data* otherData = static_cast<ImageNode::Data*>(n->data);
+
+			if (otherData->source && !strcmp(data->source, otherData->source) && otherData->NeedsDimensionProbe())
+			{
+				ShareProbedDimensions(n, node);
+				if (isLaidOut)
+				{
+					layout.MarkImageSizeChanged(n);
+				}
+			}
+		}
+	}
+}
+
+bool ImageNode::LoadCachedDimensions(Node* node)
+{
+	ImageNode::Data* data = static_cast<ImageNode::Data*>(node->data);
+
+	if (ImageCache::Get().FindSourceDimensions(URL::GenerateFromRelative(App::Get().page.pageURL.url, data->source).url, data->probedWidth, data->probedHeight))
+	{
+		data->state = ImageNode::ProbedDimensions;
+		return true;
+	}
+	return false;
+}
+
+void ImageNode::ShareProbedDimensions(Node* node, Node* probedNode)
+{
+	ImageNode::Data* data = static_cast<ImageNode::Data*>(node->data);
+	ImageNode::Data* probedData = static_cast<ImageNode::Data*>(probedNode->data);
+
+	data->probedWidth = probedData->probedWidth;
+	data->probedHeight = probedData->probedHeight;
+	data->state = ImageNode::ProbedDimensions;
+}
+
+void ImageNode::ApplyProbedDimensions(Node* node)
+{
+	ImageNode::Data* data = static_cast<ImageNode::Data*>(node->data);
+
+	if (data->probedWidth && data->probedHeight)
+	{
+		ImageDecoder::CalculateImageDimensions(&data->image, data->probedWidth, data->probedHeight);
+		data->state = ImageNode::FinishedDownloadingDimensions;
+	}
+	else
+	{
+		ImageLoadError(node);
+	}
+}
+
+bool ImageNode::HasLayoutSizeChanged(Node* node)
+{
+	ImageNode::Data* data = static_cast<ImageNode::Data*>(node->data);
+	return data->HasDimensions() && (node->size.x != data->image.width || node->size.y != data->image.height);
+}
 
 bool ImageNode::ParseContent(Node* node, char* buffer, size_t count)
 {
@@ -209,6 +369,7 @@ bool ImageNode::ParseContent(Node* node, char* buffer, size_t count)
 		if((contentType && ImageDecoder::CreateFromMIME(contentType)) || ImageDecoder::CreateFromExtension(data->source))
 		{
 			ImageDecoder::Get()->Begin(&data->image, loadDimensionsOnly);
+			data->decodedHeight = 0;
 			data->state = loadDimensionsOnly ? ImageNode::DownloadingDimensions : ImageNode::DownloadingContent;
 		}
 		else
@@ -223,6 +384,22 @@ bool ImageNode::ParseContent(Node* node, char* buffer, size_t count)
 	ImageDecoder* decoder = ImageDecoder::Get();
 
 	decoder->Process((uint8_t*) buffer, count);
+
+	// Lines are drawn as they are decoded rather than waiting for the whole image
+	int updatedTop = data->decodedHeight;
+	int updatedBottom = data->decodedHeight;
+	if (data->state == ImageNode::DownloadingContent && decoder->GetUpdatedLines(updatedTop, updatedBottom))
+	{
+		if (updatedBottom > data->decodedHeight)
+		{
+			data->decodedHeight = (uint16_t) updatedBottom;
+		}
+		if (decoder->GetState() == ImageDecoder::Decoding)
+		{
+			App::Get().pageRenderer.MarkNodeRegionDirty(node, updatedTop, updatedBottom, !decoder->IsOpaque());
+		}
+	}
+
 	if (decoder->GetState() == ImageDecoder::Success)
 	{
 		if (data->state == ImageNode::DownloadingDimensions)
@@ -232,7 +409,11 @@ bool ImageNode::ParseContent(Node* node, char* buffer, size_t count)
 		else
 		{
 			data->state = ImageNode::FinishedDownloadingContent;
-			App::Get().pageRenderer.MarkNodeDirty(node);
+			ImageCache::Get().Put(URL::GenerateFromRelative(App::Get().page.pageURL.url, data->source).url, decoder->GetSourceWidth(), decoder->GetSourceHeight(), &data->image);
+
+			// Everything above the last lines is already on screen. Anything that was never
+			// decoded still shows the placeholder so is redrawn too
+			App::Get().pageRenderer.MarkNodeRegionDirty(node, updatedTop, node->size.y);
 		}
 
 		// Loop through image nodes in case this image is used multiple times
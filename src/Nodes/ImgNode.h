@@ -15,20 +15,24 @@ public:
 		FinishedDownloadingDimensions = 3,
 		DownloadingContent = 4,
 		FinishedDownloadingContent = 5,
-		ErrorDownloading = 6
+		ErrorDownloading = 6,
+		ProbedDimensions = 7		// Probe finished, result not yet applied to layout
 	};
 
 	class Data
 	{
 	public:
-		Data() : source(nullptr), altText(nullptr), state(WaitingToDownload) {}
+		Data() : source(nullptr), altText(nullptr), state(WaitingToDownload), probedWidth(0), probedHeight(0), decodedHeight(0) {}
 		bool HasDimensions() { return image.width > 0 && image.height > 0; }
 		bool AreDimensionsLocked() { return state == DownloadingContent || state == FinishedDownloadingContent || state == ErrorDownloading; }
 		bool IsBrokenImageWithoutDimensions();
+		bool NeedsDimensionProbe() { return state == WaitingToDownload && !HasDimensions() && !(explicitWidth.IsSet() && explicitHeight.IsSet()); }
 		Image image;
 		const char* source;
 		char* altText;
 		State state;
+		uint16_t probedWidth, probedHeight;	// Source dimensions found by the probe, zero if it failed
+		uint16_t decodedHeight;				// Lines from the top that can be shown while still downloading
 
 		ExplicitDimension explicitWidth;
 		ExplicitDimension explicitHeight;
@@ -45,7 +49,15 @@ public:
 
 	virtual bool CanPick(Node* node) override { return true; }
 
-	void ImageLoadError(Node* node);
+	static void ImageLoadError(Node* node);
+	static void DrawPlaceholder(DrawContext& context, Node* node);
+
+	// Dimension probes run alongside layout, see App::UpdateImageProbeTasks()
+	static void FinishDimensionProbe(Node* node, class ImageProbe& probe);
+	static void ShareProbedDimensions(Node* node, Node* probedNode);
+	static bool LoadCachedDimensions(Node* node);		// From an image decoded on an earlier page, without a probe
+	static void ApplyProbedDimensions(Node* node);
+	static bool HasLayoutSizeChanged(Node* node);
 };
 
 #endif
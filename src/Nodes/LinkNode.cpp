@@ -1,4 +1,5 @@
 #include "LinkNode.h"
+#include "Text.h"
 #include "../Memory/Memory.h"
 #include "../Event.h"
 #include "../App.h"
@@ -85,22 +86,14 @@ void LinkNode::HighlightChildren(Node* node)
 	{
 		if (isDescendingTree)
 		{
-			bool shouldHighlight = false;
-
 			switch (child->type)
 			{
 			case Node::Text:
-				shouldHighlight = child->firstChild == nullptr;
+				TextElement::InvertLines(child);
 				break;
 			case Node::Image:
-			case Node::SubText:
-				shouldHighlight = true;
-				break;
-			}
-
-			if (shouldHighlight)
-			{
 				App::Get().pageRenderer.InvertNode(child);
+				break;
 			}
 
 			if (child->firstChild)
@@ -148,11 +148,9 @@ void OptionNode::GenerateLayout(Layout& layout, Node* node)
 			data->addedToSelectNode = true;
 		}
 
-		Font* font = node->GetStyleFont();
-
 		if (data->text)
 		{
-			node->size.x = font->CalculateWidth(data->text, node->GetStyle().fontStyle);
+			node->size.x = node->GetResolvedStyle().CalculateWidth(data->text);
 		}
 	}
 }
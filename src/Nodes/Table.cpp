@@ -65,6 +65,12 @@ void TableNode::BeginLayoutContext(Layout& layout, Node* node)
 	node->anchor = layout.Cursor();
 	int availableWidth = layout.AvailableWidth();
 
+	if (data->state != Data::FinalisingLayout)
+	{
+		data->layoutMarginLeft = layout.GetParams().marginLeft;
+		data->layoutMarginRight = layout.GetParams().marginRight;
+	}
+
 	if (data->state == Data::FinishedLayout)
 	{
 		//if (availableWidth != data->lastAvailableWidth)
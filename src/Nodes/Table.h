@@ -93,6 +93,7 @@ public:
 		TableCellNode::Data** cells;
 		uint8_t bgColour;
 		int lastAvailableWidth;
+		int layoutMarginLeft, layoutMarginRight;	// Margins the table was laid out within, for reflowing on its own
 		ExplicitDimension explicitWidth;
 	};
 
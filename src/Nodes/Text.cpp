@@ -27,12 +27,11 @@ void TextElement::Draw(DrawContext& context, Node* node)
 {
 	TextElement::Data* data = static_cast<TextElement::Data*>(node->data);
 
-	if (!node->firstChild && data->text.IsAllocated())
+	if (data->text.IsAllocated())
 	{
-		Font* font = node->GetStyleFont();
+		const ResolvedStyle& style = node->GetResolvedStyle();
 
 		uint8_t textColour = node->GetStyle().fontColour;
-		char* text = data->text.Get<char*>();
 
 		if (textColour == App::Get().page.colourScheme.pageColour)
 		{
@@ -46,22 +45,279 @@ void TextElement::Draw(DrawContext& context, Node* node)
 			}
 		}
 
-		context.surface->DrawString(context, font, text, node->anchor.x, node->anchor.y, textColour, node->GetStyle().fontStyle);
-
 		Node* focusedNode = App::Get().ui.GetFocusedNode();
-		if (focusedNode && node->IsChildOf(focusedNode))
+		bool isFocused = focusedNode && node->IsChildOf(focusedNode);
+
+		if (!data->NumLines())
+		{
+			char* text = data->text.Get<char*>();
+			context.surface->DrawString(context, style.font, text, node->anchor.x, node->anchor.y, textColour, style.fontStyle);
+
+			if (isFocused)
+			{
+				context.surface->InvertRect(context, node->anchor.x, node->anchor.y, node->size.x, node->size.y);
+			}
+			return;
+		}
+
+		int lineHeight = style.font->glyphHeight;
+
+		for (TextLineIterator it(data); it.Get(); it.Next())
+		{
+			Line* line = it.Get();
+
+			// Lines go down the page in order so nothing after this one can be in the clip region
+			if (line->position.y + context.drawOffsetY > context.clipBottom)
+			{
+				break;
+			}
+			if (line->position.y + lineHeight + context.drawOffsetY < context.clipTop)
+			{
+				continue;
+			}
+
+			// Text is fetched again for each line as drawing can map a different EMS page in
+			char* text = data->text.Get<char*>() + line->startIndex;
+			char temp = text[line->length];
+			text[line->length] = 0;
+
+			context.surface->DrawString(context, style.font, text, line->position.x, line->position.y, textColour, style.fontStyle);
+
+			data->text.Get<char*>()[line->startIndex + line->length] = temp;
+
+			if (isFocused)
+			{
+				context.surface->InvertRect(context, line->position.x, line->position.y, line->width, lineHeight);
+			}
+		}
+	}
+}
+
+bool TextElement::IsPointInside(Node* node, int x, int y)
+{
+	TextElement::Data* data = static_cast<TextElement::Data*>(node->data);
+
+	if (!data->NumLines())
+	{
+		return node->IsPointInsideNode(x, y);
+	}
+
+	int lineHeight = node->GetResolvedStyle().font->glyphHeight;
+
+	for (TextLineIterator it(data); it.Get(); it.Next())
+	{
+		Line* line = it.Get();
+		if (x >= line->position.x && y >= line->position.y && x < line->position.x + line->width && y < line->position.y + lineHeight)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void TextElement::InvertLines(Node* node)
+{
+	TextElement::Data* data = static_cast<TextElement::Data*>(node->data);
+	PageRenderer& renderer = App::Get().pageRenderer;
+
+	if (!data->NumLines())
+	{
+		renderer.InvertRect(node->anchor.x, node->anchor.y, node->size.x, node->size.y);
+		return;
+	}
+
+	int lineHeight = node->GetResolvedStyle().font->glyphHeight;
+
+	for (TextLineIterator it(data); it.Get(); it.Next())
+	{
+		Line* line = it.Get();
+		renderer.InvertRect(line->position.x, line->position.y, line->width, lineHeight);
+	}
+}
+
+TextElement::WrapData* TextElement::GetWrapData(Data* data)
+{
+	if (!data->wrap)
+	{
+		WrapData* wrap = (WrapData*)MemoryManager::pageAllocator.Allocate(sizeof(WrapData) + sizeof(Line) * (TEXT_LINES_FIRST_CHUNK - 1));
+		if (wrap)
 		{
-			context.surface->InvertRect(context, node->anchor.x, node->anchor.y, node->size.x, node->size.y);
+			wrap->wordWidths = nullptr;
+			wrap->numWords = 0;
+			wrap->numLines = 0;
+			wrap->lines.next = nullptr;
+			wrap->lines.capacity = TEXT_LINES_FIRST_CHUNK;
+			data->wrap = wrap;
 		}
 	}
+	return data->wrap;
 }
 
+TextElement::Line* TextElement::AddLine(Data* data)
+{
+	WrapData* wrap = GetWrapData(data);
+	if (!wrap)
+	{
+		return nullptr;
+	}
+
+	int index = wrap->numLines;
+	LineChunk* chunk = &wrap->lines;
+
+	// Chunks left over from an earlier layout are filled in again before any new ones are added
+	while (index >= chunk->capacity)
+	{
+		index -= chunk->capacity;
+
+		if (!chunk->next)
+		{
+			int capacity = chunk->capacity * 2;
+			if (capacity > TEXT_LINES_MAX_CHUNK)
+			{
+				capacity = TEXT_LINES_MAX_CHUNK;
+			}
+
+			LineChunk* newChunk = (LineChunk*)MemoryManager::pageAllocator.Allocate(sizeof(LineChunk) + sizeof(Line) * (capacity - 1));
+			if (!newChunk)
+			{
+				return nullptr;
+			}
+			newChunk->next = nullptr;
+			newChunk->capacity = (uint8_t)capacity;
+			chunk->next = newChunk;
+		}
+
+		chunk = chunk->next;
+	}
+
+	wrap->numLines++;
+	return &chunk->lines[index];
+}
+
+void TextElement::UpdateBounds(Node* node)
+{
+	TextElement::Data* data = static_cast<TextElement::Data*>(node->data);
+	int lineHeight = node->GetResolvedStyle().font->glyphHeight;
+	TextLineIterator it(data);
+	Line* line = it.Get();
+
+	if (!line)
+	{
+		return;
+	}
+
+	int left = line->position.x;
+	int right = line->position.x + line->width;
+	int top = line->position.y;
+	int bottom = line->position.y + lineHeight;
+
+	for (it.Next(); it.Get(); it.Next())
+	{
+		line = it.Get();
+		if (line->position.x < left)
+			left = line->position.x;
+		if (line->position.x + line->width > right)
+			right = line->position.x + line->width;
+		if (line->position.y < top)
+			top = line->position.y;
+		if (line->position.y + lineHeight > bottom)
+			bottom = line->position.y + lineHeight;
+	}
+
+	node->anchor.x = left;
+	node->anchor.y = top;
+	node->size.x = right - left;
+	node->size.y = bottom - top;
+}
+
+void TextElement::TranslateLines(Node* node, int firstLine, int deltaX, int deltaY)
+{
+	TextElement::Data* data = static_cast<TextElement::Data*>(node->data);
+
+	for (TextLineIterator it(data, firstLine); it.Get(); it.Next())
+	{
+		Line* line = it.Get();
+		line->position.x += deltaX;
+		line->position.y += deltaY;
+	}
+
+	if (firstLine && data->NumLines())
+	{
+		UpdateBounds(node);
+	}
+	else
+	{
+		node->anchor.x += deltaX;
+		node->anchor.y += deltaY;
+	}
+}
+
+// Words run up to the next space, tab or the end of the text. A non breaking space is part of a word
+static inline bool IsWordBreak(char c)
+{
+	return c == ' ' || c == '\t' || !c;
+}
+
+// Measures the word at the start of text in one pass, returning its length
+static int ScanWord(const uint8_t* glyphWidths, const char* text, int& width, bool& hasNonBreakingSpace)
+{
+	int length = 0;
+	width = 0;
+
+	for (;;)
+	{
+		uint8_t c = (uint8_t)text[length];
+		if (c <= ' ')
+		{
+			if (IsWordBreak(c))
+			{
+				break;
+			}
+			if (c == '\x1f')
+			{
+				hasNonBreakingSpace = true;
+			}
+		}
+		width += glyphWidths[c];
+		length++;
+	}
+
+	return length;
+}
+
+static int FindWordLength(const char* text)
+{
+	int length = 0;
+	while (!IsWordBreak(text[length]))
+	{
+		length++;
+	}
+	return length;
+}
+
+static uint16_t CountWords(const char* text)
+{
+	uint16_t result = 0;
+	bool inWord = false;
+
+	for (; *text; text++)
+	{
+		bool isBreak = IsWordBreak(*text);
+		if (!isBreak && !inWord)
+		{
+			result++;
+		}
+		inWord = !isBreak;
+	}
+	return result;
+}
 
 void TextElement::GenerateLayout(Layout& layout, Node* node)
 {
 	TextElement::Data* data = static_cast<TextElement::Data*>(node->data);
-	Font* font = node->GetStyleFont();
-	int lineHeight = font->glyphHeight;
+	const ResolvedStyle& style = node->GetResolvedStyle();
+	int lineHeight = style.font->glyphHeight;
 
 #if 1
 	// TODO: optimisation
@@ -71,17 +327,26 @@ void TextElement::GenerateLayout(Layout& layout, Node* node)
 		// completely regenerating the whole layout
 		if (data->lastAvailableWidth == layout.AvailableWidth())
 		{
-			if (node->firstChild)
+			if (data->NumLines())
 			{
-				for (Node* child = node->firstChild; child; child = child->next)
+				TextLineIterator it(data);
+				data->wrap->numLines = 0;
+
+				while (it.Get())
 				{
-					child->anchor = layout.GetCursor(lineHeight);
-					layout.ProgressCursor(child, child->size.x, child->size.y);
-					if (child->next)
+					Line* line = it.Get();
+					line->position = layout.GetCursor(lineHeight);
+					data->wrap->numLines++;
+					layout.ProgressCursor(node, line->width, lineHeight, data->wrap->numLines - 1);
+
+					it.Next();
+					if (it.Get())
 					{
 						layout.BreakNewLine();
 					}
 				}
+
+				UpdateBounds(node);
 			}
 			else
 			{
@@ -93,20 +358,16 @@ void TextElement::GenerateLayout(Layout& layout, Node* node)
 		}
 	}
 
+	bool isRewrapping = data->lastAvailableWidth != -1;
 	data->lastAvailableWidth = layout.AvailableWidth();
 #endif
 	
 
-	// Clear out SubTextElement children if we are regenerating the layout
-	for (Node* child = node->firstChild; child; child = child->next)
+	// Lines from an earlier layout are overwritten as the text is wrapped again
+	if (data->wrap)
 	{
-		SubTextElement::Data* childData = static_cast<SubTextElement::Data*>(child->data);
-		childData->startIndex = 0;
-		childData->length = 0;
-		child->anchor = layout.GetCursor();
-		child->size.Clear();
+		data->wrap->numLines = 0;
 	}
-
 	node->size.Clear();
 
 	char* text = data->text.Get<char*>();
@@ -115,12 +376,70 @@ void TextElement::GenerateLayout(Layout& layout, Node* node)
 	int lastBreakPoint = 0;
 	int lastBreakPointWidth = 0;
 	int width = 0;
-	Node* subTextNode = node->firstChild;
 	bool hasModified = false;
 
+	// Whole words are measured at once and skipped over when they fit on the line, leaving the
+	// character by character breaking below for spaces and words that overflow. Text that gets
+	// wrapped again at a different width keeps its word widths so they aren't measured again
+	uint16_t wordIndex = 0;
+	int wordEnd = 0;
+	uint16_t numWords = 0;
+	uint16_t* newWordWidths = nullptr;
+
+	if (isRewrapping && !(data->wrap && data->wrap->wordWidths))
+	{
+		numWords = CountWords(text);
+		if (numWords)
+		{
+			newWordWidths = (uint16_t*)MemoryManager::pageAllocator.Allocate(sizeof(uint16_t) * numWords);
+		}
+	}
+
 	for(charIndex = 0; ; charIndex++)
 	{
 		char c = text[charIndex];
+
+		if (charIndex >= wordEnd && !IsWordBreak(c))
+		{
+			int wordWidth;
+			int wordLength;
+			bool hasNonBreakingSpace = false;
+
+			if (data->wrap && data->wrap->wordWidths && wordIndex < data->wrap->numWords)
+			{
+				wordWidth = data->wrap->wordWidths[wordIndex];
+				wordLength = FindWordLength(text + charIndex);
+			}
+			else
+			{
+				wordLength = ScanWord(style.glyphWidths, text + charIndex, wordWidth, hasNonBreakingSpace);
+				if (newWordWidths && wordIndex < numWords)
+				{
+					newWordWidths[wordIndex] = (uint16_t)wordWidth;
+				}
+			}
+
+			wordIndex++;
+			wordEnd = charIndex + wordLength;
+
+			if (text[wordEnd] && width + wordWidth <= layout.AvailableWidth())
+			{
+				if (hasNonBreakingSpace)
+				{
+					for (int n = charIndex; n < wordEnd; n++)
+					{
+						if (text[n] == '\x1f')
+							text[n] = ' ';
+					}
+					hasModified = true;
+				}
+
+				width += wordWidth;
+				charIndex = wordEnd - 1;
+				continue;
+			}
+		}
+
 		bool isEnd = text[charIndex + 1] == 0;
 
 		if (c == ' ' || c == '\t')
@@ -136,7 +455,7 @@ void TextElement::GenerateLayout(Layout& layout, Node* node)
 			hasModified = true;
 		}
 
-		int glyphWidth = font->GetGlyphWidth(c, node->GetStyle().fontStyle);
+		int glyphWidth = style.GetGlyphWidth(c);
 		width += glyphWidth;
 
 		bool cannotFit = width > layout.AvailableWidth();
@@ -164,9 +483,9 @@ void TextElement::GenerateLayout(Layout& layout, Node* node)
 				emitWidth = width;
 				nextIndex = -1;
 
-				if (!node->firstChild)
+				if (!data->NumLines())
 				{
-					// No line breaks so don't create sub text nodes
+					// No line breaks so the node itself is the only line
 					node->anchor = layout.GetCursor(lineHeight);
 					node->size.x = emitWidth;
 					node->size.y = lineHeight;
@@ -190,27 +509,21 @@ void TextElement::GenerateLayout(Layout& layout, Node* node)
 				nextIndex = charIndex;
 			}
 			
-			if (!subTextNode)
-			{
-				subTextNode = SubTextElement::Construct(MemoryManager::pageAllocator, emitStartPosition, emitLength);
-				node->AddChild(subTextNode);
-			}
-			else
+			Line* line = AddLine(data);
+			if (!line)
 			{
-				SubTextElement::Data* subTextData = static_cast<SubTextElement::Data*>(subTextNode->data);
-				subTextData->startIndex = emitStartPosition;
-				subTextData->length = emitLength;
+				break;
 			}
 
-			subTextNode->anchor = layout.GetCursor(lineHeight);
-			subTextNode->size.x = emitWidth;
-			subTextNode->size.y = lineHeight;
+			line->startIndex = (uint16_t)emitStartPosition;
+			line->length = (uint16_t)emitLength;
+			line->position = layout.GetCursor(lineHeight);
+			line->width = (int16_t)emitWidth;
 
 			startIndex = nextIndex;
 			width -= emitWidth;
 
-			layout.ProgressCursor(subTextNode, emitWidth, lineHeight);
-			subTextNode = subTextNode->next;
+			layout.ProgressCursor(node, emitWidth, lineHeight, data->wrap->numLines - 1);
 
 			if (isEnd)
 			{
@@ -224,62 +537,19 @@ void TextElement::GenerateLayout(Layout& layout, Node* node)
 		}
 	}
 
-	if (hasModified)
+	if (data->NumLines())
 	{
-		data->text.Commit();
+		UpdateBounds(node);
 	}
-}
 
-Node* SubTextElement::Construct(Allocator& allocator, int startIndex, int length)
-{
-	SubTextElement::Data* data = allocator.Alloc<SubTextElement::Data>(startIndex, length);
-	if (data)
+	if (newWordWidths && wordIndex == numWords && GetWrapData(data))
 	{
-		return allocator.Alloc<Node>(Node::SubText, data);
+		data->wrap->wordWidths = newWordWidths;
+		data->wrap->numWords = numWords;
 	}
 
-	return nullptr;
-}
-
-void SubTextElement::GenerateLayout(Layout& layout, Node* node)
-{
-	TextElement::Data* data = static_cast<TextElement::Data*>(node->data);
-}
-
-void SubTextElement::Draw(DrawContext& context, Node* node)
-{
-	TextElement::Data* textData = static_cast<TextElement::Data*>(node->parent->data);
-	SubTextElement::Data* subTextData = static_cast<SubTextElement::Data*>(node->data);
-
-	if (textData && subTextData && textData->text.IsAllocated())
+	if (hasModified)
 	{
-		Font* font = node->GetStyleFont();
-		uint8_t textColour = node->GetStyle().fontColour;
-		char* text = textData->text.Get<char*>() + subTextData->startIndex;
-		char temp = text[subTextData->length];
-		text[subTextData->length] = 0;
-
-		if (textColour == App::Get().page.colourScheme.pageColour)
-		{
-			if (context.surface->format == DrawSurface::Format_1BPP)
-			{
-				textColour = !textColour;
-			}
-			else
-			{
-				textColour ^= 0x08;
-			}
-		}
-
-		context.surface->DrawString(context, font, text, node->anchor.x, node->anchor.y, textColour, node->GetStyle().fontStyle);
-
-		Node* focusedNode = App::Get().ui.GetFocusedNode();
-		if (focusedNode && node->IsChildOf(focusedNode))
-		{
-			context.surface->InvertRect(context, node->anchor.x, node->anchor.y, node->size.x, node->size.y);
-		}
-
-		text[subTextData->length] = temp;
-		//printf("%s [%d, %d](%d %d)", data->text, node->anchor.x, node->anchor.y, node->style.fontStyle, node->style.fontSize);
+		data->text.Commit();
 	}
 }
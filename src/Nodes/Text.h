@@ -3,33 +3,91 @@
 #include "../Node.h"
 #include "../Memory/MemBlock.h"
 
+#define TEXT_LINES_FIRST_CHUNK 2
+#define TEXT_LINES_MAX_CHUNK 32
+
 class TextElement : public NodeHandler
 {
 public:
+	// Where one wrapped line of the text was placed. Every line is the height of the font
+	struct Line
+	{
+		uint16_t startIndex;
+		uint16_t length;
+		Coord position;
+		int16_t width;
+	};
+
+	// Lines after the first few are kept in chunks that double in size up to TEXT_LINES_MAX_CHUNK,
+	// so that wrapping only appends to the page allocator and the chunks are reused by later layouts
+	struct LineChunk
+	{
+		LineChunk* next;
+		uint8_t capacity;
+		Line lines[1];
+	};
+
+	// Only allocated once the text has been wrapped, so text that fits on one line doesn't pay for it
+	struct WrapData
+	{
+		uint16_t* wordWidths;		// Kept once the text has been wrapped at more than one width
+		uint16_t numWords;
+		uint16_t numLines;			// Zero when the node itself is the single line
+		LineChunk lines;			// Must be last, holds TEXT_LINES_FIRST_CHUNK lines
+	};
+
 	class Data
 	{
 	public:
-		Data(MemBlockHandle& inText) : text(inText), lastAvailableWidth(-1) {}
+		Data(MemBlockHandle& inText) : text(inText), lastAvailableWidth(-1), wrap(nullptr) {}
+		int NumLines() { return wrap ? wrap->numLines : 0; }
 		MemBlockHandle text;
 		int lastAvailableWidth;
+		WrapData* wrap;
 	};
-	
+
 	static Node* Construct(Allocator& allocator, const char* text);
 	virtual void GenerateLayout(Layout& layout, Node* node) override;
 	virtual void Draw(DrawContext& context, Node* element) override;
+	virtual bool IsPointInside(Node* node, int x, int y) override;
+
+	// Moves the lines from firstLine onwards and keeps the node bounds around them
+	static void TranslateLines(Node* node, int firstLine, int deltaX, int deltaY);
+	static void InvertLines(Node* node);
+
+private:
+	static WrapData* GetWrapData(Data* data);
+	static Line* AddLine(Data* data);
+	static void UpdateBounds(Node* node);
 };
 
-class SubTextElement : public TextElement
+// Steps through the wrapped lines of a text element in order
+class TextLineIterator
 {
 public:
-	class Data
+	TextLineIterator(TextElement::Data* data, int firstLine = 0) : chunk(data->wrap ? &data->wrap->lines : nullptr), index(firstLine), remaining(data->NumLines() - firstLine)
 	{
-	public:
-		Data(int inStartIndex, int inLength) : startIndex(inStartIndex), length(inLength) {}
-		int startIndex;
-		int length;
-	};
-	static Node* Construct(Allocator& allocator, int startIndex, int length);
-	virtual void GenerateLayout(Layout& layout, Node* node) override;
-	virtual void Draw(DrawContext& context, Node* element) override;
+		while (chunk && index >= chunk->capacity)
+		{
+			index -= chunk->capacity;
+			chunk = chunk->next;
+		}
+	}
+
+	TextElement::Line* Get() { return remaining > 0 && chunk ? &chunk->lines[index] : nullptr; }
+
+	void Next()
+	{
+		remaining--;
+		if (++index == chunk->capacity)
+		{
+			chunk = chunk->next;
+			index = 0;
+		}
+	}
+
+private:
+	TextElement::LineChunk* chunk;
+	int index;
+	int remaining;
 };
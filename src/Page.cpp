@@ -30,6 +30,9 @@
 
 #define TOP_MARGIN_PADDING 1
 
+// When memory is low, images further than this many screens from the viewport wait until it gets closer
+#define IMAGE_LOAD_DEFER_DISTANCE_SCREENS 1
+
 Page::Page(App& inApp) : app(inApp), layout(*this)
 {
 }
@@ -44,6 +47,10 @@ void Page::Reset()
 	cursorX = leftMarginPadding;
 	cursorY = TOP_MARGIN_PADDING;
 	colourScheme = Platform::video->colourScheme;
+	imageLoadQueue = nullptr;
+	imageLoadQueueSize = 0;
+	hasBuiltImageLoadQueue = false;
+	hasDeferredImageLoads = false;
 
 	MemoryManager::pageAllocator.Reset();
 	MemoryManager::pageBlockAllocator.Reset();
@@ -68,7 +75,6 @@ static const char* nodeTypeNames[] =
 {
 	"Section",
 	"Text",
-	"SubText",
 	"Image",
 	"Break",
 	"Style",
@@ -85,7 +91,8 @@ static const char* nodeTypeNames[] =
 	"Select",
 	"Option",
 	"List",
-	"ListItem"
+	"ListItem",
+	"CheckBox"
 };
 
 void Page::DebugDumpNodeGraph()
@@ -134,9 +141,23 @@ void Page::DebugDumpNodeGraph(Node* node, int depth)
 		case Node::Text:
 		{
 			TextElement::Data* data = static_cast<TextElement::Data*>(node->data);
-			if (node->firstChild)
+			if (data->NumLines())
 			{
 				printf("<%s> [%d,%d:%d,%d]\n", nodeTypeNames[node->type], node->anchor.x, node->anchor.y, node->size.x, node->size.y);
+
+				for (TextLineIterator it(data); it.Get(); it.Next())
+				{
+					TextElement::Line* line = it.Get();
+					char* text = data->text.Get<char*>() + line->startIndex;
+					char temp = text[line->length];
+					text[line->length] = 0;
+					for (int i = 0; i <= depth; i++)
+					{
+						printf(" ");
+					}
+					printf("[%d,%d:%d] %s\n", line->position.x, line->position.y, line->width, text);
+					text[line->length] = temp;
+				}
 			}
 			else
 			{
@@ -144,17 +165,6 @@ void Page::DebugDumpNodeGraph(Node* node, int depth)
 			}
 		}
 		break;
-	case Node::SubText:
-		{
-			TextElement::Data* data = static_cast<TextElement::Data*>(node->parent->data);
-			SubTextElement::Data* subData = static_cast<SubTextElement::Data*>(node->data);
-			char* text = data->text.Get<char*>() + subData->startIndex;
-			char temp = text[subData->length];
-			text[subData->length] = 0;
-			printf("<%s> [%d,%d:%d,%d] %s\n", nodeTypeNames[node->type], node->anchor.x, node->anchor.y, node->size.x, node->size.y, text);
-			text[subData->length] = temp;
-		}
-		break;
 	case Node::Option:
 		{
 			OptionNode::Data* data = static_cast<OptionNode::Data*>(node->data);
@@ -222,17 +232,120 @@ void Page::DebugDumpNodeGraph(Node* node, int depth)
 	}
 }
 
+void Page::BuildImageLoadQueue()
+{
+	int numImages = 0;
+	Node* node;
+
+	for (node = rootNode; node; node = node->GetNextInTree())
+	{
+		if (node->type == Node::Image)
+			numImages++;
+	}
+
+	if (numImages)
+	{
+		imageLoadQueue = (Node**)MemoryManager::pageAllocator.Allocate(sizeof(Node*) * numImages);
+	}
+
+	if (imageLoadQueue)
+	{
+		for (node = rootNode; node; node = node->GetNextInTree())
+		{
+			if (node->type == Node::Image)
+				imageLoadQueue[imageLoadQueueSize++] = node;
+		}
+	}
+
+	hasBuiltImageLoadQueue = true;
+}
+
+long Page::GetDistanceFromViewport(Node* node)
+{
+	long viewTop = app.ui.GetScrollPositionY();
+	long viewBottom = viewTop + app.ui.windowRect.height;
+	long nodeTop = node->anchor.y;
+	long nodeBottom = nodeTop + node->size.y;
+
+	if (nodeBottom <= viewTop)
+		return viewTop - nodeBottom;
+	if (nodeTop >= viewBottom)
+		return nodeTop - viewBottom;
+	return 0;
+}
+
+bool Page::ShouldRetryDeferredImageLoads()
+{
+	return hasDeferredImageLoads && deferredScrollPositionY != app.ui.GetScrollPositionY();
+}
+
 Node* Page::ProcessNextLoadTask(Node* lastNode, LoadTask& loadTask)
 {
 	Node* node;
-	for (node = lastNode->GetNextInTree(); node; node = node->GetNextInTree())
+
+	// Image nodes don't get their final positions until layout has finished
+	if (!layout.IsFinished())
+	{
+		return nullptr;
+	}
+
+	if (!hasBuiltImageLoadQueue)
+	{
+		BuildImageLoadQueue();
+	}
+
+	if (!imageLoadQueue)
 	{
-		if (node && node->type == Node::Image)
+		// Either there are no images or no room for the queue, in which case they load in document order
+		for (node = lastNode ? lastNode->GetNextInTree() : nullptr; node; node = node->GetNextInTree())
 		{
-			node->Handler().LoadContent(node, loadTask);
-			return node;
+			if (node->type == Node::Image)
+			{
+				node->Handler().LoadContent(node, loadTask);
+				return node;
+			}
 		}
+		return nullptr;
+	}
+
+	// The scroll position is looked at afresh for each image, so scrolling reorders whatever is left
+	long maxDistance = -1;
+	if (MemoryManager::pageBlockAllocator.IsMemoryLow())
+	{
+		maxDistance = (long)app.ui.windowRect.height * IMAGE_LOAD_DEFER_DISTANCE_SCREENS;
 	}
 
-	return nullptr;
+	int best = -1;
+	long bestDistance = 0;
+
+	for (int n = 0; n < imageLoadQueueSize; n++)
+	{
+		long distance = GetDistanceFromViewport(imageLoadQueue[n]);
+		if (maxDistance >= 0 && distance > maxDistance)
+		{
+			continue;
+		}
+		if (best == -1 || distance < bestDistance)
+		{
+			best = n;
+			bestDistance = distance;
+			if (!distance)
+				break;
+		}
+	}
+
+	hasDeferredImageLoads = best == -1 && imageLoadQueueSize > 0;
+	deferredScrollPositionY = app.ui.GetScrollPositionY();
+
+	if (best == -1)
+	{
+		return nullptr;
+	}
+
+	node = imageLoadQueue[best];
+	imageLoadQueueSize--;
+	memmove(imageLoadQueue + best, imageLoadQueue + best + 1, sizeof(Node*) * (imageLoadQueueSize - best));
+
+	node->Handler().LoadContent(node, loadTask);
+	return node;
 }
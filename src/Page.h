@@ -44,8 +44,12 @@ public:
 
 	App& GetApp() { return app; }
 
+	// Starts loading whichever pending image is nearest the part of the page being viewed
 	Node* ProcessNextLoadTask(Node* lastNode, struct LoadTask& loadTask);
 
+	// Images were held back for lack of memory and the page has since been scrolled
+	bool ShouldRetryDeferredImageLoads();
+
 	ColourScheme colourScheme;
 
 private:
@@ -53,6 +57,9 @@ private:
 
 	void DebugDumpNodeGraph(Node* node, int depth = 0);
 
+	void BuildImageLoadQueue();
+	long GetDistanceFromViewport(Node* node);
+
 	App& app;
 
 	char* title;
@@ -67,6 +74,13 @@ private:
 
 	char textBuffer[MAX_TEXT_BUFFER_SIZE];
 	int textBufferSize;
+
+	// Images that haven't been loaded yet, in document order
+	Node** imageLoadQueue;
+	int imageLoadQueueSize;
+	bool hasBuiltImageLoadQueue;
+	bool hasDeferredImageLoads;
+	int deferredScrollPositionY;
 };
 
 #endif
@@ -39,6 +39,8 @@ HTMLParser::HTMLParser(Page& inPage)
 , contextStackSize(0)
 , parseState(ParseText)
 , textBufferSize(0)
+, skipTerminator(NULL)
+, skipMatchLength(0)
 , parsingUnicode(false)
 , preformatted(0)
 , internalEnabled(false)
@@ -49,6 +51,7 @@ void HTMLParser::Reset()
 {
 	parseState = ParseText;
 	textBufferSize = 0;
+	skipMatchLength = 0;
 	preformatted = 0;
 	internalEnabled = false;
 	SetTextEncoding(TextEncoding::UTF8);
@@ -579,7 +582,7 @@ void HTMLParser::ReplaceAmpersandEscapeSequences(char* buffer, bool replaceNonBr
 									matching = false;
 									break;
 								}
-								if (tolower(buffer[i]) != tolower(escapeSequence[i]))
+								if (tolower((unsigned char) buffer[i]) != tolower((unsigned char) escapeSequence[i]))
 								{
 									matching = false;
 									break;
@@ -626,10 +629,139 @@ void HTMLParser::Write(const char* str)
 	Parse((char*) str, strlen(str));
 }
 
+// Fast path for the ParseText state: copies a run of plain ASCII text straight into the
+// text buffer, collapsing whitespace as it goes. Stops at the next tag, escape sequence or
+// encoded character (or line break when preformatted) so that ParseChar can deal with it.
+// Returns the number of bytes consumed
+size_t HTMLParser::ParseTextRun(const char* buffer, size_t count)
+{
+	const char* s = buffer;
+	const char* end = buffer + count;
+	size_t size = textBufferSize;
+
+	while (s < end)
+	{
+		char c = *s;
+		if (c == '<' || c == '&' || (c & 0x80))
+		{
+			break;
+		}
+
+		if (IsWhiteSpace(c))
+		{
+			if (preformatted)
+			{
+				if (c == '\n')
+				{
+					break;
+				}
+				if (c == '\r')
+				{
+					s++;
+					continue;
+				}
+			}
+			else
+			{
+				if (size == 0 || IsWhiteSpace(textBuffer[size - 1]))
+				{
+					s++;
+					continue;
+				}
+				c = ' ';
+			}
+		}
+
+		if (size == sizeof(textBuffer) - 1)
+		{
+			textBufferSize = size;
+			FlushTextBuffer();
+			size = textBufferSize;
+		}
+		textBuffer[size++] = c;
+		s++;
+	}
+
+	textBufferSize = size;
+	return s - buffer;
+}
+
+// Discards the contents of a script or style section without decoding or buffering them,
+// just looking for the closing tag. The match position is kept between calls so that the
+// closing tag can be split across buffers. Once found, the tag name is put in the text
+// buffer and parsing carries on in the ParseTag state. Returns the number of bytes consumed
+size_t HTMLParser::SkipSectionRun(const char* buffer, size_t count)
+{
+	const char* s = buffer;
+	const char* end = buffer + count;
+
+	while (s < end)
+	{
+		if (skipMatchLength == 0)
+		{
+			s = (const char*) memchr(s, '<', end - s);
+			if (!s)
+			{
+				return count;
+			}
+			s++;
+			skipMatchLength = 1;
+			continue;
+		}
+
+		char c = *s++;
+		if (!skipTerminator[skipMatchLength])
+		{
+			// The whole name has matched, but it must end there so that e.g. </scripts doesn't count.
+			// The character after it is left for ParseTag
+			if (c == '>' || c == '/' || isspace((unsigned char) c))
+			{
+				strcpy(textBuffer, skipTerminator + 1);
+				textBufferSize = skipMatchLength - 1;
+				skipMatchLength = 0;
+				parseState = ParseTag;
+				s--;
+				break;
+			}
+			skipMatchLength = (c == '<') ? 1 : 0;
+		}
+		else if (tolower((unsigned char) c) == skipTerminator[skipMatchLength])
+		{
+			skipMatchLength++;
+		}
+		else
+		{
+			skipMatchLength = (c == '<') ? 1 : 0;
+		}
+	}
+
+	return s - buffer;
+}
+
 void HTMLParser::Parse(char* buffer, size_t count)
 {
 	while (count && MemoryManager::pageAllocator.GetError() == LinearAllocator::Error_None)
 	{
+		if (parseState == ParseSkipSection)
+		{
+			size_t skipLength = SkipSectionRun(buffer, count);
+			buffer += skipLength;
+			count -= skipLength;
+			continue;
+		}
+
+		if (parseState == ParseText)
+		{
+			size_t runLength = ParseTextRun(buffer, count);
+			if (runLength)
+			{
+				buffer += runLength;
+				count -= runLength;
+				parsingUnicode = false;
+				continue;
+			}
+		}
+
 		char c = *buffer++;
 		count--;
 
@@ -842,7 +974,22 @@ void HTMLParser::ParseChar(char c)
 		if(c == '>')
 		{
 			FlushTextBuffer();
-			parseState = ParseText;
+
+			// Script and style contents are never displayed so skip straight to the closing tag
+			switch (CurrentSection())
+			{
+			case SectionElement::Script:
+				skipTerminator = "</script";
+				parseState = ParseSkipSection;
+				break;
+			case SectionElement::Style:
+				skipTerminator = "</style";
+				parseState = ParseSkipSection;
+				break;
+			default:
+				parseState = ParseText;
+				break;
+			}
 		}
 		else
 		{
@@ -853,14 +1000,6 @@ void HTMLParser::ParseChar(char c)
 				parseState = ParseComment;
 				textBufferSize = 0;
 			}
-
-			// Special case when parsing script tags : we just want to look for a script closing tag
-			if (CurrentSection() == SectionElement::Script && textBufferSize >= 7 && strnicmp(textBuffer, "/script", 7))
-			{
-				textBufferSize = 0;
-				textBuffer[0] = '\0';
-				parseState = ParseText;
-			}
 		}
 			
 		break;
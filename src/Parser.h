@@ -100,6 +100,8 @@ public:
 
 private:
 	void ParseChar(char c);
+	size_t ParseTextRun(const char* buffer, size_t count);
+	size_t SkipSectionRun(const char* buffer, size_t count);
 
 	//HTMLNode* CreateNode(HTMLNode::NodeType nodeType, HTMLNode* parentNode);
 	void AppendTextBuffer(char c);
@@ -115,6 +117,7 @@ private:
 		ParseTag,
 		ParseAmpersandEscape,
 		ParseComment,
+		ParseSkipSection,
 		ParseFinished
 	};
 	
@@ -122,6 +125,10 @@ private:
 	char textBuffer[2560];
 	size_t textBufferSize;
 	int escapeSequenceStartIndex;
+
+	// Closing tag being searched for while skipping the contents of a script or style section
+	const char* skipTerminator;
+	int skipMatchLength;
 	
 	Stack<HTMLParseContext> contextStack;
 	int contextStackSize;
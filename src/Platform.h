@@ -24,6 +24,17 @@ struct Image;
 class DrawSurface;
 struct VideoModeInfo;
 
+#ifndef PATH_SEPARATOR
+#define PATH_SEPARATOR "\\"
+#endif
+
+// Requests the network driver can have in flight at once
+#ifdef HP95LX
+#define MAX_CONCURRENT_HTTP_REQUESTS 1
+#else
+#define MAX_CONCURRENT_HTTP_REQUESTS 2
+#endif
+
 struct PlatformConfig
 {
 	int vidMode;
@@ -121,6 +132,7 @@ public:
 
 	static void SaveConfig();
 	static const char* InstallPath();
+	static bool MakeDirectory(const char* path);
 
 	static VideoDriver* video;
 	static NetworkDriver* network;
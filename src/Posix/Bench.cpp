@@ -0,0 +1,729 @@
+//
+// Copyright (C) 2021 James Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+
+// End-to-end page load benchmark. Each page is pushed through the same
+// steps as App::Run (LoadTask -> HTMLParser::Parse -> Layout::Update ->
+// PageRenderer::Update) on the headless platform, timing each stage.
+//
+// Usage: microweb-bench [options]
+//   -examples=<dir>  directory of example pages (default: ../../examples)
+//   -corpus=<dir>    additional directory of pages to load
+//   -repeat=<n>      load each page n times and report the mean
+//   -csv=<file>      write results as CSV (default: stdout)
+//   -json=<file>     write results as JSON
+//   -noimages        do not load images
+//   -mode=<n>        video mode, as for the main executable
+//   -text            time 1bpp text drawing for each font, with and without the glyph cache,
+//                    instead of loading pages
+//   -gif             time decoding of the .gif files in the example and corpus directories,
+//                    instead of loading pages
+//   -relayout        load each page once, then time laying it out again at a range of window
+//                    widths, as happens when the window is resized
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <time.h>
+#include "../Platform.h"
+#include "../App.h"
+#include "../Node.h"
+#include "../Nodes/Text.h"
+#include "../Memory/Memory.h"
+#include "../DataPack.h"
+#include "../Draw/Surf1bpp.h"
+#include "../Image/Decoder.h"
+#include "../Image/Image.h"
+
+#define MAX_BENCHMARK_PAGES 256
+#define MAX_BENCHMARK_FRAMES 1000000
+
+#define GIF_BENCHMARK_CHUNK_SIZE 1024
+
+#define TEXT_BENCHMARK_WIDTH 640
+#define TEXT_BENCHMARK_STRIDE (TEXT_BENCHMARK_WIDTH / 8 + 8)
+#define TEXT_BENCHMARK_LINES 64
+#define TEXT_BENCHMARK_ITERATIONS 2000
+
+#define RELAYOUT_BENCHMARK_ITERATIONS 20
+
+struct PageLoadResult
+{
+	char path[MAX_URL_LENGTH];
+	bool loaded;
+	long bytes;
+	long nodes;
+	long frames;
+
+	double loadTime;
+	double parseTime;
+	double contentTime;
+	double layoutTime;
+	double renderTime;
+	double totalTime;
+
+	long pageAllocatorUsed;
+	long pageBlockAllocated;
+};
+
+static double GetTimeMs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static const char* GetOption(const char* arg, const char* option)
+{
+	size_t length = strlen(option);
+	if (!strncmp(arg, option, length))
+	{
+		return arg + length;
+	}
+	return NULL;
+}
+
+static bool IsHTMLFile(const char* name)
+{
+	const char* extension = strrchr(name, '.');
+	return extension && (!stricmp(extension, ".htm") || !stricmp(extension, ".html"));
+}
+
+static bool IsGIFFile(const char* name)
+{
+	const char* extension = strrchr(name, '.');
+	return extension && !stricmp(extension, ".gif");
+}
+
+static int ComparePaths(const void* a, const void* b)
+{
+	return strcmp(*(const char**)a, *(const char**)b);
+}
+
+class PageLoadBenchmark
+{
+public:
+	PageLoadBenchmark(App& inApp) : app(inApp), numPages(0) {}
+
+	void Init() { app.Init(); }
+	void AddDirectory(const char* path, bool (*filter)(const char* name) = IsHTMLFile);
+	void RunAll(int repeat);
+	void RunGIFDecode(int repeat);
+	void RunRelayout(int repeat);
+	void WriteCSV(FILE* fs);
+	void WriteJSON(FILE* fs);
+
+	int NumPages() { return numPages; }
+
+private:
+	bool LoadPage(const char* path, PageLoadResult& result);
+	long CountNodes();
+	unsigned long LayoutChecksum();
+
+	App& app;
+	char* pages[MAX_BENCHMARK_PAGES];
+	PageLoadResult results[MAX_BENCHMARK_PAGES];
+	int numPages;
+};
+
+void PageLoadBenchmark::AddDirectory(const char* path, bool (*filter)(const char* name))
+{
+	DIR* dir = opendir(path);
+	if (!dir)
+	{
+		fprintf(stderr, "Could not open directory: %s\n", path);
+		return;
+	}
+
+	int firstPage = numPages;
+	struct dirent* entry;
+	while ((entry = readdir(dir)) != NULL && numPages < MAX_BENCHMARK_PAGES)
+	{
+		if (filter(entry->d_name))
+		{
+			char pagePath[MAX_URL_LENGTH];
+			snprintf(pagePath, MAX_URL_LENGTH, "%s" PATH_SEPARATOR "%s", path, entry->d_name);
+			pages[numPages++] = strdup(pagePath);
+		}
+	}
+	closedir(dir);
+
+	qsort(pages + firstPage, numPages - firstPage, sizeof(char*), ComparePaths);
+}
+
+long PageLoadBenchmark::CountNodes()
+{
+	long count = 0;
+	for (Node* node = app.page.GetRootNode(); node; node = node->GetNextInTree())
+	{
+		count++;
+	}
+	return count;
+}
+
+// Covers the position and size of every node, so that changes to layout can be checked against earlier builds
+unsigned long PageLoadBenchmark::LayoutChecksum()
+{
+	unsigned long checksum = 0;
+	for (Node* node = app.page.GetRootNode(); node; node = node->GetNextInTree())
+	{
+		checksum = (checksum << 5) - checksum + (uint16_t)node->anchor.x;
+		checksum = (checksum << 5) - checksum + (uint16_t)node->anchor.y;
+		checksum = (checksum << 5) - checksum + (uint16_t)node->size.x;
+		checksum = (checksum << 5) - checksum + (uint16_t)node->size.y;
+
+		if (node->type == Node::Text)
+		{
+			for (TextLineIterator it(static_cast<TextElement::Data*>(node->data)); it.Get(); it.Next())
+			{
+				TextElement::Line* line = it.Get();
+				checksum = (checksum << 5) - checksum + (uint16_t)line->position.x;
+				checksum = (checksum << 5) - checksum + (uint16_t)line->position.y;
+				checksum = (checksum << 5) - checksum + (uint16_t)line->width;
+			}
+		}
+	}
+	return checksum & 0xffffffff;
+}
+
+bool PageLoadBenchmark::LoadPage(const char* path, PageLoadResult& result)
+{
+	memset(&result, 0, sizeof(PageLoadResult));
+	strncpy(result.path, path, MAX_URL_LENGTH - 1);
+
+	app.StopLoad();
+	app.RequestNewPage(path);
+
+	double startTime = GetTimeMs();
+	double time;
+
+	while (result.frames < MAX_BENCHMARK_FRAMES)
+	{
+		result.frames++;
+
+		Platform::Update();
+
+		if (app.pageLoadTask.HasContent())
+		{
+			if (app.requestedNewPage)
+			{
+				app.StartNewPage();
+			}
+
+			time = GetTimeMs();
+			size_t bytesRead = app.pageLoadTask.GetContent(app.loadBuffer, APP_LOAD_BUFFER_SIZE);
+			result.loadTime += GetTimeMs() - time;
+
+			if (bytesRead)
+			{
+				result.bytes += bytesRead;
+
+				time = GetTimeMs();
+				app.parser.Parse(app.loadBuffer, bytesRead);
+				result.parseTime += GetTimeMs() - time;
+			}
+		}
+		else if (app.requestedNewPage)
+		{
+			// Page could not be opened
+			app.requestedNewPage = false;
+			return false;
+		}
+		else if (!app.parser.IsFinished())
+		{
+			time = GetTimeMs();
+			app.parser.Finish();
+			result.parseTime += GetTimeMs() - time;
+		}
+
+		time = GetTimeMs();
+		app.UpdateContentLoadTask();
+		app.UpdateImageProbeTasks();
+		result.contentTime += GetTimeMs() - time;
+
+		time = GetTimeMs();
+		app.page.layout.Update();
+		result.layoutTime += GetTimeMs() - time;
+
+		time = GetTimeMs();
+		app.pageRenderer.Update();
+		result.renderTime += GetTimeMs() - time;
+
+		app.ui.Update();
+
+		if (app.parser.IsFinished() && !app.pageLoadTask.IsBusy() && !app.pageContentLoadTask.IsBusy()
+			&& !app.loadTaskTargetNode && app.page.layout.IsFinished() && !app.pageRenderer.IsRendering())
+		{
+			break;
+		}
+	}
+
+	result.totalTime = GetTimeMs() - startTime;
+	result.nodes = CountNodes();
+	result.pageAllocatorUsed = MemoryManager::pageAllocator.TotalUsed();
+	result.pageBlockAllocated = MemoryManager::pageBlockAllocator.TotalAllocated();
+	result.loaded = true;
+	return true;
+}
+
+void PageLoadBenchmark::RunAll(int repeat)
+{
+	for (int n = 0; n < numPages; n++)
+	{
+		PageLoadResult& total = results[n];
+		PageLoadResult run;
+
+		for (int i = 0; i < repeat; i++)
+		{
+			if (!LoadPage(pages[n], run))
+			{
+				fprintf(stderr, "Could not load page: %s\n", pages[n]);
+				total = run;
+				break;
+			}
+
+			if (i == 0)
+			{
+				total = run;
+			}
+			else
+			{
+				total.loadTime += run.loadTime;
+				total.parseTime += run.parseTime;
+				total.contentTime += run.contentTime;
+				total.layoutTime += run.layoutTime;
+				total.renderTime += run.renderTime;
+				total.totalTime += run.totalTime;
+			}
+		}
+
+		if (total.loaded && repeat > 1)
+		{
+			total.loadTime /= repeat;
+			total.parseTime /= repeat;
+			total.contentTime /= repeat;
+			total.layoutTime /= repeat;
+			total.renderTime /= repeat;
+			total.totalTime /= repeat;
+		}
+
+		fprintf(stderr, "%s: %.3f ms\n", pages[n], total.totalTime);
+	}
+}
+
+// Decodes each GIF in memory, as it would arrive from the network in chunks. The checksum covers
+// the decoded lines so that changes to the decoder can be checked against earlier builds
+void PageLoadBenchmark::RunGIFDecode(int repeat)
+{
+	double totalBytes = 0;
+	double totalTime = 0;
+
+	printf("file,bytes,width,height,decode_ms,mb_per_sec,checksum\n");
+
+	for (int n = 0; n < numPages; n++)
+	{
+		FILE* fs = fopen(pages[n], "rb");
+		if (!fs)
+		{
+			fprintf(stderr, "Could not open %s\n", pages[n]);
+			continue;
+		}
+		fseek(fs, 0, SEEK_END);
+		long length = ftell(fs);
+		fseek(fs, 0, SEEK_SET);
+		uint8_t* data = (uint8_t*)malloc(length);
+		if (!data || fread(data, 1, length, fs) != (size_t)length)
+		{
+			fprintf(stderr, "Could not read %s\n", pages[n]);
+			fclose(fs);
+			free(data);
+			continue;
+		}
+		fclose(fs);
+
+		Image image;
+		bool decoded = false;
+		double decodeTime = 0;
+
+		for (int i = 0; i < repeat; i++)
+		{
+			MemoryManager::pageAllocator.Reset();
+			MemoryManager::pageBlockAllocator.Reset();
+			image = Image();
+
+			ImageDecoder* decoder = ImageDecoder::Create(ImageDecoder::Gif);
+			double startTime = GetTimeMs();
+			decoder->Begin(&image, false);
+
+			for (long offset = 0; offset < length && decoder->GetState() == ImageDecoder::Decoding; offset += GIF_BENCHMARK_CHUNK_SIZE)
+			{
+				long chunkLength = length - offset;
+				if (chunkLength > GIF_BENCHMARK_CHUNK_SIZE)
+				{
+					chunkLength = GIF_BENCHMARK_CHUNK_SIZE;
+				}
+				decoder->Process(data + offset, chunkLength);
+			}
+
+			decodeTime += GetTimeMs() - startTime;
+			decoded = decoder->GetState() == ImageDecoder::Success;
+		}
+		decodeTime /= repeat;
+
+		unsigned long checksum = 0;
+		if (decoded && image.strips.IsAllocated())
+		{
+			ImageLineIterator lines(&image, 0);
+			for (int y = 0; y < image.height; y++, lines.Next())
+			{
+				uint8_t* line = lines.Get();
+				for (int x = 0; x < image.pitch; x++)
+				{
+					checksum = (checksum << 5) - checksum + line[x];
+				}
+			}
+		}
+
+		double megabytesPerSecond = decodeTime > 0 ? (length / (1024.0 * 1024.0)) / (decodeTime / 1000.0) : 0;
+		printf("%s,%ld,%d,%d,%.3f,%.2f,%s%08lx\n", pages[n], length, image.width, image.height, decodeTime, megabytesPerSecond,
+			decoded ? "" : "failed:", checksum & 0xffffffff);
+
+		if (decoded)
+		{
+			totalBytes += length;
+			totalTime += decodeTime;
+		}
+
+		free(data);
+	}
+
+	if (totalTime > 0)
+	{
+		fprintf(stderr, "Decoded %.0f bytes in %.3f ms: %.2f MB/s\n", totalBytes, totalTime, (totalBytes / (1024.0 * 1024.0)) / (totalTime / 1000.0));
+	}
+
+	MemoryManager::pageAllocator.Reset();
+	MemoryManager::pageBlockAllocator.Reset();
+}
+
+void PageLoadBenchmark::RunRelayout(int repeat)
+{
+	static const int widthPercentages[] = { 100, 75, 50, 90, 60 };
+	const int numWidths = sizeof(widthPercentages) / sizeof(int);
+	int windowWidth = app.ui.windowRect.width;
+	double totalTime = 0;
+
+	printf("page,nodes,relayout_ms,checksum\n");
+
+	for (int n = 0; n < numPages; n++)
+	{
+		PageLoadResult result;
+		if (!LoadPage(pages[n], result))
+		{
+			fprintf(stderr, "Could not load page: %s\n", pages[n]);
+			continue;
+		}
+
+		unsigned long checksum = 0;
+		double startTime = GetTimeMs();
+
+		for (int i = 0; i < repeat * RELAYOUT_BENCHMARK_ITERATIONS; i++)
+		{
+			for (int w = 0; w < numWidths; w++)
+			{
+				app.ui.windowRect.width = windowWidth * widthPercentages[w] / 100;
+				app.page.layout.RecalculateLayout();
+				if (i == 0)
+				{
+					checksum = (checksum << 5) - checksum + LayoutChecksum();
+				}
+			}
+		}
+
+		double time = (GetTimeMs() - startTime) / (repeat * RELAYOUT_BENCHMARK_ITERATIONS * numWidths);
+		totalTime += time;
+		app.ui.windowRect.width = windowWidth;
+
+		printf("%s,%ld,%.4f,%08lx\n", pages[n], result.nodes, time, checksum & 0xffffffff);
+	}
+
+	fprintf(stderr, "Mean relayout time: %.4f ms\n", numPages ? totalTime / numPages : 0);
+}
+
+static double BytesPerSecond(const PageLoadResult& result)
+{
+	return result.parseTime > 0 ? (result.bytes * 1000.0) / result.parseTime : 0;
+}
+
+void PageLoadBenchmark::WriteCSV(FILE* fs)
+{
+	fprintf(fs, "page,loaded,bytes,nodes,frames,load_ms,parse_ms,content_ms,layout_ms,render_ms,total_ms,parse_bytes_per_sec,page_allocator_used,page_block_allocated\n");
+
+	for (int n = 0; n < numPages; n++)
+	{
+		PageLoadResult& result = results[n];
+		fprintf(fs, "%s,%d,%ld,%ld,%ld,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.0f,%ld,%ld\n",
+			result.path, result.loaded ? 1 : 0, result.bytes, result.nodes, result.frames,
+			result.loadTime, result.parseTime, result.contentTime, result.layoutTime, result.renderTime, result.totalTime,
+			BytesPerSecond(result), result.pageAllocatorUsed, result.pageBlockAllocated);
+	}
+}
+
+void PageLoadBenchmark::WriteJSON(FILE* fs)
+{
+	fprintf(fs, "[\n");
+
+	for (int n = 0; n < numPages; n++)
+	{
+		PageLoadResult& result = results[n];
+		fprintf(fs, "  { \"page\": \"");
+		for (const char* c = result.path; *c; c++)
+		{
+			if (*c == '"' || *c == '\\')
+			{
+				fputc('\\', fs);
+			}
+			fputc(*c, fs);
+		}
+		fprintf(fs, "\", \"loaded\": %s, \"bytes\": %ld, \"nodes\": %ld, \"frames\": %ld, "
+			"\"load_ms\": %.3f, \"parse_ms\": %.3f, \"content_ms\": %.3f, \"layout_ms\": %.3f, \"render_ms\": %.3f, \"total_ms\": %.3f, "
+			"\"parse_bytes_per_sec\": %.0f, \"page_allocator_used\": %ld, \"page_block_allocated\": %ld }%s\n",
+			result.loaded ? "true" : "false", result.bytes, result.nodes, result.frames,
+			result.loadTime, result.parseTime, result.contentTime, result.layoutTime, result.renderTime, result.totalTime,
+			BytesPerSecond(result), result.pageAllocatorUsed, result.pageBlockAllocated,
+			n < numPages - 1 ? "," : "");
+	}
+
+	fprintf(fs, "]\n");
+}
+
+// Draws each string at all 8 bit positions, returning the time taken in milliseconds
+static double TimeDrawString(DrawSurface_1BPP& surface, Font* font, FontStyle::Type style, int repeat)
+{
+	static const char* sampleText[] =
+	{
+		"The quick brown fox jumps over the lazy dog",
+		"MicroWeb 1.0 - <http://example.com/index.html>",
+		"0123456789 !\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~"
+	};
+
+	DrawContext context(&surface, 0, 0, surface.width, surface.height);
+	double startTime = GetTimeMs();
+
+	for (int n = 0; n < repeat * TEXT_BENCHMARK_ITERATIONS; n++)
+	{
+		for (int phase = 0; phase < 8; phase++)
+		{
+			const char* text = sampleText[(n + phase) % 3];
+			surface.DrawString(context, font, text, phase, 0, 1, style);
+			surface.DrawString(context, font, text, phase, 0, 0, style);
+		}
+	}
+
+	return GetTimeMs() - startTime;
+}
+
+static void RunTextBenchmark(int repeat)
+{
+	DrawSurface_1BPP surface(TEXT_BENCHMARK_WIDTH, TEXT_BENCHMARK_LINES);
+	uint8_t* buffer = new uint8_t[TEXT_BENCHMARK_STRIDE * TEXT_BENCHMARK_LINES];
+	memset(buffer, 0, TEXT_BENCHMARK_STRIDE * TEXT_BENCHMARK_LINES);
+	for (int y = 0; y < TEXT_BENCHMARK_LINES; y++)
+	{
+		surface.lines[y] = buffer + y * TEXT_BENCHMARK_STRIDE;
+	}
+
+	static const FontStyle::Type styles[] = { FontStyle::Regular, FontStyle::Bold, FontStyle::Italic };
+	static const char* styleNames[] = { "regular", "bold", "italic" };
+
+	printf("font,style,glyph_height,uncached_ms,cached_ms,speedup\n");
+
+	for (int monospace = 0; monospace < 2; monospace++)
+	{
+		for (int size = 0; size < NUM_FONT_SIZES; size++)
+		{
+			Font* font = monospace ? Assets.monoFonts[size] : Assets.fonts[size];
+			if (!font)
+			{
+				continue;
+			}
+
+			for (int s = 0; s < 3; s++)
+			{
+				App::config.glyphCache = false;
+				double uncachedTime = TimeDrawString(surface, font, styles[s], repeat);
+
+				App::config.glyphCache = true;
+				double cachedTime = TimeDrawString(surface, font, styles[s], repeat);
+
+				printf("%s%d,%s,%d,%.3f,%.3f,%.2f\n", monospace ? "mono" : "proportional", size, styleNames[s], font->glyphHeight,
+					uncachedTime, cachedTime, cachedTime > 0 ? uncachedTime / cachedTime : 0);
+			}
+		}
+	}
+
+	fprintf(stderr, "Glyph cache: %ld bytes\n", GlyphCache::Get().TotalAllocated());
+
+	delete[] buffer;
+}
+
+int main(int argc, char* argv[])
+{
+	const char* examplesPath = NULL;
+	const char* corpusPath = NULL;
+	const char* csvPath = NULL;
+	const char* jsonPath = NULL;
+	int repeat = 1;
+	bool textBenchmark = false;
+	bool gifBenchmark = false;
+	bool relayoutBenchmark = false;
+
+	App::config.loadImages = true;
+	App::config.useSwap = false;
+	App::config.useEMS = false;
+	App::config.glyphCache = true;
+
+	for (int n = 1; n < argc; n++)
+	{
+		const char* value;
+		if ((value = GetOption(argv[n], "-examples=")))
+		{
+			examplesPath = value;
+		}
+		else if ((value = GetOption(argv[n], "-corpus=")))
+		{
+			corpusPath = value;
+		}
+		else if ((value = GetOption(argv[n], "-repeat=")))
+		{
+			repeat = atoi(value);
+			if (repeat < 1)
+			{
+				repeat = 1;
+			}
+		}
+		else if ((value = GetOption(argv[n], "-csv=")))
+		{
+			csvPath = value;
+		}
+		else if ((value = GetOption(argv[n], "-json=")))
+		{
+			jsonPath = value;
+		}
+		else if (!stricmp(argv[n], "-noimages"))
+		{
+			App::config.loadImages = false;
+		}
+		else if (!stricmp(argv[n], "-text"))
+		{
+			textBenchmark = true;
+		}
+		else if (!stricmp(argv[n], "-gif"))
+		{
+			gifBenchmark = true;
+		}
+		else if (!stricmp(argv[n], "-relayout"))
+		{
+			relayoutBenchmark = true;
+		}
+	}
+
+	if (!Platform::Init(argc, argv))
+	{
+		return 1;
+	}
+
+	if (textBenchmark)
+	{
+		RunTextBenchmark(repeat);
+		Platform::Shutdown();
+		return 0;
+	}
+
+	App* app = new App();
+	if (!app)
+	{
+		Platform::FatalError("Error allocating memory for application");
+	}
+
+	PageLoadBenchmark* benchmark = new PageLoadBenchmark(*app);
+	benchmark->Init();
+
+	char defaultExamplesPath[_MAX_PATH];
+	if (!examplesPath)
+	{
+		snprintf(defaultExamplesPath, _MAX_PATH, "%s" PATH_SEPARATOR ".." PATH_SEPARATOR ".." PATH_SEPARATOR "examples", Platform::InstallPath());
+		examplesPath = defaultExamplesPath;
+	}
+	bool (*filter)(const char* name) = gifBenchmark ? IsGIFFile : IsHTMLFile;
+	benchmark->AddDirectory(examplesPath, filter);
+
+	if (corpusPath)
+	{
+		benchmark->AddDirectory(corpusPath, filter);
+	}
+
+	if (!benchmark->NumPages())
+	{
+		Platform::FatalError("No pages to load");
+	}
+
+	if (gifBenchmark)
+	{
+		benchmark->RunGIFDecode(repeat);
+		Platform::Shutdown();
+		return 0;
+	}
+
+	if (relayoutBenchmark)
+	{
+		benchmark->RunRelayout(repeat);
+		Platform::Shutdown();
+		return 0;
+	}
+
+	benchmark->RunAll(repeat);
+
+	FILE* csv = csvPath ? fopen(csvPath, "w") : stdout;
+	if (csv)
+	{
+		benchmark->WriteCSV(csv);
+		if (csv != stdout)
+		{
+			fclose(csv);
+		}
+	}
+	else
+	{
+		fprintf(stderr, "Could not write %s\n", csvPath);
+	}
+
+	if (jsonPath)
+	{
+		FILE* json = fopen(jsonPath, "w");
+		if (json)
+		{
+			benchmark->WriteJSON(json);
+			fclose(json);
+		}
+		else
+		{
+			fprintf(stderr, "Could not write %s\n", jsonPath);
+		}
+	}
+
+	Platform::Shutdown();
+
+	return 0;
+}
@@ -0,0 +1,240 @@
+//
+// Copyright (C) 2021 James Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <libgen.h>
+#include <sys/stat.h>
+#include "../Platform.h"
+#include "PosixVid.h"
+#include "PosixInput.h"
+#include "PosixNet.h"
+#include "../VidModes.h"
+#include "../Memory/Memory.h"
+#include "../App.h"
+#include "../ini.h"
+
+// Headless platform for profiling and automated runs. Extra options:
+//   -mode=<n>           index into VideoModeList (otherwise from microweb.ini)
+//   -script=<file>      input script, see PosixInput.h
+//   -screenshot=<file>  write the screen to a PGM / PPM file on exit
+
+#define DEFAULT_VIDEO_MODE 7
+
+const char* const configFile = "microweb.ini";
+
+PosixVideoDriver posixVid;
+PosixNetworkDriver posixNetworkDriver;
+PosixInputDriver posixInputDriver;
+
+VideoDriver* Platform::video = &posixVid;
+NetworkDriver* Platform::network = &posixNetworkDriver;
+InputDriver* Platform::input = &posixInputDriver;
+PlatformConfig Platform::config;
+
+static char* installPath = NULL;
+static char configPath[_MAX_PATH];
+static const char* screenshotPath = NULL;
+
+#define INI_MATCH(s, n) (strcmp(section, s) == 0 && strcmp(name, n) == 0)
+
+static int ConfigHandler(void* user, const char* section, const char* name, const char* value)
+{
+	if(INI_MATCH("video", "mode"))
+	{
+		Platform::config.vidMode = atoi(value);
+	}
+	else if(INI_MATCH("cache", "enabled"))
+	{
+		Platform::config.enableCache = (strcmp(value, "true") == 0);
+	}
+	else if(INI_MATCH("cache", "size"))
+	{
+		Platform::config.cacheSize = atoi(value);
+	}
+	else if(INI_MATCH("cache", "path"))
+	{
+		strncpy(Platform::config.cachePath, value, _MAX_PATH - 1);
+		Platform::config.cachePath[_MAX_PATH - 1] = '\0';
+	}
+	return 1;
+}
+
+static void LoadConfig()
+{
+	Platform::config.vidMode = -1;
+	Platform::config.enableCache = false;
+	Platform::config.cacheSize = 0;
+	strcpy(Platform::config.cachePath, "cache");
+
+	ini_parse(configPath, &ConfigHandler, NULL);
+}
+
+static const char* GetOption(const char* arg, const char* option)
+{
+	size_t length = strlen(option);
+	if (!strncmp(arg, option, length))
+	{
+		return arg + length;
+	}
+	return NULL;
+}
+
+bool Platform::Init(int argc, char* argv[])
+{
+	char* exePath = strdup(argv[0]);
+	installPath = strdup(dirname(exePath));
+	free(exePath);
+	snprintf(configPath, _MAX_PATH, "%s" PATH_SEPARATOR "%s", installPath, configFile);
+
+	config.enableLog = false;
+
+	LoadConfig();
+
+	const char* scriptPath = NULL;
+	int modeIndex = config.vidMode;
+
+	for (int n = 1; n < argc; n++)
+	{
+		const char* value;
+		if ((value = GetOption(argv[n], "-mode=")))
+		{
+			modeIndex = atoi(value);
+		}
+		else if ((value = GetOption(argv[n], "-script=")))
+		{
+			scriptPath = value;
+		}
+		else if ((value = GetOption(argv[n], "-screenshot=")))
+		{
+			screenshotPath = value;
+		}
+	}
+
+	VideoModeInfo* videoMode = NULL;
+	if (modeIndex < 0)
+	{
+		modeIndex = DEFAULT_VIDEO_MODE;
+	}
+	for (int i = 0; VideoModeList[i].name; ++i)
+	{
+		if (i == modeIndex) videoMode = &VideoModeList[i];
+	}
+	if (!videoMode)
+	{
+		fprintf(stderr, "Invalid video mode: %d\n", modeIndex);
+		return false;
+	}
+
+	if (scriptPath && !posixInputDriver.OpenScript(scriptPath))
+	{
+		fprintf(stderr, "Could not open script: %s\n", scriptPath);
+		return false;
+	}
+
+	network->Init();
+	video->Init(videoMode);
+	input->Init();
+
+	return true;
+}
+
+void Platform::Shutdown()
+{
+	if (screenshotPath && !posixVid.DumpScreen(screenshotPath))
+	{
+		fprintf(stderr, "Could not write screenshot: %s\n", screenshotPath);
+	}
+
+	MemoryManager::pageBlockAllocator.Shutdown();
+	input->Shutdown();
+	video->Shutdown();
+	network->Shutdown();
+}
+
+void Platform::Update()
+{
+	network->Update();
+	input->Update();
+
+	// Script commands are only run once everything triggered by the previous one has settled
+	App& app = App::Get();
+	if (!posixInputDriver.HasQueuedInput() && !app.pageRenderer.IsRendering() && !app.pageLoadTask.IsBusy() && !app.pageContentLoadTask.IsBusy() && !app.IsSpoolingImages() && app.page.layout.IsFinished())
+	{
+		if (!posixInputDriver.RunScript())
+		{
+			app.Close();
+		}
+	}
+}
+
+void Platform::FatalError(const char* message, ...)
+{
+	va_list args;
+
+	if (video)
+	{
+		video->Shutdown();
+	}
+
+	va_start(args, message);
+	vfprintf(stderr, message, args);
+	fprintf(stderr, "\n");
+	va_end(args);
+
+	MemoryManager::pageBlockAllocator.Shutdown();
+
+	exit(1);
+}
+
+void Platform::Log(const char* message, ...)
+{
+	if(!config.enableLog) return;
+
+	va_list args;
+
+	FILE *f = fopen("log.txt", "a");
+
+	va_start(args, message);
+	vfprintf(f, message, args);
+	fprintf(f, "\n");
+	va_end(args);
+
+	fclose(f);
+}
+
+void Platform::SaveConfig()
+{
+	FILE *f = fopen(configPath, "w");
+	if (!f) return;
+	fprintf(f, "[video]\n");
+	fprintf(f, "mode = %d\n", Platform::config.vidMode);
+	fprintf(f, "\n");
+	fprintf(f, "[cache]\n");
+	fprintf(f, "enabled = %s\n", (Platform::config.enableCache ? "true" : "false"));
+	fprintf(f, "size = %d\n", Platform::config.cacheSize);
+	fprintf(f, "path = %s\n", Platform::config.cachePath);
+	fclose(f);
+}
+
+const char* Platform::InstallPath()
+{
+	return installPath;
+}
+
+bool Platform::MakeDirectory(const char* path)
+{
+	return mkdir(path, 0777) == 0;
+}
@@ -0,0 +1,265 @@
+//
+// Copyright (C) 2021 James Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include "PosixInput.h"
+#include "PosixVid.h"
+#include "../KeyCodes.h"
+
+struct KeyName
+{
+	const char* name;
+	InputButtonCode code;
+};
+
+static const KeyName keyNames[] =
+{
+	{ "up", KEYCODE_ARROW_UP },
+	{ "down", KEYCODE_ARROW_DOWN },
+	{ "left", KEYCODE_ARROW_LEFT },
+	{ "right", KEYCODE_ARROW_RIGHT },
+	{ "pageup", KEYCODE_PAGE_UP },
+	{ "pagedown", KEYCODE_PAGE_DOWN },
+	{ "home", KEYCODE_HOME },
+	{ "end", KEYCODE_END },
+	{ "enter", KEYCODE_ENTER },
+	{ "esc", KEYCODE_ESCAPE },
+	{ "tab", KEYCODE_TAB },
+	{ "shifttab", KEYCODE_SHIFT_TAB },
+	{ "backspace", KEYCODE_BACKSPACE },
+	{ "delete", KEYCODE_DELETE },
+	{ "ctrl-l", KEYCODE_CTRL_L },
+	{ "f1", KEYCODE_F1 },
+	{ "f2", KEYCODE_F2 },
+	{ "f3", KEYCODE_F3 },
+	{ "f4", KEYCODE_F4 },
+	{ "f5", KEYCODE_F5 },
+	{ "f6", KEYCODE_F6 },
+	{ "f7", KEYCODE_F7 },
+	{ "f8", KEYCODE_F8 },
+	{ "f9", KEYCODE_F9 },
+	{ "f10", KEYCODE_F10 },
+	{ NULL, 0 }
+};
+
+PosixInputDriver::PosixInputDriver()
+	: script(NULL)
+	, waitFrames(0)
+	, inputQueueSize(0)
+	, currentMouseCursor(MouseCursor::Pointer)
+	, mouseX(0)
+	, mouseY(0)
+	, mouseButtons(0)
+	, lastPressButtons(0)
+	, lastReleaseButtons(0)
+	, mouseReleasePending(false)
+{
+}
+
+void PosixInputDriver::Init()
+{
+	inputQueueSize = 0;
+	mouseButtons = lastPressButtons = lastReleaseButtons = 0;
+	mouseReleasePending = false;
+}
+
+void PosixInputDriver::Shutdown()
+{
+	if (script)
+	{
+		fclose(script);
+		script = NULL;
+	}
+}
+
+void PosixInputDriver::Update()
+{
+	// Release a scripted click once the interface has seen the button go down
+	if (mouseReleasePending && (lastPressButtons & 1))
+	{
+		mouseButtons &= ~1;
+		mouseReleasePending = false;
+	}
+}
+
+bool PosixInputDriver::OpenScript(const char* filename)
+{
+	script = fopen(filename, "r");
+	return script != NULL;
+}
+
+void PosixInputDriver::GetMouseStatus(int& buttons, int& x, int& y)
+{
+	buttons = mouseButtons;
+	x = mouseX;
+	y = mouseY;
+}
+
+void PosixInputDriver::SetMousePosition(int x, int y)
+{
+	mouseX = x;
+	mouseY = y;
+}
+
+bool PosixInputDriver::GetMouseButtonPress(int& x, int& y)
+{
+	int buttons;
+	GetMouseStatus(buttons, x, y);
+	bool pressed = (buttons & 1) && !(lastPressButtons & 1);
+	lastPressButtons = buttons;
+	return pressed;
+}
+
+bool PosixInputDriver::GetMouseButtonRelease(int& x, int& y)
+{
+	int buttons;
+	GetMouseStatus(buttons, x, y);
+	bool released = !(buttons & 1) && (lastReleaseButtons & 1);
+	lastReleaseButtons = buttons;
+	return released;
+}
+
+InputButtonCode PosixInputDriver::GetKeyPress()
+{
+	if (inputQueueSize > 0)
+	{
+		InputButtonCode result = inputQueue[0];
+		inputQueueSize--;
+		memmove(inputQueue, inputQueue + 1, inputQueueSize * sizeof(InputButtonCode));
+		return result;
+	}
+	return 0;
+}
+
+void PosixInputDriver::QueueKeyPress(InputButtonCode code)
+{
+	if (code && inputQueueSize < MAX_INPUT_QUEUE_SIZE)
+	{
+		inputQueue[inputQueueSize++] = code;
+	}
+}
+
+InputButtonCode PosixInputDriver::TranslateKeyName(const char* name)
+{
+	for (int n = 0; keyNames[n].name; n++)
+	{
+		if (!stricmp(keyNames[n].name, name))
+		{
+			return keyNames[n].code;
+		}
+	}
+
+	if (name[0] && !name[1])
+	{
+		return (unsigned char) name[0];
+	}
+
+	return 0;
+}
+
+bool PosixInputDriver::RunScript()
+{
+	if (waitFrames > 0)
+	{
+		waitFrames--;
+		return true;
+	}
+
+	char line[MAX_SCRIPT_LINE_LENGTH];
+
+	while (script && fgets(line, MAX_SCRIPT_LINE_LENGTH, script))
+	{
+		char* end = line + strlen(line);
+		while (end > line && (end[-1] == '\n' || end[-1] == '\r'))
+		{
+			*--end = '\0';
+		}
+
+		char* command = line;
+		while (isspace(*command))
+		{
+			command++;
+		}
+		if (!*command || *command == '#')
+		{
+			continue;
+		}
+
+		char* args = command;
+		while (*args && !isspace(*args))
+		{
+			args++;
+		}
+		if (*args)
+		{
+			*args++ = '\0';
+			while (isspace(*args))
+			{
+				args++;
+			}
+		}
+
+		if (!stricmp(command, "key"))
+		{
+			InputButtonCode code = TranslateKeyName(args);
+			if (!code)
+			{
+				Platform::FatalError("Unknown key in script: %s", args);
+			}
+			QueueKeyPress(code);
+		}
+		else if (!stricmp(command, "type"))
+		{
+			for (char* c = args; *c; c++)
+			{
+				QueueKeyPress((unsigned char) *c);
+			}
+		}
+		else if (!stricmp(command, "move"))
+		{
+			sscanf(args, "%d %d", &mouseX, &mouseY);
+		}
+		else if (!stricmp(command, "click"))
+		{
+			sscanf(args, "%d %d", &mouseX, &mouseY);
+			mouseButtons |= 1;
+			mouseReleasePending = true;
+		}
+		else if (!stricmp(command, "screenshot"))
+		{
+			if (!static_cast<PosixVideoDriver*>(Platform::video)->DumpScreen(args))
+			{
+				Platform::FatalError("Could not write screenshot: %s", args);
+			}
+		}
+		else if (!stricmp(command, "wait"))
+		{
+			waitFrames = atoi(args);
+		}
+		else if (!stricmp(command, "quit"))
+		{
+			return false;
+		}
+		else
+		{
+			Platform::FatalError("Unknown script command: %s", command);
+		}
+
+		return true;
+	}
+
+	return false;
+}
@@ -0,0 +1,80 @@
+//
+// Copyright (C) 2021 James Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+
+#ifndef _POSIXINPUT_H_
+#define _POSIXINPUT_H_
+
+#include <stdio.h>
+#include "../Platform.h"
+
+#define MAX_INPUT_QUEUE_SIZE 64
+#define MAX_SCRIPT_LINE_LENGTH 256
+
+// Input driver fed from a script file instead of a keyboard and mouse.
+// Each line of the script is one command, run once the page is idle:
+//   key <name|char>    queue a key press (up, down, pageup, pagedown, home, end,
+//                      left, right, enter, esc, tab, backspace, delete, f1-f10)
+//   type <text>        queue each character of text
+//   move <x> <y>       move the mouse
+//   click <x> <y>      move the mouse and press / release the left button
+//   screenshot <file>  write the screen to a PGM / PPM file
+//   wait <frames>      let the main loop run for a number of idle frames
+//   quit               exit the application
+// Blank lines and lines starting with # are ignored. The application exits
+// once the script is finished.
+class PosixInputDriver : public InputDriver
+{
+public:
+	PosixInputDriver();
+
+	virtual void Init();
+	virtual void Shutdown();
+	virtual void Update();
+
+	virtual void ShowMouse() {}
+	virtual void HideMouse() {}
+
+	virtual void SetMouseCursor(MouseCursor::Type type) { currentMouseCursor = type; }
+	virtual void GetMouseStatus(int& buttons, int& x, int& y);
+	virtual void SetMousePosition(int x, int y);
+	virtual bool GetMouseButtonPress(int& x, int& y);
+	virtual bool GetMouseButtonRelease(int& x, int& y);
+
+	virtual InputButtonCode GetKeyPress();
+
+	bool OpenScript(const char* filename);
+	void QueueKeyPress(InputButtonCode code);
+	bool HasQueuedInput() { return inputQueueSize > 0 || mouseReleasePending; }
+
+	// Runs the next script command. Returns false once the script has finished
+	bool RunScript();
+
+private:
+	InputButtonCode TranslateKeyName(const char* name);
+
+	FILE* script;
+	int waitFrames;
+
+	InputButtonCode inputQueue[MAX_INPUT_QUEUE_SIZE];
+	int inputQueueSize;
+
+	MouseCursor::Type currentMouseCursor;
+	int mouseX, mouseY;
+	int mouseButtons;
+	int lastPressButtons;
+	int lastReleaseButtons;
+	bool mouseReleasePending;
+};
+
+#endif
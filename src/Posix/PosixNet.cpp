@@ -0,0 +1,279 @@
+//
+// Copyright (C) 2021 James Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "PosixNet.h"
+#include "../HTTP.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+PosixNetworkDriver::PosixNetworkDriver() : isConnected(false)
+{
+	for (int n = 0; n < MAX_CONCURRENT_HTTP_REQUESTS; n++)
+	{
+		requests[n] = NULL;
+	}
+}
+
+void PosixNetworkDriver::Init()
+{
+	// A peer closing the connection mid-send should be reported as an error, not kill the process
+	signal(SIGPIPE, SIG_IGN);
+
+	for (int n = 0; n < MAX_CONCURRENT_HTTP_REQUESTS; n++)
+	{
+		requests[n] = new HTTPRequest();
+		if (!requests[n])
+		{
+			Platform::FatalError("Could not allocate memory for HTTP request");
+		}
+	}
+
+	isConnected = true;
+}
+
+void PosixNetworkDriver::Shutdown()
+{
+	for (int n = 0; n < MAX_CONCURRENT_HTTP_REQUESTS; n++)
+	{
+		if (requests[n])
+		{
+			requests[n]->Stop();
+		}
+	}
+	HTTPRequest::CloseIdleConnections();
+	isConnected = false;
+}
+
+void PosixNetworkDriver::Update()
+{
+	for (int n = 0; n < MAX_CONCURRENT_HTTP_REQUESTS; n++)
+	{
+		if (requests[n])
+		{
+			requests[n]->Update();
+		}
+	}
+}
+
+HTTPRequest* PosixNetworkDriver::CreateRequest(char* url)
+{
+	if (isConnected)
+	{
+		for (int n = 0; n < MAX_CONCURRENT_HTTP_REQUESTS; n++)
+		{
+			if (requests[n]->GetStatus() == HTTPRequest::Stopped)
+			{
+				requests[n]->Open(url);
+				return requests[n];
+			}
+		}
+	}
+
+	return NULL;
+}
+
+void PosixNetworkDriver::DestroyRequest(HTTPRequest* request)
+{
+	if (request)
+	{
+		request->Stop();
+	}
+}
+
+// Returns zero on success, negative number is error
+int PosixNetworkDriver::ResolveAddress(const char* name, NetworkAddress address, bool sendRequest)
+{
+	struct addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+
+	// getaddrinfo() blocks, so the lookup always completes on the first call
+	struct addrinfo* result = NULL;
+	if (getaddrinfo(name, NULL, &hints, &result) != 0)
+	{
+		return -1;
+	}
+
+	int rc = -1;
+	for (struct addrinfo* addr = result; addr != NULL; addr = addr->ai_next)
+	{
+		if (addr->ai_family == AF_INET)
+		{
+			struct sockaddr_in* ipv4 = (struct sockaddr_in*) addr->ai_addr;
+			memcpy(address, &ipv4->sin_addr.s_addr, sizeof(NetworkAddress));
+			rc = 0;
+			break;
+		}
+	}
+
+	freeaddrinfo(result);
+	return rc;
+}
+
+NetworkTCPSocket* PosixNetworkDriver::CreateSocket()
+{
+	return new PosixTCPSocket();
+}
+
+void PosixNetworkDriver::DestroySocket(NetworkTCPSocket* socket)
+{
+	if (socket)
+	{
+		socket->Close();
+	}
+	delete static_cast<PosixTCPSocket*>(socket);
+}
+
+PosixTCPSocket::PosixTCPSocket() : connected(false)
+{
+	sock = socket(AF_INET, SOCK_STREAM, 0);
+
+	if (sock >= 0)
+	{
+		int flags = fcntl(sock, F_GETFL, 0);
+		if (flags < 0 || fcntl(sock, F_SETFL, flags | O_NONBLOCK) < 0)
+		{
+			Close();
+		}
+	}
+}
+
+int PosixTCPSocket::Send(uint8_t* data, int length)
+{
+	if (sock < 0)
+	{
+		return -1;
+	}
+
+	int result = send(sock, data, length, MSG_NOSIGNAL);
+	if (result < 0)
+	{
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+		{
+			return 0;
+		}
+		Close();
+		return -1;
+	}
+
+	return result;
+}
+
+int PosixTCPSocket::Receive(uint8_t* buffer, int length)
+{
+	if (sock < 0)
+	{
+		return -1;
+	}
+
+	int result = recv(sock, buffer, length, 0);
+	if (result < 0)
+	{
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+		{
+			return 0;
+		}
+		Close();
+		return -1;
+	}
+	else if (result == 0 && length > 0)
+	{
+		// Remote end closed the connection
+		Close();
+		return -1;
+	}
+
+	return result;
+}
+
+int PosixTCPSocket::Connect(NetworkAddress address, int port)
+{
+	if (sock < 0)
+	{
+		return -1;
+	}
+
+	struct sockaddr_in serverAddr;
+	memset(&serverAddr, 0, sizeof(serverAddr));
+	serverAddr.sin_family = AF_INET;
+	serverAddr.sin_port = htons(port);
+	memcpy(&serverAddr.sin_addr.s_addr, address, sizeof(NetworkAddress));
+
+	if (connect(sock, (struct sockaddr*) &serverAddr, sizeof(serverAddr)) < 0 && errno != EINPROGRESS)
+	{
+		Close();
+		return -1;
+	}
+
+	return 0;
+}
+
+bool PosixTCPSocket::IsConnectComplete()
+{
+	if (sock < 0)
+	{
+		return false;
+	}
+	if (connected)
+	{
+		return true;
+	}
+
+	struct pollfd pfd;
+	pfd.fd = sock;
+	pfd.events = POLLOUT;
+	pfd.revents = 0;
+
+	if (poll(&pfd, 1, 0) > 0)
+	{
+		int error = 0;
+		socklen_t errorLength = sizeof(error);
+		if (getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &errorLength) < 0 || error != 0)
+		{
+			Close();
+			return false;
+		}
+		connected = true;
+	}
+
+	return connected;
+}
+
+bool PosixTCPSocket::IsClosed()
+{
+	return sock < 0;
+}
+
+void PosixTCPSocket::Close()
+{
+	if (sock >= 0)
+	{
+		close(sock);
+		sock = -1;
+	}
+	connected = false;
+}
@@ -0,0 +1,64 @@
+//
+// Copyright (C) 2021 James Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+
+#ifndef _POSIXNET_H_
+#define _POSIXNET_H_
+
+#include <stdint.h>
+#include "../Platform.h"
+
+class PosixTCPSocket final : public NetworkTCPSocket
+{
+public:
+	PosixTCPSocket();
+
+	virtual int Send(uint8_t* data, int length) override;
+	virtual int Receive(uint8_t* buffer, int length) override;
+	virtual int Connect(NetworkAddress address, int port) override;
+	virtual bool IsConnectComplete() override;
+	virtual bool IsClosed() override;
+	virtual void Close() override;
+
+private:
+	int sock;
+	bool connected;
+};
+
+class PosixNetworkDriver : public NetworkDriver
+{
+public:
+	PosixNetworkDriver();
+
+	virtual void Init() override;
+	virtual void Shutdown() override;
+	virtual void Update() override;
+
+	virtual bool IsConnected() override { return isConnected; }
+
+	// Returns zero on success, negative number is error
+	virtual int ResolveAddress(const char* name, NetworkAddress address, bool sendRequest) override;
+
+	virtual NetworkTCPSocket* CreateSocket() override;
+	virtual void DestroySocket(NetworkTCPSocket* socket) override;
+
+	virtual HTTPRequest* CreateRequest(char* url) override;
+	virtual void DestroyRequest(HTTPRequest* request) override;
+
+private:
+	HTTPRequest* requests[MAX_CONCURRENT_HTTP_REQUESTS];
+
+	bool isConnected;
+};
+
+#endif
@@ -0,0 +1,258 @@
+//
+// Copyright (C) 2021 James Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include "PosixVid.h"
+#include "../DataPack.h"
+#include "../Draw/Surf1bpp.h"
+#include "../Draw/Surf2bpp.h"
+#include "../Draw/Surf8bpp.h"
+#include "../VidModes.h"
+
+static const uint8_t cgaPalette[4][3] =
+{
+	{ 0x00, 0x00, 0x00 },	// Black
+	{ 0x55, 0xFF, 0xFF },	// Light cyan
+	{ 0xFF, 0x55, 0x55 },	// Light red
+	{ 0xFF, 0xFF, 0xFF },	// White
+};
+
+static const uint8_t cgaCompositePalette[16][3] =
+{
+	{ 0x00, 0x00, 0x00 },
+	{ 0x00, 0x6e, 0x31 },
+	{ 0x31, 0x09, 0xff },
+	{ 0x00, 0x8a, 0xff },
+	{ 0xa7, 0x00, 0x31 },
+	{ 0x76, 0x76, 0x76 },
+	{ 0xec, 0x11, 0xff },
+	{ 0xbb, 0x92, 0xff },
+	{ 0x31, 0x5a, 0x00 },
+	{ 0x00, 0xdb, 0x00 },
+	{ 0x76, 0x76, 0x76 },
+	{ 0x45, 0xf7, 0xbb },
+	{ 0xec, 0x63, 0x00 },
+	{ 0xbb, 0xe4, 0x00 },
+	{ 0xff, 0x7f, 0xbb },
+	{ 0xff, 0xff, 0xff },
+};
+
+static const uint8_t egaPalette[16][3] =
+{
+	{ 0x00, 0x00, 0x00 },	// Black
+	{ 0x00, 0x00, 0xAA },	// Blue
+	{ 0x00, 0xAA, 0x00 },	// Green
+	{ 0x00, 0xAA, 0xAA },	// Cyan
+	{ 0xAA, 0x00, 0x00 },	// Red
+	{ 0xAA, 0x00, 0xAA },	// Magenta
+	{ 0xAA, 0x55, 0x00 },	// Brown
+	{ 0xAA, 0xAA, 0xAA },	// Light gray
+	{ 0x55, 0x55, 0x55 },	// Dark gray
+	{ 0x55, 0x55, 0xFF },	// Light blue
+	{ 0x55, 0xFF, 0x55 },	// Light green
+	{ 0x55, 0xFF, 0xFF },	// Light cyan
+	{ 0xFF, 0x55, 0x55 },	// Light red
+	{ 0xFF, 0x55, 0xFF },	// Light magenta
+	{ 0xFF, 0xFF, 0x55 },	// Yellow
+	{ 0xFF, 0xFF, 0xFF },	// White
+};
+
+PosixVideoDriver::PosixVideoDriver() : frameBuffer(nullptr), pitch(0)
+{
+	drawSurface = nullptr;
+	paletteLUT = nullptr;
+	videoMode = nullptr;
+}
+
+void PosixVideoDriver::Init(VideoModeInfo* inVideoMode)
+{
+	videoMode = inVideoMode;
+
+	screenWidth = videoMode->screenWidth;
+	screenHeight = videoMode->screenHeight;
+
+	Assets.LoadPreset((DataPack::Preset) videoMode->dataPackIndex);
+
+	switch (videoMode->surfaceFormat)
+	{
+	case DrawSurface::Format_1BPP:
+		drawSurface = new DrawSurface_1BPP(screenWidth, screenHeight);
+		pitch = (screenWidth + 7) / 8;
+		colourScheme = monochromeColourScheme;
+		paletteLUT = nullptr;
+		break;
+
+	case DrawSurface::Format_2BPP:
+		drawSurface = new DrawSurface_2BPP(screenWidth, screenHeight);
+		pitch = (screenWidth + 3) / 4;
+		if (videoMode->biosVideoMode == CGA_COMPOSITE_MODE)
+		{
+			colourScheme = compositeCgaColourScheme;
+			paletteLUT = compositeCgaPaletteLUT;
+		}
+		else
+		{
+			colourScheme = cgaColourScheme;
+			paletteLUT = cgaPaletteLUT;
+		}
+		break;
+
+	case DrawSurface::Format_8BPP:
+		drawSurface = new DrawSurface_8BPP(screenWidth, screenHeight);
+		pitch = screenWidth;
+		colourScheme = colourScheme666;
+
+		paletteLUT = new uint8_t[256];
+		for (int n = 0; n < 256; n++)
+		{
+			int r = (n & 0xe0);
+			int g = (n & 0x1c) << 3;
+			int b = (n & 3) << 6;
+
+			int rgbBlue = (b * 255) / 0xc0;
+			int rgbGreen = (g * 255) / 0xe0;
+			int rgbRed = (r * 255) / 0xe0;
+
+			paletteLUT[n] = RGB666(rgbRed, rgbGreen, rgbBlue);
+		}
+		break;
+
+	default:
+		// The 16 colour surfaces write to planar hardware directly, so like the
+		// Windows driver these modes are drawn to an 8bpp surface with the EGA palette
+		drawSurface = new DrawSurface_8BPP(screenWidth, screenHeight);
+		pitch = screenWidth;
+		colourScheme = egaColourScheme;
+		paletteLUT = egaPaletteLUT;
+		break;
+	}
+
+	if (!drawSurface)
+	{
+		Platform::FatalError("Could not create draw surface");
+	}
+
+	// The span fills write back the byte after the end of a span, which on real hardware lands in
+	// spare video memory, so leave a line of slack after the visible area
+	frameBuffer = new uint8_t[pitch * (screenHeight + 1)];
+	if (!frameBuffer)
+	{
+		Platform::FatalError("Could not allocate memory for frame buffer");
+	}
+
+	for (int y = 0; y < screenHeight; y++)
+	{
+		drawSurface->lines[y] = frameBuffer + y * pitch;
+	}
+
+	drawSurface->Clear();
+}
+
+void PosixVideoDriver::Shutdown()
+{
+}
+
+void PosixVideoDriver::GetPixelRGB(int x, int y, uint8_t* rgb)
+{
+	const uint8_t* line = frameBuffer + y * pitch;
+	const uint8_t* colour;
+
+	switch (drawSurface->format)
+	{
+	case DrawSurface::Format_2BPP:
+		if (videoMode->biosVideoMode == CGA_COMPOSITE_MODE)
+		{
+			// Each pair of pixels forms one 4-bit artifact colour
+			uint8_t nibble = (line[x >> 2] >> ((x & 2) ? 0 : 4)) & 0xf;
+			colour = cgaCompositePalette[nibble];
+		}
+		else
+		{
+			colour = cgaPalette[(line[x >> 2] >> ((3 - (x & 3)) * 2)) & 3];
+		}
+		break;
+
+	default:
+	{
+		uint8_t index = line[x];
+		if (index < 16)
+		{
+			colour = egaPalette[index];
+		}
+		else if (index < 16 + 6 * 6 * 6)
+		{
+			index -= 16;
+			rgb[0] = ((index / 36) * 255) / 5;
+			rgb[1] = (((index / 6) % 6) * 255) / 5;
+			rgb[2] = ((index % 6) * 255) / 5;
+			return;
+		}
+		else
+		{
+			colour = egaPalette[0];
+		}
+	}
+		break;
+	}
+
+	rgb[0] = colour[0];
+	rgb[1] = colour[1];
+	rgb[2] = colour[2];
+}
+
+bool PosixVideoDriver::DumpScreen(const char* filename)
+{
+	if (!frameBuffer)
+	{
+		return false;
+	}
+
+	FILE* fs = fopen(filename, "wb");
+	if (!fs)
+	{
+		return false;
+	}
+
+	if (drawSurface->format == DrawSurface::Format_1BPP)
+	{
+		fprintf(fs, "P5\n%d %d\n255\n", screenWidth, screenHeight);
+
+		for (int y = 0; y < screenHeight; y++)
+		{
+			const uint8_t* line = frameBuffer + y * pitch;
+			for (int x = 0; x < screenWidth; x++)
+			{
+				fputc((line[x >> 3] & (0x80 >> (x & 7))) ? 0xff : 0, fs);
+			}
+		}
+	}
+	else
+	{
+		fprintf(fs, "P6\n%d %d\n255\n", screenWidth, screenHeight);
+
+		uint8_t rgb[3];
+		for (int y = 0; y < screenHeight; y++)
+		{
+			for (int x = 0; x < screenWidth; x++)
+			{
+				GetPixelRGB(x, y, rgb);
+				fwrite(rgb, 1, 3, fs);
+			}
+		}
+	}
+
+	fclose(fs);
+	return true;
+}
@@ -0,0 +1,43 @@
+//
+// Copyright (C) 2021 James Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+
+#ifndef _POSIXVID_H_
+#define _POSIXVID_H_
+
+#include <stdint.h>
+#include "../Platform.h"
+
+// Headless video driver: draw surfaces are backed by a plain memory
+// framebuffer which can be written out as a PGM (mono) or PPM (colour) file
+class PosixVideoDriver : public VideoDriver
+{
+public:
+	PosixVideoDriver();
+
+	virtual void Init(VideoModeInfo* videoMode);
+	virtual void Shutdown();
+
+	bool DumpScreen(const char* filename);
+
+	uint8_t* GetFrameBuffer() { return frameBuffer; }
+	int GetPitch() { return pitch; }
+
+private:
+	void GetPixelRGB(int x, int y, uint8_t* rgb);
+
+	uint8_t* frameBuffer;
+	int pitch;
+};
+
+#endif
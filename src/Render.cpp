@@ -5,6 +5,213 @@
 #include "Draw/Surface.h"
 #include "DataPack.h"
 #include "Nodes/ImgNode.h"
+#include <limits.h>
+
+void RenderQueue::Reset()
+{
+	head = tail = RENDER_QUEUE_NONE;
+	count = 0;
+
+	for (int n = 0; n < MAX_RENDER_QUEUE_SIZE; n++)
+	{
+		items[n].next = (int16_t)(n + 1 < MAX_RENDER_QUEUE_SIZE ? n + 1 : RENDER_QUEUE_NONE);
+	}
+	freeList = 0;
+
+	for (int n = 0; n < RENDER_QUEUE_HASH_SIZE; n++)
+	{
+		hashTable[n] = RENDER_QUEUE_NONE;
+	}
+}
+
+static int HashNodePointer(Node* node)
+{
+	const uint8_t* bytes = (const uint8_t*)&node;
+	uint16_t hash = 0;
+
+	for (int n = 0; n < (int)sizeof(Node*); n++)
+	{
+		hash = (hash << 5) - hash + bytes[n];
+	}
+
+	return (hash ^ (hash >> 10)) & (RENDER_QUEUE_HASH_SIZE - 1);
+}
+
+// Slot holding the first item for the node, or the empty slot where it would go
+int RenderQueue::FindSlot(Node* node)
+{
+	int slot = HashNodePointer(node);
+
+	while (hashTable[slot] != RENDER_QUEUE_NONE && items[hashTable[slot]].node != node)
+	{
+		slot = (slot + 1) & (RENDER_QUEUE_HASH_SIZE - 1);
+	}
+
+	return slot;
+}
+
+// Moves later entries back into the gap so that probing never stops early
+void RenderQueue::RemoveSlot(int slot)
+{
+	int hole = slot;
+
+	for (int next = (slot + 1) & (RENDER_QUEUE_HASH_SIZE - 1); hashTable[next] != RENDER_QUEUE_NONE; next = (next + 1) & (RENDER_QUEUE_HASH_SIZE - 1))
+	{
+		int home = HashNodePointer(items[hashTable[next]].node);
+		if (((next - home) & (RENDER_QUEUE_HASH_SIZE - 1)) >= ((next - hole) & (RENDER_QUEUE_HASH_SIZE - 1)))
+		{
+			hashTable[hole] = hashTable[next];
+			hole = next;
+		}
+	}
+
+	hashTable[hole] = RENDER_QUEUE_NONE;
+}
+
+// Inserts into the draw order after anything earlier in the tree. Nodes mostly arrive in
+// tree order so the search from the tail is usually short
+void RenderQueue::Link(int16_t index)
+{
+	Item& item = items[index];
+	int16_t prev = tail;
+
+	while (prev != RENDER_QUEUE_NONE && items[prev].order > item.order)
+	{
+		prev = items[prev].prev;
+	}
+
+	item.prev = prev;
+	item.next = (prev == RENDER_QUEUE_NONE) ? head : items[prev].next;
+
+	if (item.prev == RENDER_QUEUE_NONE)
+		head = index;
+	else
+		items[item.prev].next = index;
+
+	if (item.next == RENDER_QUEUE_NONE)
+		tail = index;
+	else
+		items[item.next].prev = index;
+}
+
+void RenderQueue::Unlink(int16_t index)
+{
+	Item& item = items[index];
+
+	if (item.prev == RENDER_QUEUE_NONE)
+		head = item.next;
+	else
+		items[item.prev].next = item.next;
+
+	if (item.next == RENDER_QUEUE_NONE)
+		tail = item.prev;
+	else
+		items[item.next].prev = item.prev;
+}
+
+void RenderQueue::Add(Node* node, long position, int upperClip, int lowerClip)
+{
+	uint16_t order = (uint16_t)(position > RENDER_QUEUE_MAX_ORDER ? RENDER_QUEUE_MAX_ORDER : position);
+	int slot = FindSlot(node);
+
+	for (int16_t index = hashTable[slot]; index != RENDER_QUEUE_NONE; index = items[index].nextForNode)
+	{
+		Item& item = items[index];
+
+		if (upperClip <= item.lowerClip && lowerClip >= item.upperClip)
+		{
+			// Overlaps or touches a region already queued so grow it
+			if (upperClip < item.upperClip)
+				item.upperClip = upperClip;
+			if (lowerClip > item.lowerClip)
+				item.lowerClip = lowerClip;
+
+			if (item.order != order)
+			{
+				// Tree positions shift when nodes are inserted by a relayout
+				Unlink(index);
+				item.order = order;
+				Link(index);
+			}
+			return;
+		}
+	}
+
+	if (freeList == RENDER_QUEUE_NONE)
+	{
+		//printf("Error! Out of space in render queue!\n");
+		return;
+	}
+
+	int16_t index = freeList;
+	Item& item = items[index];
+	freeList = item.next;
+	count++;
+
+	item.node = node;
+	item.order = order;
+	item.upperClip = upperClip;
+	item.lowerClip = lowerClip;
+	item.nextForNode = hashTable[slot];
+	hashTable[slot] = index;
+
+	Link(index);
+}
+
+void RenderQueue::Remove(int16_t index)
+{
+	Item& item = items[index];
+	int slot = FindSlot(item.node);
+
+	if (hashTable[slot] == index)
+	{
+		if (item.nextForNode != RENDER_QUEUE_NONE)
+			hashTable[slot] = item.nextForNode;
+		else
+			RemoveSlot(slot);
+	}
+	else
+	{
+		int16_t prev = hashTable[slot];
+		while (items[prev].nextForNode != index)
+		{
+			prev = items[prev].nextForNode;
+		}
+		items[prev].nextForNode = item.nextForNode;
+	}
+
+	Unlink(index);
+	item.next = freeList;
+	freeList = index;
+	count--;
+}
+
+void RenderQueue::Scroll(int scrollDelta, int minY, int maxY)
+{
+	int16_t index = head;
+
+	while (index != RENDER_QUEUE_NONE)
+	{
+		Item& item = items[index];
+		int16_t next = item.next;
+
+		item.lowerClip -= scrollDelta;
+		item.upperClip -= scrollDelta;
+
+		if (item.upperClip < minY)
+			item.upperClip = minY;
+		if (item.lowerClip > maxY)
+			item.lowerClip = maxY;
+
+		if (item.lowerClip <= item.upperClip)
+		{
+			// Scrolled off screen, can remove from queue
+			Remove(index);
+		}
+
+		index = next;
+	}
+}
 
 PageRenderer::PageRenderer(App& inApp)
 	: app(inApp)
@@ -98,28 +305,7 @@ void PageRenderer::OnPageScroll(int scrollDelta)
 	int minWinX = windowRect.x;
 	int maxWinX = windowRect.x + windowRect.width;
 
-	for (int i = renderQueue.head; i < renderQueue.tail; i++)
-	{
-		RenderQueue::Item* item = &renderQueue.items[i];
-		item->lowerClip -= scrollDelta;
-		item->upperClip -= scrollDelta;
-
-		if (item->upperClip < minWinY)
-			item->upperClip = minWinY;
-		if (item->lowerClip > maxWinY)
-			item->lowerClip = maxWinY;
-
-		if (item->lowerClip <= item->upperClip)
-		{
-			// Scrolled off screen, can remove from queue
-			renderQueue.tail--;
-			for (int n = i; n < renderQueue.tail; n++)
-			{
-				renderQueue.items[n] = renderQueue.items[n + 1];
-			}
-			i--;
-		}
-	}
+	renderQueue.Scroll(scrollDelta, minWinY, maxWinY);
 
 	if (scrollDelta > 0)
 	{
@@ -172,6 +358,11 @@ bool PageRenderer::IsRenderableNode(Node* node)
 	if (node->size.IsZero())
 		return false;
 
+	return IsRenderableType(node);
+}
+
+bool PageRenderer::IsRenderableType(Node* node)
+{
 	switch (node->type)
 	{
 	case Node::Style:
@@ -203,22 +394,24 @@ void PageRenderer::FindOverlappingNodesInScreenRegion(int top, int bottom)
 	if (!lastCompleteNode)
 		return;
 
+	if (!nodeIndex.HasFailed())
+	{
+		OverlapQuery query;
+		query.renderer = this;
+		query.top = top;
+		query.bottom = bottom;
+		query.drawOffsetY = drawOffsetY;
+		nodeIndex.FindOverlapping(top - drawOffsetY, bottom - drawOffsetY, OnOverlappingNode, &query);
+		return;
+	}
+
+	// Ran out of memory for the index so have to search the whole tree
+	long order = 0;
 	for(Node* node = app.page.GetRootNode(); node; node = node->GetNextInTree())
 	{
-		if(IsRenderableNode(node))
+		if (IsRenderableType(node))
 		{
-			int nodeTop = node->anchor.y + drawOffsetY;
-			int nodeBottom = nodeTop + node->size.y;
-
-			if (nodeTop < top)
-				nodeTop = top;
-			if (nodeBottom > bottom)
-				nodeBottom = bottom;
-
-			if(nodeBottom - nodeTop > 0)
-			{
-				AddToQueue(node, nodeTop, nodeBottom);
-			}
+			AddOverlappingNode(node, order++, top, bottom, drawOffsetY);
 		}
 
 		if (node == lastCompleteNode)
@@ -226,10 +419,36 @@ void PageRenderer::FindOverlappingNodesInScreenRegion(int top, int bottom)
 	}
 }
 
+void PageRenderer::OnOverlappingNode(void* userData, Node* node, long order)
+{
+	OverlapQuery* query = (OverlapQuery*)userData;
+	query->renderer->AddOverlappingNode(node, order, query->top, query->bottom, query->drawOffsetY);
+}
+
+void PageRenderer::AddOverlappingNode(Node* node, long order, int top, int bottom, int drawOffsetY)
+{
+	if(IsRenderableNode(node))
+	{
+		int nodeTop = node->anchor.y + drawOffsetY;
+		int nodeBottom = nodeTop + node->size.y;
+
+		if (nodeTop < top)
+			nodeTop = top;
+		if (nodeBottom > bottom)
+			nodeBottom = bottom;
+
+		if(nodeBottom - nodeTop > 0)
+		{
+			AddToQueue(node, order, nodeTop, nodeBottom);
+		}
+	}
+}
+
 void PageRenderer::Reset()
 {
 	renderQueue.Reset();
 	lastCompleteNode = nullptr;
+	nodeIndex.Reset();
 	visiblePageHeight = 0;
 	isPaused = false;
 }
@@ -273,7 +492,7 @@ void PageRenderer::Update()
 	{
 		itemsToRender--;
 
-		RenderQueue::Item* item = &renderQueue.items[renderQueue.head];
+		RenderQueue::Item* item = renderQueue.Head();
 		Node* toRender = item->node;
 		bool finishedRendering = true;
 
@@ -287,7 +506,7 @@ void PageRenderer::Update()
 			const int imageLinesToRenderPerUpdate = 8;
 
 			ImageNode::Data* imageData = static_cast<ImageNode::Data*>(toRender->data);
-			if (imageData->state == ImageNode::FinishedDownloadingContent && imageData->image.lines.IsAllocated())
+			if (imageData->state == ImageNode::FinishedDownloadingContent && imageData->image.strips.IsAllocated())
 			{
 				if (itemContext.clipBottom > itemContext.clipTop + imageLinesToRenderPerUpdate)
 				{
@@ -310,74 +529,14 @@ void PageRenderer::Update()
 	}
 }	
 
-void PageRenderer::AddToQueue(Node* node, int upperClip, int lowerClip)
+void PageRenderer::AddToQueue(Node* node, long order, int upperClip, int lowerClip)
 {
 	if (lowerClip <= upperClip)
 	{
 		return;
 	}
 
-	int insertPosition = renderQueue.tail;
-
-	// Check if in queue already
-	for (int i = renderQueue.head; i < renderQueue.tail; i++)
-	{
-		RenderQueue::Item* item = &renderQueue.items[i];
-		if (item->node == node)
-		{
-			// Already in queue
-			if ((upperClip <= item->upperClip && lowerClip >= item->upperClip)
-				|| (lowerClip >= item->lowerClip && upperClip <= item->lowerClip))
-			{
-				// Grow clip region
-				if (upperClip < item->upperClip)
-				{
-					item->upperClip = upperClip;
-				}
-				if (lowerClip > item->lowerClip)
-				{
-					item->lowerClip = lowerClip;
-				}
-				return;
-			}
-		}
-		else if (item->node->IsChildOf(node))
-		{
-			if (insertPosition > i)
-			{
-				insertPosition = i;
-			}
-		}
-	}
-
-	if (renderQueue.Size() < MAX_RENDER_QUEUE_SIZE)
-	{
-		if (renderQueue.tail == MAX_RENDER_QUEUE_SIZE)
-		{
-			memcpy(renderQueue.items, renderQueue.items + renderQueue.head, renderQueue.Size() * sizeof(RenderQueue::Item));
-			renderQueue.tail -= renderQueue.head;
-			insertPosition -= renderQueue.head;
-			renderQueue.head = 0;
-		}
-
-		if (insertPosition != renderQueue.tail)
-		{
-			for (int i = renderQueue.tail; i > insertPosition; --i)
-			{
-				renderQueue.items[i] = renderQueue.items[i - 1];
-			}
-		}
-
-		RenderQueue::Item* item = &renderQueue.items[insertPosition];
-		item->node = node;
-		item->upperClip = upperClip;
-		item->lowerClip = lowerClip;
-		renderQueue.tail++;
-	}
-	else
-	{
-		//printf("Error! Out of space in render queue!\n");
-	}
+	renderQueue.Add(node, order, upperClip, lowerClip);
 }
 
 bool PageRenderer::IsInRenderQueue(Node* node)
@@ -386,16 +545,7 @@ bool PageRenderer::IsInRenderQueue(Node* node)
 	{
 		return false;
 	}
-	for (int i = renderQueue.head; i < renderQueue.tail; i++)
-	{
-		RenderQueue::Item* item = &renderQueue.items[i];
-		if (item->node == node)
-		{
-			// Already in queue
-			return true;
-		}
-	}
-	return false;
+	return renderQueue.Contains(node);
 }
 
 void PageRenderer::DrawAll(DrawContext& context, Node* node)
@@ -439,47 +589,76 @@ void PageRenderer::GenerateDrawContext(DrawContext& context, Node* node)
 	}
 }
 
-void PageRenderer::MarkNodeLayoutComplete(Node* node)
+void PageRenderer::MarkNodeLayoutComplete(Node* completedNode)
 {
+	// Containers are marked again when their own layout ends, after everything inside them
+	Node* endNode = completedNode;
+	while (endNode->firstChild)
+	{
+		endNode = endNode->firstChild;
+		while (endNode->next)
+		{
+			endNode = endNode->next;
+		}
+	}
+
 	Rect& windowRect = app.ui.windowRect;
 	int drawOffsetY = GetDrawOffsetY();
-	Node* startNode = lastCompleteNode ? lastCompleteNode->GetNextInTree() : app.page.GetRootNode();
-	lastCompleteNode = node;
-
 	int minWinY = windowRect.y;
 	int maxWinY = windowRect.y + windowRect.height;
 
 	bool expandedPage = false;
 
-	for (Node* node = startNode; node; node = node->GetNextInTree())
+	if (!endNode->isLayoutComplete)
 	{
-		node->isLayoutComplete = true;
+		Node* startNode = lastCompleteNode ? lastCompleteNode->GetNextInTree() : app.page.GetRootNode();
+		lastCompleteNode = endNode;
 
-		if (IsRenderableNode(node))
+		for (Node* node = startNode; node; node = node->GetNextInTree())
 		{
-			int nodeTop = node->anchor.y + drawOffsetY;
-			int nodeBottom = nodeTop + node->size.y;
+			node->isLayoutComplete = true;
 
-			if (node->anchor.y + node->size.y > visiblePageHeight)
+			long order = 0;
+			if (IsRenderableType(node))
 			{
-				visiblePageHeight = node->anchor.y + node->size.y;
-				expandedPage = true;
+				order = nodeIndex.Add(node);
 			}
 
-			if (nodeTop < minWinY)
-				nodeTop = minWinY;
-			if (nodeBottom > maxWinY)
-				nodeBottom = maxWinY;
-			if (nodeBottom > nodeTop)
+			if (IsRenderableNode(node))
 			{
-				AddToQueue(node, nodeTop, nodeBottom);
+				int nodeTop = node->anchor.y + drawOffsetY;
+				int nodeBottom = nodeTop + node->size.y;
+
+				if (node->anchor.y + node->size.y > visiblePageHeight)
+				{
+					visiblePageHeight = node->anchor.y + node->size.y;
+					expandedPage = true;
+				}
+
+				if (nodeTop < minWinY)
+					nodeTop = minWinY;
+				if (nodeBottom > maxWinY)
+					nodeBottom = maxWinY;
+				if (nodeBottom > nodeTop)
+				{
+					AddToQueue(node, order, nodeTop, nodeBottom);
+				}
 			}
+
+			if (node == lastCompleteNode)
+				break;
 		}
+	}
 
-		if (node == lastCompleteNode)
-			break;
+	// Containers only reach their final size once everything inside them is complete
+	if (IsRenderableNode(completedNode) && completedNode->anchor.y + completedNode->size.y > visiblePageHeight)
+	{
+		visiblePageHeight = completedNode->anchor.y + completedNode->size.y;
+		expandedPage = true;
 	}
 
+	nodeIndex.Close(completedNode);
+
 	if (expandedPage)
 	{
 		App::Get().ui.UpdatePageScrollBar();
@@ -487,15 +666,16 @@ void PageRenderer::MarkNodeLayoutComplete(Node* node)
 }
 
 void PageRenderer::MarkNodeDirty(Node* dirtyNode)
+{
+	MarkNodeRegionDirty(dirtyNode, 0, dirtyNode->size.y);
+}
+
+void PageRenderer::MarkNodeRegionDirty(Node* dirtyNode, int regionTop, int regionBottom, bool clearBackground)
 {
 	// Check this is in a completed layout
-	for (Node* node = app.page.GetRootNode(); node; node = node->GetNextInTree())
+	if (!dirtyNode->isLayoutComplete || regionBottom <= regionTop)
 	{
-		if (node == lastCompleteNode)
-			return;
-
-		if (node == dirtyNode)
-			break;
+		return;
 	}
 
 	Rect& windowRect = app.ui.windowRect;
@@ -503,8 +683,8 @@ void PageRenderer::MarkNodeDirty(Node* dirtyNode)
 	int minWinY = windowRect.y;
 	int maxWinY = windowRect.y + windowRect.height;
 
-	int nodeTop = dirtyNode->anchor.y + drawOffsetY;
-	int nodeBottom = nodeTop + dirtyNode->size.y;
+	int nodeTop = dirtyNode->anchor.y + regionTop + drawOffsetY;
+	int nodeBottom = dirtyNode->anchor.y + regionBottom + drawOffsetY;
 	bool outsideOfWindow = (nodeTop > maxWinY) || (nodeBottom < minWinY);
 
 	if (!outsideOfWindow)
@@ -513,7 +693,15 @@ void PageRenderer::MarkNodeDirty(Node* dirtyNode)
 			nodeTop = minWinY;
 		if (nodeBottom > maxWinY)
 			nodeBottom = maxWinY;
-		AddToQueue(dirtyNode, nodeTop, nodeBottom);
+		// Drawn last if it can't be found, it won't have any children to draw over
+		long order = nodeIndex.FindPosition(dirtyNode);
+		AddToQueue(dirtyNode, order == -1 ? LONG_MAX : order, nodeTop, nodeBottom);
+
+		if (!clearBackground)
+		{
+			// Drawn straight over what is there, so the region doesn't flicker to the page colour
+			return;
+		}
 
 		Platform::input->HideMouse();
 
@@ -523,7 +711,7 @@ void PageRenderer::MarkNodeDirty(Node* dirtyNode)
 		InitContext(clearContext);
 		clearContext.clipBottom = windowRect.y + windowRect.height;
 		clearContext.drawOffsetY = windowRect.y - app.ui.GetScrollPositionY();
-		clearContext.surface->FillRect(clearContext, dirtyNode->anchor.x, dirtyNode->anchor.y, dirtyNode->size.x, dirtyNode->size.y, app.page.colourScheme.pageColour);
+		clearContext.surface->FillRect(clearContext, dirtyNode->anchor.x, dirtyNode->anchor.y + regionTop, dirtyNode->size.x, regionBottom - regionTop, app.page.colourScheme.pageColour);
 
 		Platform::input->ShowMouse();
 	}
@@ -551,9 +739,79 @@ void PageRenderer::MarkPageLayoutComplete()
 			break;
 		}
 	}
+
+	nodeIndex.CloseAll();
+}
+
+// Nodes from the changed node down to pageBottom have moved, e.g. after an image was resized
+void PageRenderer::OnPageLayoutChanged(Node* changedNode, int pageBottom)
+{
+	if (!lastCompleteNode)
+	{
+		return;
+	}
+
+	int pageTop = changedNode->anchor.y;
+
+	// Nodes may also have been inserted after the changed node, e.g. alt text for a broken image, so
+	// the index is rebuilt from there. Anything before it in the tree ends above it, apart from what
+	// contains it, so the page height only needs recalculating from those
+	Node* startNode = changedNode;
+	visiblePageHeight = 0;
+	if (changedNode->parent && nodeIndex.Truncate(changedNode))
+	{
+		for (Node* parent = changedNode->parent; parent; parent = parent->parent)
+		{
+			if (IsRenderableNode(parent) && parent->anchor.y + parent->size.y > visiblePageHeight)
+			{
+				visiblePageHeight = parent->anchor.y + parent->size.y;
+			}
+		}
+	}
+	else
+	{
+		nodeIndex.Clear();
+		startNode = app.page.GetRootNode();
+	}
+
+	for (Node* node = startNode; node; node = node->GetNextInTree())
+	{
+		node->isLayoutComplete = true;
+
+		if (IsRenderableType(node))
+		{
+			nodeIndex.Add(node);
+		}
+
+		if (IsRenderableNode(node) && node->anchor.y + node->size.y > visiblePageHeight)
+		{
+			visiblePageHeight = node->anchor.y + node->size.y;
+		}
+
+		if (node == lastCompleteNode)
+			break;
+	}
+	app.ui.UpdatePageScrollBar();
+
+	Rect& windowRect = app.ui.windowRect;
+	int top = pageTop + GetDrawOffsetY();
+	long bottom = (long)pageBottom + GetDrawOffsetY();
+	if (bottom > windowRect.y + windowRect.height)
+	{
+		bottom = windowRect.y + windowRect.height;
+	}
+	if (top < bottom && bottom > windowRect.y)
+	{
+		MarkScreenRegionDirty(windowRect.x, top, windowRect.x + windowRect.width, (int)bottom);
+	}
 }
 
 void PageRenderer::InvertNode(Node* node)
+{
+	InvertRect(node->anchor.x, node->anchor.y, node->size.x, node->size.y);
+}
+
+void PageRenderer::InvertRect(int x, int y, int width, int height)
 {
 	Platform::input->HideMouse();
 	Rect& windowRect = app.ui.windowRect;
@@ -572,7 +830,7 @@ void PageRenderer::InvertNode(Node* node)
 	//}
 
 	invertContext.drawOffsetY = windowRect.y - app.ui.GetScrollPositionY();
-	invertContext.surface->InvertRect(invertContext, node->anchor.x, node->anchor.y, node->size.x, node->size.y);
+	invertContext.surface->InvertRect(invertContext, x, y, width, height);
 
 	Platform::input->ShowMouse();
 }
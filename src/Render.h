@@ -1,8 +1,10 @@
 #ifndef _RENDER_H_
 #define _RENDER_H_
 
+#include <limits.h>
 #include "Draw/Surface.h"
 #include "Node.h"
+#include "NodeIndex.h"
 
 class App;
 class Node;
@@ -10,13 +12,23 @@ struct DrawContext;
 struct Rect;
 
 #define MAX_RENDER_QUEUE_SIZE 512
-
+#define RENDER_QUEUE_HASH_SIZE 1024		// Power of two, at least twice the queue size
+#define RENDER_QUEUE_NONE -1
+#define RENDER_QUEUE_MAX_ORDER 0xffff		// Nodes further down the tree than this draw in the order they were queued
+
+// Nodes waiting to be drawn, kept in tree order so that parents draw before their children.
+// Items are linked in draw order and found by node through a hash table, so that adding
+// and removing don't need to scan or shift the whole queue. On DOS an item is 16 bytes, so
+// with the hash table this takes 10K where a plain array of node and clip range took 4K
 struct RenderQueue
 {
 	struct Item
 	{
 		Node* node;
+		uint16_t order;
 		int upperClip, lowerClip;
+		int16_t prev, next;
+		int16_t nextForNode;			// Another region of the same node that doesn't touch this one
 	};
 
 	RenderQueue()
@@ -24,30 +36,44 @@ struct RenderQueue
 		Reset();
 	}
 
-	void Reset()
+	void Reset();
+	int Size()
 	{
-		head = tail = 0;
+		return count;
 	}
-	int Size()
+	RenderQueue::Item* Head()
 	{
-		return tail - head;
+		return head == RENDER_QUEUE_NONE ? nullptr : &items[head];
 	}
-	RenderQueue::Item* Dequeue()
+	void Dequeue()
 	{
-		if (head < tail)
+		if (head != RENDER_QUEUE_NONE)
 		{
-			RenderQueue::Item* result = &items[head++];
-			if (head == tail)
-			{
-				tail = head = 0;
-			}
-			return result;
+			Remove(head);
 		}
-		return nullptr;
 	}
 
-	int head, tail;
+	void Add(Node* node, long position, int upperClip, int lowerClip);
+	bool Contains(Node* node)
+	{
+		return hashTable[FindSlot(node)] != RENDER_QUEUE_NONE;
+	}
+
+	// Moves every item by the scroll amount in one pass, dropping any that end up outside of the window
+	void Scroll(int scrollDelta, int minY, int maxY);
+
+private:
+	int FindSlot(Node* node);
+	void RemoveSlot(int slot);
+	void Link(int16_t index);
+	void Unlink(int16_t index);
+	void Remove(int16_t index);
+
+	int16_t head, tail;
+	int16_t freeList;
+	int count;
 	Item items[MAX_RENDER_QUEUE_SIZE];
+	int16_t hashTable[RENDER_QUEUE_HASH_SIZE];
 };
 
 class PageRenderer
@@ -64,15 +90,18 @@ public:
 	
 	void GenerateDrawContext(DrawContext& context, Node* node);
 
-	void AddToQueue(Node* node, int upperClip, int lowerClip);
+	void AddToQueue(Node* node, long order, int upperClip, int lowerClip);
 
 	void OnPageScroll(int scrollDelta);
 
 	void MarkNodeLayoutComplete(Node* node);
 	void MarkPageLayoutComplete();
 	void MarkNodeDirty(Node* node);
+	void MarkNodeRegionDirty(Node* node, int regionTop, int regionBottom, bool clearBackground = true);		// Lines relative to the top of the node
+	void OnPageLayoutChanged(Node* changedNode, int pageBottom = INT_MAX);
 
 	void InvertNode(Node* node);
+	void InvertRect(int x, int y, int width, int height);		// Page coordinates
 
 	int GetVisiblePageHeight() { return visiblePageHeight; }
 	bool IsRendering() { return renderQueue.Size() > 0; }
@@ -82,14 +111,24 @@ public:
 	void SetPaused(bool paused) { isPaused = paused; }
 
 private:
+	struct OverlapQuery
+	{
+		PageRenderer* renderer;
+		int top, bottom;
+		int drawOffsetY;
+	};
+
 	bool IsInRenderQueue(Node* node);
 
 	void InitContext(DrawContext& context);
 	void ClampContextToRect(DrawContext& context, Rect& rect);
 	void FindOverlappingNodesInScreenRegion(int top, int bottom);
+	void AddOverlappingNode(Node* node, long order, int top, int bottom, int drawOffsetY);
+	static void OnOverlappingNode(void* userData, Node* node, long order);
 
 	bool DoesOverlapWithContext(Node* node, DrawContext& context);
 	bool IsRenderableNode(Node* node);
+	bool IsRenderableType(Node* node);
 
 	int GetDrawOffsetY();
 
@@ -98,6 +137,7 @@ private:
 	RenderQueue renderQueue;
 
 	Node* lastCompleteNode;
+	NodeIndex nodeIndex;
 
 	int visiblePageHeight;
 	bool isPaused;
@@ -1,6 +1,7 @@
 #include <string.h>
 #include "Style.h"
 #include "Memory/Memory.h"
+#include "DataPack.h"
 
 static StylePool pool;
 
@@ -9,17 +10,30 @@ StylePool& StylePool::Get()
 	return pool;
 }
 
+uint16_t StylePool::Hash(const ElementStyle& style)
+{
+	uint32_t key;
+	memcpy(&key, &style, sizeof(key));
+	return (uint16_t)((uint32_t)(key * 2654435761ul) >> (32 - STYLE_POOL_HASH_SHIFT));
+}
+
 ElementStyleHandle StylePool::AddStyle(const ElementStyle& style)
 {
 	// Check if an identical style already exists
-	for (ElementStyleHandle n = 0; n < numItems; n++)
+	uint16_t slot = Hash(style);
+	while (hashTable[slot] != STYLE_POOL_EMPTY_SLOT)
 	{
-		if (!memcmp(&style, &GetStyle(n), sizeof(ElementStyle)))
+		ElementStyleHandle existing = hashTable[slot];
+		if (!memcmp(&style, &GetStyle(existing), sizeof(ElementStyle)))
 		{
-			return n;
+			numHits++;
+			return existing;
 		}
+		slot = (slot + 1) & STYLE_POOL_HASH_MASK;
 	}
 
+	numMisses++;
+
 	ElementStyleHandle newHandle = numItems;
 	if (newHandle >= MAX_STYLES)
 		return 0;
@@ -37,7 +51,9 @@ ElementStyleHandle StylePool::AddStyle(const ElementStyle& style)
 	}
 
 	chunks[chunkIndex]->items[itemIndex] = style;
+	Resolve(style, chunks[chunkIndex]->resolved[itemIndex]);
 	numItems++;
+	hashTable[slot] = newHandle;
 
 	return newHandle;
 }
@@ -52,7 +68,51 @@ const ElementStyle& StylePool::GetStyle(ElementStyleHandle handle)
 	return chunks[0]->items[0];
 }
 
+const ResolvedStyle& StylePool::GetResolvedStyle(ElementStyleHandle handle)
+{
+	if (handle < numItems)
+	{
+		int chunkIndex = handle >> STYLE_POOL_CHUNK_SHIFT;
+		return chunks[chunkIndex]->resolved[handle & STYLE_POOL_INDEX_MASK];
+	}
+	return chunks[0]->resolved[0];
+}
+
+void StylePool::Resolve(const ElementStyle& style, ResolvedStyle& resolved)
+{
+	resolved.font = Assets.GetFont(style.fontSize, style.fontStyle);
+	resolved.glyphWidths = Assets.GetFontWidths(style.fontSize, style.fontStyle);
+	resolved.fontStyle = style.fontStyle;
+}
+
 void StylePool::Init()
 {
 	chunks[0] = new StylePool::PoolChunk();
+	ClearHashTable();
+}
+
+void StylePool::ClearHashTable()
+{
+	for (int n = 0; n < STYLE_POOL_HASH_SIZE; n++)
+	{
+		hashTable[n] = STYLE_POOL_EMPTY_SLOT;
+	}
+}
+
+void StylePool::Reset()
+{
+	// Only the interface styles survive, so they are hashed again into an empty table
+	numItems = numInterfaceStyles;
+	numHits = numMisses = 0;
+	ClearHashTable();
+
+	for (ElementStyleHandle n = 0; n < numInterfaceStyles; n++)
+	{
+		uint16_t slot = Hash(GetStyle(n));
+		while (hashTable[slot] != STYLE_POOL_EMPTY_SLOT)
+		{
+			slot = (slot + 1) & STYLE_POOL_HASH_MASK;
+		}
+		hashTable[slot] = n;
+	}
 }
@@ -110,6 +110,30 @@ struct ElementStyleOverride
 	}
 };
 
+// Font selection for a style, worked out once when the style is added to the pool so that
+// measuring and drawing text doesn't need to go back to the data pack
+struct ResolvedStyle
+{
+	Font* font;
+	const uint8_t* glyphWidths;		// Indexed by character, emboldening included
+	FontStyle::Type fontStyle : 8;
+
+	inline int GetGlyphWidth(char c) const
+	{
+		return glyphWidths[(uint8_t)c];
+	}
+
+	int CalculateWidth(const char* text) const
+	{
+		int result = 0;
+		while (*text)
+		{
+			result += glyphWidths[(uint8_t)*text++];
+		}
+		return result;
+	}
+};
+
 #define MAX_STYLE_POOL_CHUNKS 6
 
 #define STYLE_POOL_CHUNK_SHIFT 6
@@ -118,34 +142,54 @@ struct ElementStyleOverride
 
 #define MAX_STYLES (MAX_STYLE_POOL_CHUNKS * STYLE_POOL_CHUNK_SIZE)
 
+// Open addressed table of handles, kept at least a quarter empty so that probe runs stay short
+#define STYLE_POOL_HASH_SHIFT 9
+#define STYLE_POOL_HASH_SIZE (1 << STYLE_POOL_HASH_SHIFT)
+#define STYLE_POOL_HASH_MASK (STYLE_POOL_HASH_SIZE - 1)
+#define STYLE_POOL_EMPTY_SLOT 0xffff
+
 typedef uint16_t ElementStyleHandle;
 
 class StylePool
 {
 public:
-	StylePool() : numItems(0) 
+	StylePool() : numItems(0), numInterfaceStyles(0), numHits(0), numMisses(0)
 	{
 	}
 
 	ElementStyleHandle AddStyle(const ElementStyle& style);
 	const ElementStyle& GetStyle(ElementStyleHandle handle);
+	const ResolvedStyle& GetResolvedStyle(ElementStyleHandle handle);
 
 	void Init();
 	void MarkInterfaceStylesComplete() { numInterfaceStyles = numItems; }
 
-	void Reset() { numItems = numInterfaceStyles; }
+	void Reset();
 
 	static StylePool& Get();
 
+	int NumStyles() { return numItems; }
+	long NumHits() { return numHits; }
+	long NumMisses() { return numMisses; }
+
 private:
 	struct PoolChunk
 	{
 		ElementStyle items[STYLE_POOL_CHUNK_SIZE];
+		ResolvedStyle resolved[STYLE_POOL_CHUNK_SIZE];
 	};
 
+	static uint16_t Hash(const ElementStyle& style);
+	static void Resolve(const ElementStyle& style, ResolvedStyle& resolved);
+	void ClearHashTable();
+
 	PoolChunk* chunks[MAX_STYLE_POOL_CHUNKS];
 	int numItems;
 	int numInterfaceStyles;
+
+	ElementStyleHandle hashTable[STYLE_POOL_HASH_SIZE];
+	long numHits;
+	long numMisses;
 };
 
 #pragma pack(pop)
@@ -104,27 +104,129 @@ static const HTMLTagHandler* internalTagHandlers[] =
 	NULL
 };
 
-const HTMLTagHandler* DetermineTagFrom(const char *str, const HTMLTagHandler* handlers[])
+// Tag names are resolved through a hash table which is built on first use. The hash multiplier
+// and table size were picked so that every handler name gets a slot of its own, so a lookup is a
+// single probe followed by a length and first character check before the full compare. Adding
+// handlers can introduce collisions, in which case the lookup falls back to linear probing
+#define TAG_HASH_TABLE_SIZE 256
+#define TAG_HASH_MIX_SHIFT 10
+#define MAX_TAG_HANDLERS 64
+
+struct TagHashEntry
+{
+	const HTMLTagHandler* handler;
+	uint8_t length;
+	char firstChar;
+	bool internal;
+};
+
+static TagHashEntry tagHashEntries[MAX_TAG_HANDLERS];
+static int numTagHashEntries = 0;
+static uint8_t tagHashTable[TAG_HASH_TABLE_SIZE];		// Index into tagHashEntries + 1, zero if empty
+static int maxTagNameLength = 0;
+
+// Case folded hash of a tag name. Returns false if the name is longer than any known tag
+inline bool HashTagName(const char* str, uint8_t& outSlot, int& outLength)
 {
-	for(int n = 0; ; n++)
+	uint16_t hash = 0;
+	int length = 0;
+
+	while (*str)
 	{
-		const HTMLTagHandler* handler = handlers[n];
-		if (!handler)
+		if (length == maxTagNameLength)
 		{
-			break;
+			return false;
 		}
-		if (!stricmp(str, handler->name))
+		hash = (hash << 5) - hash + (uint8_t)(*str++ | 0x20);
+		length++;
+	}
+
+	outSlot = (uint8_t)(hash ^ (hash >> TAG_HASH_MIX_SHIFT));
+	outLength = length;
+	return true;
+}
+
+static void AddTagHandlersToHashTable(const HTMLTagHandler* handlers[], bool internal)
+{
+	for (int n = 0; handlers[n]; n++)
+	{
+		int length = strlen(handlers[n]->name);
+		if (length > maxTagNameLength)
 		{
-			return handler;
+			maxTagNameLength = length;
 		}
 	}
+
+	for (int n = 0; handlers[n]; n++)
+	{
+		if (numTagHashEntries == MAX_TAG_HANDLERS)
+		{
+			Platform::FatalError("Too many tag handlers");
+		}
+
+		uint8_t slot;
+		int length;
+		if (!HashTagName(handlers[n]->name, slot, length))
+		{
+			Platform::FatalError("Could not hash tag name");
+			continue;
+		}
+
+		while (tagHashTable[slot])
+		{
+			slot++;
+		}
+
+		TagHashEntry& entry = tagHashEntries[numTagHashEntries++];
+		entry.handler = handlers[n];
+		entry.length = (uint8_t)length;
+		entry.firstChar = (char) tolower((unsigned char) handlers[n]->name[0]);
+		entry.internal = internal;
+		tagHashTable[slot] = (uint8_t)numTagHashEntries;
+	}
+}
+
+static const HTMLTagHandler* LookupTagHandler(const char* str, bool internal)
+{
+	if (!numTagHashEntries)
+	{
+		AddTagHandlersToHashTable(tagHandlers, false);
+		AddTagHandlersToHashTable(internalTagHandlers, true);
+	}
+
+	uint8_t slot;
+	int length;
+	if (!HashTagName(str, slot, length))
+	{
+		return NULL;
+	}
+
+	char firstChar = (char) tolower((unsigned char) str[0]);
+
+	for (; tagHashTable[slot]; slot++)
+	{
+		const TagHashEntry& entry = tagHashEntries[tagHashTable[slot] - 1];
+		if (entry.length == length && entry.firstChar == firstChar && (internal || !entry.internal))
+		{
+			const char* name = entry.handler->name;
+			int n = 1;
+			while (n < length && tolower((unsigned char) str[n]) == tolower((unsigned char) name[n]))
+			{
+				n++;
+			}
+			if (n == length)
+			{
+				return entry.handler;
+			}
+		}
+	}
+
 	return NULL;
 }
 
 const HTMLTagHandler* DetermineTag(const char* str, bool internal)
 {
-	const HTMLTagHandler* tag = DetermineTagFrom(str, tagHandlers);
-	if(!tag && internal) tag = DetermineTagFrom(str, internalTagHandlers);
+	const HTMLTagHandler* tag = LookupTagHandler(str, internal);
 	if(tag) return tag;
 
 	static const HTMLTagHandler genericTag("generic");
@@ -166,3 +166,8 @@ void Platform::FatalError(const char* message, ...)
 
 	exit(1);
 }
+
+bool Platform::MakeDirectory(const char* path)
+{
+	return CreateDirectoryA(path, NULL) != 0;
+}
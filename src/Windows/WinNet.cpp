@@ -25,6 +25,7 @@ void WindowsNetworkDriver::Init()
 
 void WindowsNetworkDriver::Shutdown()
 {
+	HTTPRequest::CloseIdleConnections();
 	WSACleanup();
 }
 